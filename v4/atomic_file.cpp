@@ -0,0 +1,42 @@
+
+#include "atomic_file.hpp"
+
+#include <cerrno>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+void write_file_atomic(const std::string &fname, std::span<const uint8_t> data)
+{
+    std::string tmp_fname = fname + ".tmp";
+
+    int fd = open(tmp_fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file: " + tmp_fname);
+    }
+
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += n;
+    }
+
+    // without the fsync the rename may reach the disk before the data does
+    bool failed = written != data.size() || fsync(fd) != 0;
+    failed = close(fd) != 0 || failed;
+
+    if (failed) {
+        std::filesystem::remove(tmp_fname);
+        throw std::runtime_error("failed to write file: " + tmp_fname);
+    }
+
+    std::filesystem::rename(tmp_fname, fname);
+}
@@ -0,0 +1,13 @@
+
+#ifndef ATOMIC_FILE_HPP
+#define ATOMIC_FILE_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Writes data to a temporary file next to fname, flushes it to disk and renames it over fname. Readers
+// see the old file or the complete new one, even after a crash or power loss halfway through
+void write_file_atomic(const std::string &fname, std::span<const uint8_t> data);
+
+#endif /* ATOMIC_FILE_HPP */
@@ -0,0 +1,148 @@
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "atomic_file.hpp"
+#include "bc7_encoder.hpp"
+#include "image_decoder.hpp"
+#include "job_system.hpp"
+#include "ktx2_file.hpp"
+#include "mip_generator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// offline texture baking: every mip level computed and block compressed ahead of time, so startup
+// only maps the file and copies it to the GPU, see Engine::create_baked_texture_image
+struct Options {
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    vk::Format               format  = vk::Format::eBc7SrgbBlock;
+    MipFilter                filter  = MipFilter::Box;
+    size_t                   threads = 0;
+};
+
+static void usage(void)
+{
+    std::cout << "usage: bake.elf [options] INPUT OUTPUT.ktx2 [INPUT OUTPUT.ktx2]...\n"
+                 "\t--format F        bc7 or rgba8, both sRGB (bc7)\n"
+                 "\t--filter F        mip filter, box or kaiser (box)\n"
+                 "\t--threads N       worker threads, 0 for one per hardware thread (0)\n";
+}
+
+static Options parse_args(int argc, char **argv)
+{
+    Options                  options;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--format") {
+            std::string format = next();
+            if (format == "bc7") {
+                options.format = vk::Format::eBc7SrgbBlock;
+            } else if (format == "rgba8") {
+                options.format = vk::Format::eR8G8B8A8Srgb;
+            } else {
+                throw std::runtime_error("unknown format: " + format);
+            }
+        } else if (arg == "--filter") {
+            std::string filter = next();
+            if (filter == "box") {
+                options.filter = MipFilter::Box;
+            } else if (filter == "kaiser") {
+                options.filter = MipFilter::Kaiser;
+            } else {
+                throw std::runtime_error("unknown filter: " + filter);
+            }
+        } else if (arg == "--threads") {
+            options.threads = std::stoul(next());
+        } else if (arg == "--help") {
+            usage();
+            exit(EXIT_SUCCESS);
+        } else if (arg.starts_with("--")) {
+            usage();
+            throw std::runtime_error("unknown argument: " + arg);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty() || files.size() % 2 != 0) {
+        usage();
+        throw std::runtime_error("expected pairs of an input and an output file");
+    }
+    for (size_t i = 0; i < files.size(); i += 2) {
+        options.inputs.push_back(files[i]);
+        options.outputs.push_back(files[i + 1]);
+    }
+    return options;
+}
+
+int main(int argc, char **argv)
+{
+    try {
+        Options options = parse_args(argc, argv);
+
+        JobSystem jobs;
+        jobs.start(options.threads);
+
+        // all inputs are decoded at once, then each image's levels are split across the threads
+        auto                      start = std::chrono::steady_clock::now();
+        std::vector<DecodedImage> images = decode_images(options.inputs, jobs);
+
+        for (size_t i = 0; i < images.size(); i++) {
+            const DecodedImage &image = images[i];
+
+            std::vector<std::vector<uint8_t>> levels = generate_mips(
+                image.pixels.get(),
+                image.width,
+                image.height,
+                options.filter,
+                jobs
+            );
+            if (options.format == vk::Format::eBc7SrgbBlock) {
+                for (uint32_t level = 0; level < levels.size(); level++) {
+                    levels[level] = encode_bc7(
+                        levels[level].data(),
+                        std::max(image.width >> level, 1u),
+                        std::max(image.height >> level, 1u),
+                        jobs
+                    );
+                }
+            }
+
+            std::vector<uint8_t> data = Ktx2File::serialize(
+                options.inputs[i],
+                options.format,
+                image.width,
+                image.height,
+                levels
+            );
+            write_file_atomic(options.outputs[i], data);
+
+            auto end = std::chrono::steady_clock::now();
+            std::cout << options.outputs[i] << ": " << image.width << 'x' << image.height << ", " << levels.size()
+                      << " levels, " << vk::to_string(options.format) << ", " << data.size() / 1024 << " KiB in "
+                      << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+            start = end;
+        }
+        jobs.stop();
+    } catch (const std::exception &e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+
+#include "bc7_encoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+// interpolation weights of 4 bit indices out of 64
+static constexpr std::array<uint32_t, 16> WEIGHTS = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Endpoints {
+    // 7 bit per channel and the p-bit that makes them 8 bit
+    uint8_t  color[2][4];
+    uint8_t  pbit[2];
+    uint8_t  indices[16];
+    uint32_t error;
+};
+
+static uint32_t get_endpoint(const Endpoints &e, uint32_t endpoint, uint32_t channel)
+{
+    return (e.color[endpoint][channel] << 1) | e.pbit[endpoint];
+}
+
+// nearest 7 bit endpoint with either p-bit, the p-bit is shared by all channels
+static void quantize_endpoint(const float value[4], Endpoints &e, uint32_t endpoint)
+{
+    uint32_t best_error = UINT32_MAX;
+
+    for (uint32_t pbit = 0; pbit < 2; pbit++) {
+        uint8_t  color[4];
+        uint32_t error = 0;
+        for (uint32_t c = 0; c < 4; c++) {
+            float q = std::round((std::clamp(value[c], 0.0f, 255.0f) - pbit) * 0.5f);
+            color[c] = std::clamp(q, 0.0f, 127.0f);
+
+            int32_t d = int32_t((color[c] << 1) | pbit) - int32_t(std::round(std::clamp(value[c], 0.0f, 255.0f)));
+            error += d * d;
+        }
+        if (error < best_error) {
+            best_error = error;
+            memcpy(e.color[endpoint], color, sizeof(color));
+            e.pbit[endpoint] = pbit;
+        }
+    }
+}
+
+// picks the nearest palette entry for every texel and sums the squared errors
+static void assign_indices(const uint8_t texels[64], Endpoints &e)
+{
+    int32_t palette[16][4];
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t e0 = get_endpoint(e, 0, c);
+            uint32_t e1 = get_endpoint(e, 1, c);
+            palette[i][c] = ((64 - WEIGHTS[i]) * e0 + WEIGHTS[i] * e1 + 32) >> 6;
+        }
+    }
+
+    e.error = 0;
+    for (uint32_t t = 0; t < 16; t++) {
+        uint32_t best_error = UINT32_MAX;
+        for (uint32_t i = 0; i < 16; i++) {
+            uint32_t error = 0;
+            for (uint32_t c = 0; c < 4; c++) {
+                int32_t d = palette[i][c] - texels[t * 4 + c];
+                error += d * d;
+            }
+            if (error < best_error) {
+                best_error = error;
+                e.indices[t] = i;
+            }
+        }
+        e.error += best_error;
+    }
+}
+
+// endpoints minimizing the squared error for the current indices, per channel a 2x2 system
+static bool refine_endpoints(const uint8_t texels[64], const Endpoints &e, float endpoints[2][4])
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = {};
+    float bx[4] = {};
+
+    for (uint32_t t = 0; t < 16; t++) {
+        float b = WEIGHTS[e.indices[t]] / 64.0f;
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (uint32_t c = 0; c < 4; c++) {
+            ax[c] += a * texels[t * 4 + c];
+            bx[c] += b * texels[t * 4 + c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f) {
+        return false;
+    }
+    for (uint32_t c = 0; c < 4; c++) {
+        endpoints[0][c] = (ax[c] * bb - bx[c] * ab) / det;
+        endpoints[1][c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    return true;
+}
+
+static void write_bits(uint8_t block[16], uint32_t &bit, uint32_t value, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++, bit++) {
+        block[bit / 8] |= ((value >> i) & 1) << (bit % 8);
+    }
+}
+
+void encode_bc7_block(const uint8_t texels[64], uint8_t block[16])
+{
+    float mean[4] = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            mean[c] += texels[t * 4 + c] / 16.0f;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        float d[4];
+        for (uint32_t c = 0; c < 4; c++) {
+            d[c] = texels[t * 4 + c] - mean[c];
+        }
+        for (uint32_t i = 0; i < 4; i++) {
+            for (uint32_t j = 0; j < 4; j++) {
+                covariance[i][j] += d[i] * d[j];
+            }
+        }
+    }
+
+    // principal axis by power iteration, starting from the channel that varies most
+    float axis[4] = {};
+    uint32_t widest = 0;
+    for (uint32_t c = 1; c < 4; c++) {
+        if (covariance[c][c] > covariance[widest][widest]) {
+            widest = c;
+        }
+    }
+    axis[widest] = 1.0f;
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        for (uint32_t i = 0; i < 4; i++) {
+            for (uint32_t j = 0; j < 4; j++) {
+                next[i] += covariance[i][j] * axis[j];
+            }
+        }
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (length < 1e-6f) {
+            break;
+        }
+        for (uint32_t c = 0; c < 4; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float min_t = INFINITY;
+    float max_t = -INFINITY;
+    for (uint32_t t = 0; t < 16; t++) {
+        float projection = 0.0f;
+        for (uint32_t c = 0; c < 4; c++) {
+            projection += (texels[t * 4 + c] - mean[c]) * axis[c];
+        }
+        min_t = std::min(min_t, projection);
+        max_t = std::max(max_t, projection);
+    }
+
+    float endpoints[2][4];
+    for (uint32_t c = 0; c < 4; c++) {
+        endpoints[0][c] = mean[c] + axis[c] * min_t;
+        endpoints[1][c] = mean[c] + axis[c] * max_t;
+    }
+
+    Endpoints best;
+    quantize_endpoint(endpoints[0], best, 0);
+    quantize_endpoint(endpoints[1], best, 1);
+    assign_indices(texels, best);
+
+    for (uint32_t iteration = 0; iteration < 2 && best.error > 0; iteration++) {
+        if (not refine_endpoints(texels, best, endpoints)) {
+            break;
+        }
+        Endpoints refined;
+        quantize_endpoint(endpoints[0], refined, 0);
+        quantize_endpoint(endpoints[1], refined, 1);
+        assign_indices(texels, refined);
+        if (refined.error >= best.error) {
+            break;
+        }
+        best = refined;
+    }
+
+    // the index of texel 0 is stored without its high bit, swapping the endpoints clears it
+    if (best.indices[0] & 8) {
+        std::swap(best.color[0], best.color[1]);
+        std::swap(best.pbit[0], best.pbit[1]);
+        for (uint8_t &index : best.indices) {
+            index = 15 - index;
+        }
+    }
+
+    memset(block, 0, 16);
+    uint32_t bit = 0;
+    write_bits(block, bit, 1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        write_bits(block, bit, best.color[0][c], 7);
+        write_bits(block, bit, best.color[1][c], 7);
+    }
+    write_bits(block, bit, best.pbit[0], 1);
+    write_bits(block, bit, best.pbit[1], 1);
+    write_bits(block, bit, best.indices[0], 3);
+    for (uint32_t t = 1; t < 16; t++) {
+        write_bits(block, bit, best.indices[t], 4);
+    }
+}
+
+std::vector<uint8_t> encode_bc7(const uint8_t *rgba, uint32_t width, uint32_t height, JobSystem &jobs)
+{
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+
+    std::vector<uint8_t> blocks(size_t(blocks_x) * blocks_y * 16);
+
+    size_t slices = std::min<size_t>(jobs.thread_count(), blocks_y);
+    jobs.parallel_for(slices, [&](size_t slice) {
+        uint32_t end = blocks_y * (slice + 1) / slices;
+        for (uint32_t by = blocks_y * slice / slices; by < end; by++) {
+            for (uint32_t bx = 0; bx < blocks_x; bx++) {
+                uint8_t texels[64];
+                for (uint32_t t = 0; t < 16; t++) {
+                    uint32_t x = std::min(bx * 4 + t % 4, width - 1);
+                    uint32_t y = std::min(by * 4 + t / 4, height - 1);
+                    memcpy(&texels[t * 4], &rgba[(size_t(y) * width + x) * 4], 4);
+                }
+                encode_bc7_block(texels, &blocks[(size_t(by) * blocks_x + bx) * 16]);
+            }
+        }
+    });
+
+    return blocks;
+}
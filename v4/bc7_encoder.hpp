@@ -0,0 +1,20 @@
+
+#ifndef BC7_ENCODER_HPP
+#define BC7_ENCODER_HPP
+
+#include "job_system.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// BC7 block of 4x4 RGBA8 texels in row order, sRGB or linear is up to the format it is uploaded as
+void encode_bc7_block(const uint8_t texels[64], uint8_t block[16]);
+
+// Every block in mode 6, one subset with 7.7.7.7 endpoints, a p-bit each and 4 bit indices: fits
+// smooth color and alpha gradients well, edges between unrelated colors less so. Endpoints start from
+// the principal axis of the texels and are refined by least squares. Blocks past the edge of an
+// image that is no multiple of 4 repeat its last row and column. Rows of blocks are split across jobs
+[[nodiscard]]
+std::vector<uint8_t> encode_bc7(const uint8_t *rgba, uint32_t width, uint32_t height, JobSystem &jobs);
+
+#endif /* BC7_ENCODER_HPP */
@@ -0,0 +1,290 @@
+
+#include "engine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// counts every allocation of the process, the engine does not know it is being watched
+static std::atomic<uint64_t> g_allocations     = 0;
+static std::atomic<uint64_t> g_allocated_bytes = 0;
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (void *ptr = malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+struct Options {
+    BenchOptions engine    = { 1280, 720, true, 0 };
+    uint32_t     frames    = 1000;
+    uint32_t     warmup    = 20;
+    std::string  out       = "bench.json";
+    std::string  baseline;
+    double       threshold = 10.0;
+};
+
+struct Metric {
+    std::string name;
+    double      value;
+    // smaller differences are noise and never reported
+    double      min_delta;
+};
+
+static void usage(void)
+{
+    std::cout << "usage: bench.elf [options]\n"
+                 "\t--frames N        measured frames (1000)\n"
+                 "\t--warmup N        frames rendered before measuring (20)\n"
+                 "\t--width W         framebuffer width (1280)\n"
+                 "\t--height H        framebuffer height (720)\n"
+                 "\t--window          render to a window instead of a headless surface\n"
+                 "\t--instances N     draw a generated scene of N instances of the model (0)\n"
+                 "\t--out FILE        results JSON (bench.json)\n"
+                 "\t--baseline FILE   compare with results of a previous run\n"
+                 "\t--threshold PCT   regression threshold against the baseline (10)\n";
+}
+
+static Options parse_args(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--frames") {
+            options.frames = std::stoul(next());
+        } else if (arg == "--warmup") {
+            options.warmup = std::stoul(next());
+        } else if (arg == "--width") {
+            options.engine.width = std::stoul(next());
+        } else if (arg == "--height") {
+            options.engine.height = std::stoul(next());
+        } else if (arg == "--window") {
+            options.engine.headless = false;
+        } else if (arg == "--instances") {
+            options.engine.instances = std::stoul(next());
+        } else if (arg == "--out") {
+            options.out = next();
+        } else if (arg == "--baseline") {
+            options.baseline = next();
+        } else if (arg == "--threshold") {
+            options.threshold = std::stod(next());
+        } else if (arg == "--help") {
+            usage();
+            exit(EXIT_SUCCESS);
+        } else {
+            usage();
+            throw std::runtime_error("unknown argument: " + arg);
+        }
+    }
+
+    if (options.frames == 0) {
+        throw std::runtime_error("--frames must be at least 1");
+    }
+    return options;
+}
+
+[[nodiscard]]
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t idx = std::ceil(sorted.size() * p);
+    return sorted.at(std::clamp<size_t>(idx, 1, sorted.size()) - 1);
+}
+
+static void add_stats(std::vector<Metric> &metrics, const std::string &name, std::vector<double> samples, double min_delta)
+{
+    if (samples.empty()) {
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+
+    metrics.push_back({ name + "_avg", sum / samples.size(), min_delta });
+    metrics.push_back({ name + "_p50", percentile(samples, 0.5), min_delta });
+    metrics.push_back({ name + "_p99", percentile(samples, 0.99), min_delta });
+    metrics.push_back({ name + "_max", samples.back(), min_delta });
+}
+
+static void write_results(const Options &options, const std::vector<Metric> &metrics)
+{
+    std::ofstream f(options.out);
+    if (not f.is_open()) {
+        throw std::runtime_error("failed to open file: " + options.out);
+    }
+
+    f << "{\n"
+      << "    \"engine\": \"" << BENCH_ENGINE_NAME << "\",\n"
+      << "    \"width\": " << options.engine.width << ",\n"
+      << "    \"height\": " << options.engine.height << ",\n"
+      << "    \"frames\": " << options.frames << ",\n"
+      << "    \"instances\": " << options.engine.instances << ",\n"
+      << "    \"headless\": " << (options.engine.headless ? "true" : "false");
+    for (const Metric &metric : metrics) {
+        f << ",\n    \"" << metric.name << "\": " << metric.value;
+    }
+    f << "\n}\n";
+
+    if (f.fail()) {
+        throw std::runtime_error("failed to write file: " + options.out);
+    }
+}
+
+// the results file is a flat object, a lookup of "name": is all the parsing it needs
+[[nodiscard]]
+static std::optional<double> find_value(const std::string &json, const std::string &name)
+{
+    size_t pos = json.find("\"" + name + "\":");
+    if (pos == std::string::npos) {
+        return std::nullopt;
+    }
+
+    const char *begin = json.c_str() + pos + name.size() + 3;
+    char       *end   = nullptr;
+    double      value = strtod(begin, &end);
+    if (end == begin) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+[[nodiscard]]
+static int compare_baseline(const Options &options, const std::vector<Metric> &metrics)
+{
+    std::ifstream f(options.baseline);
+    if (not f.is_open()) {
+        std::cout << "no baseline at " << options.baseline << ", nothing to compare\n";
+        return 0;
+    }
+
+    std::stringstream ss;
+    ss << f.rdbuf();
+    std::string json = ss.str();
+
+    if (find_value(json, "width") != options.engine.width || find_value(json, "height") != options.engine.height) {
+        std::cout << "baseline was recorded at a different resolution, results are not comparable\n";
+    }
+    if (find_value(json, "instances").value_or(0) != options.engine.instances) {
+        std::cout << "baseline was recorded with a different scene, results are not comparable\n";
+    }
+
+    int regressions = 0;
+    for (const Metric &metric : metrics) {
+        std::optional<double> base = find_value(json, metric.name);
+        if (not base) {
+            continue;
+        }
+
+        double delta = metric.value - *base;
+        double pct   = *base != 0 ? delta / *base * 100.0 : 0.0;
+        bool   worse = delta > metric.min_delta && (*base == 0 || pct > options.threshold);
+
+        if (worse) {
+            regressions++;
+        }
+        std::cout << (worse ? "REGRESSION " : "           ")
+                  << metric.name << ": " << *base << " -> " << metric.value
+                  << " (" << (pct >= 0 ? "+" : "") << pct << "%)\n";
+    }
+
+    std::cout << regressions << " regressions against " << options.baseline
+              << " (threshold " << options.threshold << "%)\n";
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    try {
+        Options options = parse_args(argc, argv);
+        Engine  engine;
+
+        uint64_t start_allocations = g_allocations.load();
+        double   startup_ms = engine.bench_init(options.engine);
+        uint64_t startup_allocations = g_allocations.load() - start_allocations;
+
+        for (uint32_t i = 0; i < options.warmup; i++) {
+            (void)engine.bench_frame(i);
+        }
+
+        // reserved up front, the samples must not show up in the allocation counts
+        std::vector<double> cpu_ms;
+        std::vector<double> gpu_ms;
+        cpu_ms.reserve(options.frames);
+        gpu_ms.reserve(options.frames);
+        uint64_t frame_allocations = g_allocations.load();
+        uint64_t frame_bytes = g_allocated_bytes.load();
+
+        for (uint32_t i = 0; i < options.frames; i++) {
+            BenchFrame frame = engine.bench_frame(options.warmup + i);
+
+            cpu_ms.push_back(frame.cpu_ms);
+            if (frame.gpu_ms >= 0) {
+                gpu_ms.push_back(frame.gpu_ms);
+            }
+        }
+
+        frame_allocations = g_allocations.load() - frame_allocations;
+        frame_bytes = g_allocated_bytes.load() - frame_bytes;
+
+        engine.bench_cleanup();
+
+        std::vector<Metric> metrics = {
+            { "startup_ms", startup_ms, 5.0 },
+            { "startup_allocations", static_cast<double>(startup_allocations), 100.0 },
+            { "frame_allocations_avg", static_cast<double>(frame_allocations) / options.frames, 0.5 },
+            { "frame_allocated_bytes_avg", static_cast<double>(frame_bytes) / options.frames, 64.0 },
+        };
+        add_stats(metrics, "cpu_frame_ms", cpu_ms, 0.05);
+        add_stats(metrics, "gpu_frame_ms", gpu_ms, 0.05);
+
+        write_results(options, metrics);
+        for (const Metric &metric : metrics) {
+            std::cout << metric.name << ": " << metric.value << '\n';
+        }
+        std::cout << "results written to " << options.out << '\n';
+
+        if (not options.baseline.empty() && compare_baseline(options, metrics) != 0) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+
+#include "bindless_heap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+
+using namespace std::string_literals;
+
+void BindlessHeap::init(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        uint32_t max_textures,
+        uint32_t max_samplers,
+        uint32_t max_buffers
+    )
+{
+    auto props = pd.getProperties2<vk::PhysicalDeviceProperties2,
+                                   vk::PhysicalDeviceDescriptorIndexingProperties>();
+    const auto &limits = props.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+
+    this->device = &dev;
+    this->textures.capacity = std::min({
+        max_textures,
+        limits.maxDescriptorSetUpdateAfterBindSampledImages,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+    });
+    this->samplers.capacity = std::min({
+        max_samplers,
+        limits.maxDescriptorSetUpdateAfterBindSamplers,
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+    });
+    this->buffers.capacity = std::min({
+        max_buffers,
+        limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+    });
+
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+        vk::DescriptorSetLayoutBinding(
+            TEXTURE_BINDING,
+            vk::DescriptorType::eSampledImage,
+            this->textures.capacity,
+            vk::ShaderStageFlagBits::eAll
+        ),
+        vk::DescriptorSetLayoutBinding(
+            SAMPLER_BINDING,
+            vk::DescriptorType::eSampler,
+            this->samplers.capacity,
+            vk::ShaderStageFlagBits::eAll
+        ),
+        vk::DescriptorSetLayoutBinding(
+            BUFFER_BINDING,
+            vk::DescriptorType::eStorageBuffer,
+            this->buffers.capacity,
+            vk::ShaderStageFlagBits::eAll
+        ),
+    };
+
+    // unwritten slots are never accessed, written ones may change while the set is in use
+    vk::DescriptorBindingFlags binding_flags =
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+        vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending |
+        vk::DescriptorBindingFlagBits::ePartiallyBound;
+    std::array<vk::DescriptorBindingFlags, 3> flags = { binding_flags, binding_flags, binding_flags };
+
+    vk::StructureChain<vk::DescriptorSetLayoutCreateInfo,
+                       vk::DescriptorSetLayoutBindingFlagsCreateInfo> layout_info = {
+        vk::DescriptorSetLayoutCreateInfo(
+            vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+            bindings
+        ),
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo(flags),
+    };
+    this->layout = vk::raii::DescriptorSetLayout(dev, layout_info.get<vk::DescriptorSetLayoutCreateInfo>());
+
+    std::array<vk::DescriptorPoolSize, 3> pool_sizes = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, this->textures.capacity),
+        vk::DescriptorPoolSize(vk::DescriptorType::eSampler, this->samplers.capacity),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, this->buffers.capacity),
+    };
+    vk::DescriptorPoolCreateInfo pool_info(
+        vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet | vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+        1,
+        pool_sizes
+    );
+    this->pool = vk::raii::DescriptorPool(dev, pool_info);
+
+    vk::DescriptorSetAllocateInfo set_info(
+        this->pool,
+        *this->layout
+    );
+    this->set = std::move(vk::raii::DescriptorSets(dev, set_info).front());
+}
+
+const vk::raii::DescriptorSetLayout &BindlessHeap::get_layout(void) const
+{
+    return this->layout;
+}
+
+const vk::raii::DescriptorSet &BindlessHeap::get_set(void) const
+{
+    return this->set;
+}
+
+uint32_t BindlessHeap::add_texture(const vk::raii::ImageView &view, vk::ImageLayout layout)
+{
+    std::lock_guard lock(this->mutex);
+
+    uint32_t id = allocate(this->textures, "texture");
+    vk::DescriptorImageInfo image_info(
+        {},
+        view,
+        layout
+    );
+    vk::WriteDescriptorSet write(
+        this->set,
+        TEXTURE_BINDING,
+        id,
+        vk::DescriptorType::eSampledImage,
+        image_info,
+        {}
+    );
+    this->device->updateDescriptorSets(write, {});
+
+    return id;
+}
+
+uint32_t BindlessHeap::add_sampler(const vk::raii::Sampler &sampler)
+{
+    std::lock_guard lock(this->mutex);
+
+    uint32_t id = allocate(this->samplers, "sampler");
+    vk::DescriptorImageInfo image_info(
+        sampler,
+        {},
+        {}
+    );
+    vk::WriteDescriptorSet write(
+        this->set,
+        SAMPLER_BINDING,
+        id,
+        vk::DescriptorType::eSampler,
+        image_info,
+        {}
+    );
+    this->device->updateDescriptorSets(write, {});
+
+    return id;
+}
+
+uint32_t BindlessHeap::add_buffer(const vk::raii::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+    std::lock_guard lock(this->mutex);
+
+    uint32_t id = allocate(this->buffers, "buffer");
+    vk::DescriptorBufferInfo buffer_info(
+        buffer,
+        offset,
+        range
+    );
+    vk::WriteDescriptorSet write(
+        this->set,
+        BUFFER_BINDING,
+        id,
+        vk::DescriptorType::eStorageBuffer,
+        {},
+        buffer_info
+    );
+    this->device->updateDescriptorSets(write, {});
+
+    return id;
+}
+
+void BindlessHeap::remove_texture(uint32_t id)
+{
+    std::lock_guard lock(this->mutex);
+    release(this->textures, id);
+}
+
+void BindlessHeap::remove_sampler(uint32_t id)
+{
+    std::lock_guard lock(this->mutex);
+    release(this->samplers, id);
+}
+
+void BindlessHeap::remove_buffer(uint32_t id)
+{
+    std::lock_guard lock(this->mutex);
+    release(this->buffers, id);
+}
+
+uint32_t BindlessHeap::allocate(Slots &slots, const char *kind)
+{
+    if (not slots.free.empty()) {
+        uint32_t id = slots.free.back();
+        slots.free.pop_back();
+        return id;
+    }
+
+    if (slots.next >= slots.capacity) {
+        throw std::runtime_error("bindless heap is out of "s + kind + " slots");
+    }
+    return slots.next++;
+}
+
+void BindlessHeap::release(Slots &slots, uint32_t id)
+{
+    // stale descriptor stays in place, partially bound arrays only require accessed slots to be valid
+    slots.free.push_back(id);
+}
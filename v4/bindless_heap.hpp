@@ -0,0 +1,75 @@
+
+#ifndef BINDLESS_HEAP_HPP
+#define BINDLESS_HEAP_HPP
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+#include <mutex>
+#include <vector>
+
+// One global descriptor set of partially bound, update-after-bind arrays. Resources are registered once
+// and shaders address them by the returned index, so the set is bound once per command buffer no matter
+// how many textures or materials are drawn, and adding resources never touches layouts or pipelines.
+class BindlessHeap {
+public:
+    // must match the [[vk::binding]] declarations in shader.slang
+    static constexpr uint32_t TEXTURE_BINDING = 0;
+    static constexpr uint32_t SAMPLER_BINDING = 1;
+    static constexpr uint32_t BUFFER_BINDING  = 2;
+
+    // capacities are clamped to update-after-bind limits of the device
+    void init(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        uint32_t max_textures,
+        uint32_t max_samplers,
+        uint32_t max_buffers
+    );
+
+    [[nodiscard]]
+    const vk::raii::DescriptorSetLayout &get_layout(void) const;
+
+    [[nodiscard]]
+    const vk::raii::DescriptorSet &get_set(void) const;
+
+    // descriptor is written right away, update-after-bind allows it even while the set is bound
+    // by pending command buffers. Any thread may register resources
+    [[nodiscard]]
+    uint32_t add_texture(const vk::raii::ImageView &view, vk::ImageLayout layout);
+
+    [[nodiscard]]
+    uint32_t add_sampler(const vk::raii::Sampler &sampler);
+
+    [[nodiscard]]
+    uint32_t add_buffer(const vk::raii::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize range);
+
+    // index is reused by later add calls, no pending command buffer may still access it
+    void remove_texture(uint32_t id);
+    void remove_sampler(uint32_t id);
+    void remove_buffer(uint32_t id);
+
+private:
+    struct Slots {
+        std::vector<uint32_t> free;
+        uint32_t              next     = 0;
+        uint32_t              capacity = 0;
+    };
+
+    [[nodiscard]]
+    static uint32_t allocate(Slots &slots, const char *kind);
+
+    static void release(Slots &slots, uint32_t id);
+
+    const vk::raii::Device        *device = nullptr;
+    vk::raii::DescriptorSetLayout layout  = nullptr;
+    vk::raii::DescriptorPool      pool    = nullptr;
+    vk::raii::DescriptorSet       set     = nullptr;
+
+    std::mutex                    mutex;
+    Slots                         textures;
+    Slots                         samplers;
+    Slots                         buffers;
+};
+
+#endif /* BINDLESS_HEAP_HPP */
@@ -1,8 +1,12 @@
 
+/* overridden by the bench target, CI hosts have no validation layers */
+#ifndef CONFIG_VK_VALIDATION_LAYERS
 #define CONFIG_VK_VALIDATION_LAYERS    1
+#endif
 #define CONFIG_VK_MAX_FRAMES_IN_FLIGHT 2
 
 #define CONFIG_SHADER_SPV_PATH "./shader.spv"
+#define CONFIG_PIPELINE_CACHE_PATH "./pipeline_cache.bin"
 
 #define CONFIG_WINDOW_RESIZABLE 1
 #define CONFIG_WINDOW_WIDTH     800
@@ -10,5 +14,90 @@
 
 #define CONFIG_MODEL_PATH       "../thirdparty/viking_room.obj"
 #define CONFIG_TEXTURE_PATH     "../thirdparty/viking_room.png"
+/* written by make bake-run, replaces CONFIG_TEXTURE_PATH when baked from its current version and sampleable, "" disables it */
+#define CONFIG_TEXTURE_KTX2_PATH "../thirdparty/viking_room.ktx2"
+/* PNG mips by generate_mips on the CPU instead of blits, always so when the device can't blit the format */
+#define CONFIG_TEXTURE_CPU_MIPS  0
+#define CONFIG_TEXTURE_MIP_FILTER MipFilter::Box
 
 #define CONFIG_DEBUG_VERBOSE 1
+
+/* prints per-phase breakdown of init_vulkan() and time to the first frame */
+#define CONFIG_STARTUP_PROFILE              1
+#define CONFIG_STARTUP_PROFILE_JSON         "./startup_profile.json"
+/* copy startup_profile.json of a known-good run here to get regressions reported */
+#define CONFIG_STARTUP_BASELINE_PATH        "./startup_baseline.json"
+#define CONFIG_STARTUP_REGRESSION_PCT       20
+#define CONFIG_STARTUP_REGRESSION_MIN_MS    1.0
+#define CONFIG_STARTUP_FAIL_ON_REGRESSION   0
+
+/* GPU pass timings are read back this many recorded command buffers later */
+#define CONFIG_GPU_PROFILER_LATENCY         4
+#define CONFIG_GPU_PROFILER_HISTORY         512
+/* print GPU pass statistics every N frames, 0 to print only on exit */
+#define CONFIG_GPU_PROFILER_REPORT_FRAMES   1000
+
+/* Chrome Trace Event JSON of CPU zones and GPU passes, empty path disables tracing */
+#define CONFIG_TRACE_PATH                   ""
+#define CONFIG_TRACE_MAX_EVENTS             (1 << 20)
+/* re-sample CPU/GPU clock pair every N frames to follow the drift (only with calibrated timestamps), 0 disables */
+#define CONFIG_TRACE_CALIBRATION_FRAMES     600
+
+/* threads of the job system including the main thread, 0 for one per hardware thread */
+#define CONFIG_WORKER_THREADS               0
+/* record the draw list into secondary command buffers on all job system threads */
+#define CONFIG_PARALLEL_RECORDING           1
+/* split the model into draws of this many triangles, 0 draws it at once (stress test for recording) */
+#define CONFIG_DRAW_CHUNK_TRIANGLES         0
+
+/* slots of the bindless descriptor heap, clamped to the update-after-bind limits of the device */
+#define CONFIG_BINDLESS_MAX_TEXTURES        4096
+#define CONFIG_BINDLESS_MAX_SAMPLERS        64
+#define CONFIG_BINDLESS_MAX_BUFFERS         1024
+
+/* bytes of uniform data that can be allocated per frame in flight from the uniform ring */
+#define CONFIG_UNIFORM_RING_FRAME_SIZE      (64 * 1024)
+
+/* validation messages are written by a background thread every N ms, at most N lines per second */
+#define CONFIG_DEBUG_LOG_FLUSH_MS           50
+#define CONFIG_DEBUG_LOG_MAX_PER_SECOND     100
+/* a message id is printed this many times, further repeats are only counted and reported on exit */
+#define CONFIG_DEBUG_LOG_MAX_REPEATS        10
+
+/* warn when an allocation takes a memory heap past this percentage of its budget */
+#define CONFIG_MEMORY_BUDGET_WARN_PCT       90
+/* re-read VK_EXT_memory_budget every N frames, the budget shrinks when other processes allocate, 0 to read it only on exit */
+#define CONFIG_MEMORY_BUDGET_POLL_FRAMES    60
+/* print device memory per category and heap every N frames, 0 to print only on exit */
+#define CONFIG_MEMORY_REPORT_FRAMES         0
+
+/* deduplicated model as uploaded, mapped instead of parsing the OBJ again, empty path disables it */
+#define CONFIG_MESH_CACHE_PATH              "./mesh_cache.bin"
+/* hash the mapped cache before use, catches a corrupted file at the cost of reading it once */
+#define CONFIG_MESH_CACHE_VERIFY            1
+
+/* upload vertices as PackedVertex (12 bytes) instead of Vertex (32 bytes) when the device can fetch its formats */
+#define CONFIG_VERTEX_QUANTIZE              1
+/* cull meshlets against the frustum and their normal cone in a compute pass feeding one indirect draw */
+#define CONFIG_GPU_CULLING                  1
+/* meshlet limits, 64/124 also fit the output limits of mesh shaders */
+#define CONFIG_MESHLET_MAX_VERTICES         64
+#define CONFIG_MESHLET_MAX_TRIANGLES        124
+/* copies of the model in a generated scene, GPU-driven and culled per instance, 0 draws the model once (bench.elf --instances) */
+#define CONFIG_SCENE_INSTANCES              0
+/* the same seed always generates the same scene */
+#define CONFIG_SCENE_SEED                   1
+/* camera distance and depth range in scene mode, relative to viewing the single model */
+#define CONFIG_SCENE_VIEW_SCALE             8.0f
+/* reorder a freshly loaded mesh for the post-transform cache, overdraw and vertex fetch before caching it */
+#define CONFIG_MESH_OPTIMIZE                1
+/* FIFO cache entries the triangle order is optimized for, 16 suits most GPUs */
+#define CONFIG_MESH_OPTIMIZE_CACHE_SIZE     16
+/* ACMR a triangle cluster may lose so the clusters can be sorted front to back, 1.05 = 5% */
+#define CONFIG_MESH_OPTIMIZE_OVERDRAW_THRESHOLD 1.05f
+/* levels of detail simplified into the mesh cache, 1 draws the full mesh only, at most MeshCache::MAX_LODS */
+#define CONFIG_LOD_COUNT                    5
+/* triangles each LOD keeps of LOD 0 relative to the one before */
+#define CONFIG_LOD_RATIO                    0.5f
+/* the coarsest LOD whose simplification error projects to at most this many pixels is drawn */
+#define CONFIG_LOD_ERROR_PIXELS             1.0f
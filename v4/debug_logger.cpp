@@ -0,0 +1,195 @@
+
+#include "debug_logger.hpp"
+
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+DebugLogger::~DebugLogger()
+{
+    stop();
+}
+
+void DebugLogger::start(std::ostream &out, uint32_t max_repeats, uint32_t max_per_second, uint32_t flush_ms)
+{
+    stop();
+
+    this->out = &out;
+    this->max_repeats = max_repeats;
+    this->max_per_second = max_per_second;
+    this->flush_ms = flush_ms;
+
+    this->slots = std::make_unique<Slot[]>(CAPACITY);
+    for (size_t i = 0; i < CAPACITY; i++) {
+        this->slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    this->write_pos = 0;
+    this->read_pos = 0;
+    this->window_start = std::chrono::steady_clock::now();
+
+    this->writer = std::jthread([this](std::stop_token token) { writer_loop(token); });
+}
+
+void DebugLogger::stop(void)
+{
+    if (not this->writer.joinable()) {
+        return;
+    }
+
+    this->writer.request_stop();
+    this->wake_cv.notify_all();
+    this->writer.join();
+
+    flush();
+    report_suppressed();
+    this->slots.reset();
+}
+
+void DebugLogger::log(
+        vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+        int32_t id,
+        const char *id_name,
+        const char *message
+    )
+{
+    // not started, nothing is hot yet
+    if (this->slots == nullptr) {
+        std::cerr << "validation layer msg: " << message << '\n';
+        return;
+    }
+
+    uint32_t key   = get_key(id, id_name);
+    IdCount  *count = find_count(key);
+    if (count != nullptr && count->seen.fetch_add(1, std::memory_order_relaxed) >= this->max_repeats) {
+        return;
+    }
+
+    // bounded MPSC queue, a slot is free for position pos when its sequence equals pos
+    size_t pos = this->write_pos.load(std::memory_order_relaxed);
+    Slot   *slot;
+    for (;;) {
+        slot = &this->slots[pos % CAPACITY];
+        size_t   sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff     = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+            if (this->write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = this->write_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->severity = severity;
+    slot->key = key;
+    strncpy(slot->name, id_name != nullptr ? id_name : "", NAME_SIZE - 1);
+    slot->name[NAME_SIZE - 1] = '\0';
+    strncpy(slot->text, message, TEXT_SIZE - 1);
+    slot->text[TEXT_SIZE - 1] = '\0';
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+uint32_t DebugLogger::get_key(int32_t id, const char *id_name)
+{
+    // general messages have no id number, their name is the only identity
+    if (id == 0 && id_name != nullptr) {
+        return static_cast<uint32_t>(std::hash<std::string_view>()(id_name));
+    }
+    return static_cast<uint32_t>(id);
+}
+
+DebugLogger::IdCount *DebugLogger::find_count(uint32_t key)
+{
+    uint64_t tag = static_cast<uint64_t>(key) + 1;
+
+    for (size_t i = 0; i < ID_PROBES; i++) {
+        IdCount  &count   = this->ids[(key + i) % ID_SLOTS];
+        uint64_t expected = 0;
+        if (count.tag.compare_exchange_strong(expected, tag, std::memory_order_relaxed) || expected == tag) {
+            return &count;
+        }
+    }
+    return nullptr;
+}
+
+void DebugLogger::writer_loop(std::stop_token token)
+{
+    while (not token.stop_requested()) {
+        flush();
+
+        std::unique_lock lock(this->wake_mutex);
+        this->wake_cv.wait_for(lock, token, std::chrono::milliseconds(this->flush_ms), [] { return false; });
+    }
+}
+
+void DebugLogger::flush(void)
+{
+    std::string batch;
+
+    for (;;) {
+        Slot &slot = this->slots[this->read_pos % CAPACITY];
+        if (slot.sequence.load(std::memory_order_acquire) != this->read_pos + 1) {
+            break;
+        }
+
+        this->names.try_emplace(slot.key, slot.name);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - this->window_start >= std::chrono::seconds(1)) {
+            if (this->rate_limited != 0) {
+                batch += "validation layer: " + std::to_string(this->rate_limited) + " messages rate limited\n";
+            }
+            this->window_start = now;
+            this->window_lines = 0;
+            this->rate_limited = 0;
+        }
+
+        if (this->window_lines < this->max_per_second) {
+            batch += "validation layer " + vk::to_string(slot.severity) + " msg: " + slot.text + '\n';
+            this->window_lines++;
+        } else {
+            this->rate_limited++;
+        }
+
+        slot.sequence.store(this->read_pos + CAPACITY, std::memory_order_release);
+        this->read_pos++;
+    }
+
+    size_t dropped = this->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped != 0) {
+        batch += "validation layer: " + std::to_string(dropped) + " messages dropped, log ring full\n";
+    }
+
+    if (not batch.empty()) {
+        *this->out << batch << std::flush;
+    }
+}
+
+void DebugLogger::report_suppressed(void)
+{
+    if (this->rate_limited != 0) {
+        *this->out << "validation layer: " << this->rate_limited << " messages rate limited\n";
+        this->rate_limited = 0;
+    }
+
+    for (IdCount &count : this->ids) {
+        uint64_t tag  = count.tag.exchange(0, std::memory_order_relaxed);
+        uint32_t seen = count.seen.exchange(0, std::memory_order_relaxed);
+        if (tag == 0 || seen <= this->max_repeats) {
+            continue;
+        }
+
+        auto it = this->names.find(static_cast<uint32_t>(tag - 1));
+        std::string name = it != this->names.end() && not it->second.empty() ? it->second : "(unnamed)";
+        *this->out << "validation layer: " << name << " repeated " << seen << " times, "
+                   << seen - this->max_repeats << " suppressed\n";
+    }
+    this->names.clear();
+    this->out->flush();
+}
@@ -0,0 +1,94 @@
+
+#ifndef DEBUG_LOGGER_HPP
+#define DEBUG_LOGGER_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Validation messages are copied into a bounded lock-free ring from the thread that triggered them and
+// written by a background thread, so a chatty layer never blocks a driver call on a stream flush.
+// Message ids seen more than max_repeats times are only counted, the writer prints at most
+// max_per_second lines and reports what it skipped. Messages are dropped (and counted) when the ring is full.
+class DebugLogger {
+public:
+    ~DebugLogger();
+
+    void start(std::ostream &out, uint32_t max_repeats, uint32_t max_per_second, uint32_t flush_ms);
+
+    // drains the ring and prints the suppressed counts
+    void stop(void);
+
+    // safe to call from any thread, never blocks
+    void log(
+        vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
+        int32_t id,
+        const char *id_name,
+        const char *message
+    );
+
+private:
+    static constexpr size_t CAPACITY  = 1024;
+    static constexpr size_t TEXT_SIZE = 1024;
+    static constexpr size_t NAME_SIZE = 64;
+    static constexpr size_t ID_SLOTS  = 1024;
+    static constexpr size_t ID_PROBES = 16;
+
+    struct Slot {
+        std::atomic<size_t>                      sequence;
+        vk::DebugUtilsMessageSeverityFlagBitsEXT severity;
+        uint32_t                                 key;
+        char                                     name[NAME_SIZE];
+        char                                     text[TEXT_SIZE];
+    };
+
+    // open addressed, tag is key + 1 so 0 marks a free entry, claimed once and never shared by two keys
+    struct IdCount {
+        std::atomic<uint64_t> tag  = 0;
+        std::atomic<uint32_t> seen = 0;
+    };
+
+    [[nodiscard]]
+    static uint32_t get_key(int32_t id, const char *id_name);
+
+    // nullptr when the probe window is full, the message is then logged uncounted
+    [[nodiscard]]
+    IdCount *find_count(uint32_t key);
+
+    void writer_loop(std::stop_token token);
+    void flush(void);
+    void report_suppressed(void);
+
+    std::ostream                    *out            = nullptr;
+    uint32_t                        max_repeats     = 0;
+    uint32_t                        max_per_second  = 0;
+    uint32_t                        flush_ms        = 0;
+
+    std::unique_ptr<Slot[]>         slots;
+    std::atomic<size_t>             write_pos       = 0;
+    std::atomic<size_t>             dropped         = 0;
+    std::array<IdCount, ID_SLOTS>   ids;
+
+    // only touched by the writer
+    size_t                          read_pos        = 0;
+    size_t                          rate_limited    = 0;
+    size_t                          window_lines    = 0;
+    std::chrono::steady_clock::time_point window_start;
+    std::unordered_map<uint32_t, std::string> names;
+
+    std::mutex                      wake_mutex;
+    std::condition_variable_any     wake_cv;
+    std::jthread                    writer;
+};
+
+#endif /* DEBUG_LOGGER_HPP */
@@ -13,9 +13,6 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #include <algorithm>
 #include <chrono>
 #include <cstring>
@@ -25,7 +22,12 @@
 #include <vector>
 #include <unordered_map>
 
+#include "atomic_file.hpp"
 #include "engine.hpp"
+#include "image_decoder.hpp"
+#include "mesh_optimizer.hpp"
+#include "mip_generator.hpp"
+#include "scene.hpp"
 #include "vertex.hpp"
 
 using namespace std::string_literals;
@@ -40,62 +42,234 @@ struct UniformBufferObject {
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
+    // position = input * position_scale + position_offset, dequantizes PackedVertex
+    glm::vec4 position_offset;
+    glm::vec4 position_scale;
+};
+
+// indices into the bindless heap, layout matches Material in shader.slang
+struct Material {
+    uint32_t texture;
+    uint32_t sampler;
+};
+
+struct DrawConstants {
+    uint32_t material_buffer;
+    uint32_t material;
+    // NO_INSTANCES draws the model once, otherwise the transforms and the ids of the visible instances
+    uint32_t instance_buffer;
+    uint32_t visible_buffer;
+    // the ids of this draw's LOD start at this entry of visible_buffer
+    uint32_t visible_first;
+};
+
+static constexpr uint32_t NO_INSTANCES = UINT32_MAX;
+
+// numthreads of cull_main, a group tests this many meshlets and copies out the visible ones together
+static constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+// layout matches the uniform parameters of cull_main in shader.slang, buffers are bindless heap indices
+struct CullConstants {
+    glm::vec4 planes[6];
+    float     camera[3];
+    uint32_t  meshlet_count;
+    uint32_t  meshlet_buffer;
+    uint32_t  index_buffer;
+    uint32_t  cull_index_buffer;
+    uint32_t  indirect_buffer;
+};
+static_assert(sizeof(CullConstants) <= 128, "push constants past the guaranteed maxPushConstantsSize");
+
+// layout matches the uniform parameters of instance_cull_main in shader.slang
+struct SceneCullConstants {
+    uint32_t instance_count;
+    uint32_t lod_count;
+    uint32_t instance_buffer;
+    // lod_count regions of instance_count ids
+    uint32_t visible_buffer;
+    // lod_count SceneDraw
+    uint32_t draw_buffer;
+};
+static_assert(sizeof(SceneCullConstants) <= 128, "push constants past the guaranteed maxPushConstantsSize");
+
+// the rest of what instance_cull_main needs does not fit the push constants, it goes through the
+// uniform ring with the UniformBufferObject descriptor. Layout matches SceneCullUniforms in shader.slang
+struct SceneCullUniforms {
+    glm::vec4 planes[6];
+    // bounding sphere of the model
+    glm::vec4 sphere;
+    // xyz model space camera, w scales error / distance to multiples of CONFIG_LOD_ERROR_PIXELS
+    glm::vec4 camera;
+    // MeshLod::error of every LOD
+    glm::vec4 lod_errors[MeshCache::MAX_LODS / 4];
+};
+static_assert(sizeof(SceneCullUniforms) <= sizeof(UniformBufferObject), "past the range of the uniform descriptor");
+
+// arguments of the draw of one LOD in a scene, layout matches the SCENE_DRAW_* offsets in shader.slang
+struct SceneDraw {
+    vk::DrawIndexedIndirectCommand draw;
 };
+static_assert(sizeof(SceneDraw) == 20, "SCENE_DRAW_SIZE in shader.slang");
 
 void Engine::run(void)
 {
-    init_window();
+    this->tracer.open(CONFIG_TRACE_PATH, CONFIG_TRACE_MAX_EVENTS);
+    this->instance_count = CONFIG_SCENE_INSTANCES;
+    this->startup_profiler.start();
+    {
+        auto scope = this->startup_profiler.scope("init_window");
+        init_window();
+    }
+    this->jobs.start(CONFIG_WORKER_THREADS);
+    this->debug_logger.start(
+        std::cerr,
+        CONFIG_DEBUG_LOG_MAX_REPEATS,
+        CONFIG_DEBUG_LOG_MAX_PER_SECOND,
+        CONFIG_DEBUG_LOG_FLUSH_MS
+    );
     init_vulkan();
     main_loop();
     cleanup();
 }
 
+double Engine::bench_init(const BenchOptions &options)
+{
+    this->bench_options = options;
+    this->instance_count = options.instances;
+
+    this->startup_profiler.start();
+    {
+        auto scope = this->startup_profiler.scope("init_window");
+        init_window();
+    }
+    this->jobs.start(CONFIG_WORKER_THREADS);
+    this->debug_logger.start(
+        std::cerr,
+        CONFIG_DEBUG_LOG_MAX_REPEATS,
+        CONFIG_DEBUG_LOG_MAX_PER_SECOND,
+        CONFIG_DEBUG_LOG_FLUSH_MS
+    );
+    init_vulkan();
+    {
+        auto scope = this->startup_profiler.scope("first_frame");
+        draw_frame(this->current_frame);
+        this->current_frame = (this->current_frame + 1) % CONFIG_VK_MAX_FRAMES_IN_FLIGHT;
+    }
+
+    // timings of the first frame are part of startup
+    this->gpu_profiler.collect();
+
+    return this->startup_profiler.total_ms();
+}
+
+BenchFrame Engine::bench_frame(uint32_t frame)
+{
+    this->bench_frame_idx = frame;
+
+    auto start = std::chrono::steady_clock::now();
+
+    glfwPollEvents();
+    draw_frame(this->current_frame);
+    this->current_frame = (this->current_frame + 1) % CONFIG_VK_MAX_FRAMES_IN_FLIGHT;
+
+    auto end = std::chrono::steady_clock::now();
+
+    // draw_frame waited for the fence, the frame's passes are ready to be read back
+    return {
+        std::chrono::duration<double, std::milli>(end - start).count(),
+        this->gpu_profiler.enabled() ? this->gpu_profiler.collect() : -1.0,
+    };
+}
+
+void Engine::bench_cleanup(void)
+{
+    this->device.waitIdle();
+    cleanup();
+}
+
 void Engine::init_window(void)
 {
+    uint32_t width  = CONFIG_WINDOW_WIDTH;
+    uint32_t height = CONFIG_WINDOW_HEIGHT;
+
+    if (this->bench_options) {
+        width = this->bench_options->width;
+        height = this->bench_options->height;
+    }
+    if (this->bench_options && this->bench_options->headless) {
+#ifdef GLFW_PLATFORM_NULL
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+        throw std::runtime_error("headless benchmark needs GLFW 3.4 (null platform)");
+#endif
+    }
+
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    if (CONFIG_WINDOW_RESIZABLE) {
+    if (CONFIG_WINDOW_RESIZABLE && not this->bench_options) {
         glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     } else {
         glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     }
 
     this->window = glfwCreateWindow(
-        CONFIG_WINDOW_WIDTH,
-        CONFIG_WINDOW_HEIGHT,
+        width,
+        height,
         "vulkan",
         nullptr,
         nullptr
     );
+
+    glfwSetWindowUserPointer(this->window, this);
+    glfwSetFramebufferSizeCallback(this->window, &Engine::framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(this->window, &Engine::refresh_callback);
 }
 
 void Engine::init_vulkan(void)
 {
-    create_instance();
-    setup_debug_messanger();
-    create_surface();
-    pick_physical_device();
-    create_logical_device();
-    create_swapchain();
-    create_image_views();
-    create_color_resources();
-    create_depth_resources();
-    create_descriptor_set_layout();
-    create_graphics_pipeline();
-    create_command_pool();
-    create_texture_image();
-    create_texture_image_view();
-    create_texture_sampler();
-    load_model();
-    create_vertex_buffer();
-    create_index_buffer();
-    create_uniform_buffers();
-    create_command_buffers();
-    create_descriptor_pool();
-    create_descriptor_sets();
-    create_sync_objects();
-    create_swapchain_sync_objects();
+    using InitFunction = void (Engine::*)(void);
+
+    static constexpr std::pair<const char *, InitFunction> phases[] = {
+        { "start_asset_jobs", &Engine::start_asset_jobs },
+        { "create_instance", &Engine::create_instance },
+        { "setup_debug_messanger", &Engine::setup_debug_messanger },
+        { "create_surface", &Engine::create_surface },
+        { "pick_physical_device", &Engine::pick_physical_device },
+        { "create_logical_device", &Engine::create_logical_device },
+        { "create_swapchain", &Engine::create_swapchain },
+        { "create_image_views", &Engine::create_image_views },
+        { "create_color_resources", &Engine::create_color_resources },
+        { "create_depth_resources", &Engine::create_depth_resources },
+        { "create_descriptor_set_layout", &Engine::create_descriptor_set_layout },
+        { "create_bindless_heap", &Engine::create_bindless_heap },
+        { "create_pipeline_cache", &Engine::create_pipeline_cache },
+        { "create_graphics_pipeline", &Engine::create_graphics_pipeline },
+        { "create_cull_pipeline", &Engine::create_cull_pipeline },
+        { "create_command_pool", &Engine::create_command_pool },
+        { "create_gpu_profiler", &Engine::create_gpu_profiler },
+        { "create_texture_image", &Engine::create_texture_image },
+        { "create_texture_image_view", &Engine::create_texture_image_view },
+        { "create_texture_sampler", &Engine::create_texture_sampler },
+        { "create_vertex_buffer", &Engine::create_vertex_buffer },
+        { "create_index_buffer", &Engine::create_index_buffer },
+        { "create_cull_buffers", &Engine::create_cull_buffers },
+        { "create_scene_buffers", &Engine::create_scene_buffers },
+        { "create_uniform_buffers", &Engine::create_uniform_buffers },
+        { "create_material_buffer", &Engine::create_material_buffer },
+        { "create_command_buffers", &Engine::create_command_buffers },
+        { "create_secondary_command_buffers", &Engine::create_secondary_command_buffers },
+        { "create_descriptor_pool", &Engine::create_descriptor_pool },
+        { "create_descriptor_sets", &Engine::create_descriptor_sets },
+        { "create_sync_objects", &Engine::create_sync_objects },
+        { "create_swapchain_sync_objects", &Engine::create_swapchain_sync_objects },
+    };
+
+    for (const auto &[name, function] : phases) {
+        auto scope = this->startup_profiler.scope(name);
+        auto zone = this->tracer.zone(name);
+        (this->*function)();
+    }
 }
 
 void Engine::create_instance(void)
@@ -169,7 +343,8 @@ void Engine::setup_debug_messanger(void)
         {},
         severity_flags,
         message_type_flags,
-        &debug_callback
+        &debug_callback,
+        &this->debug_logger
     );
 
     this->debug_messenger = this->instance.createDebugUtilsMessengerEXT(create_info);
@@ -233,15 +408,49 @@ void Engine::create_logical_device(void)
 
     this->queue_index = get_queue_family_index(this->physical_device, this->surface);
 
+    this->calibrated_timestamps = supports_calibrated_timestamps(this->physical_device);
+    if (this->calibrated_timestamps) {
+        extensions.push_back(vk::KHRCalibratedTimestampsExtensionName);
+    }
+
+    bool memory_budget = supports_memory_budget(this->physical_device);
+    if (memory_budget) {
+        extensions.push_back(vk::EXTMemoryBudgetExtensionName);
+    }
+
+    this->packed_vertices = CONFIG_VERTEX_QUANTIZE && supports_packed_vertices(this->physical_device);
+
+    // statistics queries may only stay active across vkCmdExecuteCommands with inheritedQueries
+    this->inherited_queries = this->physical_device.getFeatures().inheritedQueries;
+
+    // optional, a baked texture in a format the device can't sample falls back to the PNG
+    vk::PhysicalDeviceFeatures features = this->physical_device.getFeatures();
+
     vk::StructureChain<vk::PhysicalDeviceFeatures2,
                        vk::PhysicalDeviceVulkan11Features,
+                       vk::PhysicalDeviceVulkan12Features,
                        vk::PhysicalDeviceVulkan13Features,
                        vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> feature_chain = {
+        // every feature set to true is required by get_physical_device_score, the rest are queried above
         vk::PhysicalDeviceFeatures2().features
             .setSamplerAnisotropy(true)
-            .setSampleRateShading(true),
+            .setSampleRateShading(true)
+            // bindless arrays are indexed with push constant values
+            .setShaderSampledImageArrayDynamicIndexing(true)
+            .setShaderStorageBufferArrayDynamicIndexing(true)
+            .setPipelineStatisticsQuery(this->physical_device.getFeatures().pipelineStatisticsQuery)
+            .setInheritedQueries(this->inherited_queries)
+            .setTextureCompressionBC(features.textureCompressionBC)
+            .setTextureCompressionASTC_LDR(features.textureCompressionASTC_LDR),
         vk::PhysicalDeviceVulkan11Features()
             .setShaderDrawParameters(true),
+        vk::PhysicalDeviceVulkan12Features()
+            .setDescriptorIndexing(true)
+            .setRuntimeDescriptorArray(true)
+            .setDescriptorBindingPartiallyBound(true)
+            .setDescriptorBindingSampledImageUpdateAfterBind(true)
+            .setDescriptorBindingStorageBufferUpdateAfterBind(true)
+            .setDescriptorBindingUpdateUnusedWhilePending(true),
         vk::PhysicalDeviceVulkan13Features()
             .setSynchronization2(true)
             .setDynamicRendering(true),
@@ -265,6 +474,8 @@ void Engine::create_logical_device(void)
 
     this->device = vk::raii::Device(this->physical_device, create_info);
     this->queue = vk::raii::Queue(this->device, this->queue_index, 0);
+
+    this->memory_tracker.init(this->physical_device, memory_budget, CONFIG_MEMORY_BUDGET_WARN_PCT);
 }
 
 void Engine::create_swapchain(void)
@@ -286,6 +497,12 @@ void Engine::create_swapchain(void)
         std::cout << this->swapchain_extent.width << 'x' << this->swapchain_extent.height << '\n';
     }
 
+    // handing the retired swapchain over lets the presentation engine reuse its resources
+    vk::SwapchainKHR old_swapchain = nullptr;
+    if (not this->retired_swapchains.empty()) {
+        old_swapchain = *this->retired_swapchains.back().swapchain;
+    }
+
     vk::SwapchainCreateInfoKHR create_info(
         {},
         surface,
@@ -300,7 +517,8 @@ void Engine::create_swapchain(void)
         surface_capabilities.currentTransform,
         vk::CompositeAlphaFlagBitsKHR::eOpaque,
         choose_swapchain_present_mode(this->physical_device, this->surface),
-        true
+        true,
+        old_swapchain
     );
 
     this->swapchain = vk::raii::SwapchainKHR(device, create_info);
@@ -341,21 +559,13 @@ void Engine::create_descriptor_set_layout(void)
 {
     vk::DescriptorSetLayoutBinding ubo_binding(
         0,
-        vk::DescriptorType::eUniformBuffer,
-        1,
-        vk::ShaderStageFlagBits::eVertex
-    );
-
-    vk::DescriptorSetLayoutBinding sampler_binding(
-        1,
-        vk::DescriptorType::eCombinedImageSampler,
+        vk::DescriptorType::eUniformBufferDynamic,
         1,
-        vk::ShaderStageFlagBits::eFragment
+        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eCompute
     );
 
     std::vector<vk::DescriptorSetLayoutBinding> bindings = {
         ubo_binding,
-        sampler_binding,
     };
 
     vk::DescriptorSetLayoutCreateInfo layout_info(
@@ -365,6 +575,50 @@ void Engine::create_descriptor_set_layout(void)
     this->descriptor_layout = vk::raii::DescriptorSetLayout(this->device, layout_info);
 }
 
+void Engine::create_bindless_heap(void)
+{
+    this->bindless_heap.init(
+        this->physical_device,
+        this->device,
+        CONFIG_BINDLESS_MAX_TEXTURES,
+        CONFIG_BINDLESS_MAX_SAMPLERS,
+        CONFIG_BINDLESS_MAX_BUFFERS
+    );
+}
+
+void Engine::create_pipeline_cache(void)
+{
+    std::vector<char> data;
+
+    try {
+        data = read_file(CONFIG_PIPELINE_CACHE_PATH);
+    } catch (const std::runtime_error &) {
+        // no cache on disk yet - start with empty one
+    }
+
+    // driver may reject or even crash on blobs from other devices/drivers - never pass them
+    if (not data.empty() &&
+        not is_pipeline_cache_compatible(data, this->physical_device.getProperties())) {
+        if (CONFIG_DEBUG_VERBOSE) {
+            std::cout << "pipeline cache " << CONFIG_PIPELINE_CACHE_PATH << " is stale, ignoring\n";
+        }
+        data.clear();
+    }
+
+    if (CONFIG_DEBUG_VERBOSE) {
+        std::cout << "pipeline cache: " << (data.empty() ? "cold" : "warm")
+                  << " (" << data.size() << " bytes)\n";
+    }
+
+    vk::PipelineCacheCreateInfo create_info(
+        {},
+        data.size(),
+        data.data()
+    );
+
+    this->pipeline_cache = vk::raii::PipelineCache(this->device, create_info);
+}
+
 void Engine::create_graphics_pipeline(void)
 {
     vk::raii::ShaderModule shader_module = create_shader_module(
@@ -391,8 +645,10 @@ void Engine::create_graphics_pipeline(void)
     };
 
     // vertex input state
-    auto binding_description = Vertex::get_binding_description();
-    auto attribute_descriptions = Vertex::get_attribute_descriptions();
+    auto binding_description = this->packed_vertices ? PackedVertex::get_binding_description()
+                                                     : Vertex::get_binding_description();
+    auto attribute_descriptions = this->packed_vertices ? PackedVertex::get_attribute_descriptions()
+                                                        : Vertex::get_attribute_descriptions();
     vk::PipelineVertexInputStateCreateInfo vertex_input(
         {},
         binding_description,
@@ -476,10 +732,19 @@ void Engine::create_graphics_pipeline(void)
     );
 
     // pipeline layout
+    std::vector<vk::DescriptorSetLayout> set_layouts = {
+        *this->bindless_heap.get_layout(),
+        *this->descriptor_layout,
+    };
+    vk::PushConstantRange push_constant_range(
+        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+        0,
+        sizeof(DrawConstants)
+    );
     vk::PipelineLayoutCreateInfo pipeline_layout_create_info(
         {},
-        *this->descriptor_layout,
-        {}
+        set_layouts,
+        push_constant_range
     );
     this->pipeline_layout = vk::raii::PipelineLayout(
         this->device,
@@ -514,7 +779,68 @@ void Engine::create_graphics_pipeline(void)
         &pipeline_rendering
     );
 
-    this->pipeline = vk::raii::Pipeline(this->device, nullptr, pipeline_create_info);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    this->pipeline = vk::raii::Pipeline(this->device, this->pipeline_cache, pipeline_create_info);
+
+    if (CONFIG_DEBUG_VERBOSE) {
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "graphics pipeline created in "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+    }
+}
+
+void Engine::create_cull_pipeline(void)
+{
+    if (not CONFIG_GPU_CULLING && this->instance_count == 0) {
+        return;
+    }
+
+    vk::raii::ShaderModule shader_module = create_shader_module(
+        this->device,
+        read_file(CONFIG_SHADER_SPV_PATH)
+    );
+
+    // buffers are reached through the bindless heap, everything else is push constants or, for
+    // instance_cull_main, SceneCullUniforms in the uniform ring
+    std::vector<vk::DescriptorSetLayout> set_layouts = {
+        *this->bindless_heap.get_layout(),
+        *this->descriptor_layout,
+    };
+    vk::PushConstantRange push_constant_range(
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        std::max(sizeof(CullConstants), sizeof(SceneCullConstants))
+    );
+    vk::PipelineLayoutCreateInfo pipeline_layout_create_info(
+        {},
+        set_layouts,
+        push_constant_range
+    );
+    this->cull_pipeline_layout = vk::raii::PipelineLayout(
+        this->device,
+        pipeline_layout_create_info
+    );
+
+    auto create_pipeline = [&](const char *entry_point) {
+        vk::ComputePipelineCreateInfo pipeline_create_info(
+            {},
+            vk::PipelineShaderStageCreateInfo(
+                {},
+                vk::ShaderStageFlagBits::eCompute,
+                shader_module,
+                entry_point
+            ),
+            this->cull_pipeline_layout
+        );
+        return vk::raii::Pipeline(this->device, this->pipeline_cache, pipeline_create_info);
+    };
+
+    if (this->instance_count > 0) {
+        this->scene_cull_pipeline = create_pipeline("instance_cull_main");
+    } else {
+        this->cull_pipeline = create_pipeline("cull_main");
+    }
 }
 
 void Engine::create_color_resources(void)
@@ -528,7 +854,8 @@ void Engine::create_color_resources(void)
         1,
         this->msaa_samples,
         vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Attachment
     );
 
     this->color_image_view = create_image_view(
@@ -554,7 +881,8 @@ void Engine::create_depth_resources(void)
         1,
         this->msaa_samples,
         vk::ImageUsageFlagBits::eDepthStencilAttachment,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Attachment
     );
 
     this->depth_image_view = create_image_view(
@@ -565,21 +893,63 @@ void Engine::create_depth_resources(void)
     );
 }
 
+void Engine::start_asset_jobs(void)
+{
+    // CPU side of asset loading overlaps with instance, device and pipeline creation,
+    // consumers wait on the counters right before they need the data
+    this->jobs.run([this]() { load_model(); }, &this->model_loaded);
+    this->jobs.run([this]() { decode_texture(); }, &this->texture_decoded);
+}
+
+void Engine::decode_texture(void)
+{
+    auto zone = this->tracer.zone("decode_texture");
+
+    // a baked texture only needs mapping, its mips and block compression were done by bake.elf.
+    // One baked from an older CONFIG_TEXTURE_PATH is ignored until make bake-run is run again
+    if (this->texture_file.open(CONFIG_TEXTURE_KTX2_PATH, CONFIG_TEXTURE_PATH)) {
+        this->texture_width  = this->texture_file.get_width();
+        this->texture_height = this->texture_file.get_height();
+        return;
+    }
+
+    decode_png();
+}
+
+void Engine::decode_png(void)
+{
+    std::vector<DecodedImage> images = decode_images(std::array<std::string, 1>{ CONFIG_TEXTURE_PATH }, this->jobs);
+
+    this->texture_pixels = std::move(images[0].pixels);
+    this->texture_width  = images[0].width;
+    this->texture_height = images[0].height;
+}
+
 void Engine::create_texture_image(void)
 {
-    int width, height, channels;
+    this->jobs.wait(this->texture_decoded);
 
-    stbi_uc *pixels = stbi_load(
-        CONFIG_TEXTURE_PATH,
-        &width,
-        &height,
-        &channels,
-        STBI_rgb_alpha
-    );
-    if (pixels == nullptr) {
-        throw std::runtime_error("failed to load texture at path "s + CONFIG_TEXTURE_PATH);
+    if (this->texture_file.is_open()) {
+        if (supports_texture_format(this->physical_device, this->texture_file.get_format())) {
+            create_baked_texture_image();
+            return;
+        }
+
+        std::cerr << CONFIG_TEXTURE_KTX2_PATH << ": " << vk::to_string(this->texture_file.get_format())
+                  << " can't be sampled, loading " << CONFIG_TEXTURE_PATH << " instead\n";
+        this->texture_file.close();
+        decode_png();
+    }
+
+    // blits need linear filtering of the format, which is optional
+    if (CONFIG_TEXTURE_CPU_MIPS || not supports_blit_mipmaps(this->physical_device, this->texture_format)) {
+        create_cpu_mipped_texture_image();
+        return;
     }
 
+    int width  = this->texture_width;
+    int height = this->texture_height;
+
     this->mip_levels = std::floor(std::log2(std::max(width, height))) + 1;
 
     vk::DeviceSize size = width * height * 4;
@@ -587,14 +957,15 @@ void Engine::create_texture_image(void)
     auto [staging_buffer, staging_buffer_mem] = create_buffer(
         size,
         vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging
     );
 
     void *ptr = staging_buffer_mem.mapMemory(0, size);
-    memcpy(ptr, pixels, size);
+    memcpy(ptr, this->texture_pixels.get(), size);
     staging_buffer_mem.unmapMemory();
 
-    stbi_image_free(pixels);
+    this->texture_pixels.reset();
 
     vk::ImageUsageFlags usage =
         vk::ImageUsageFlagBits::eTransferSrc |
@@ -607,7 +978,8 @@ void Engine::create_texture_image(void)
         this->mip_levels,
         vk::SampleCountFlagBits::e1,
         usage,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Texture
     );
 
     vk::raii::CommandBuffer cb = begin_single_time_commands(this->command_pool);
@@ -624,9 +996,136 @@ void Engine::create_texture_image(void)
         vk::PipelineStageFlagBits2::eTransfer
     );
 
+    uint32_t pass = this->gpu_profiler.begin_pass(cb, "upload");
     copy_buffer_to_image(cb, this->texture_image, staging_buffer, width, height);
+    this->gpu_profiler.end_pass(cb, pass);
 
+    pass = this->gpu_profiler.begin_pass(cb, "mipmaps");
     generate_mipmaps(cb, this->texture_image, this->mip_levels, width, height);
+    this->gpu_profiler.end_pass(cb, pass);
+
+    end_single_time_commands(std::move(cb));
+}
+
+void Engine::create_baked_texture_image(void)
+{
+    this->texture_format = this->texture_file.get_format();
+
+    std::vector<std::span<const uint8_t>> levels;
+    for (uint32_t level = 0; level < this->texture_file.get_level_count(); level++) {
+        levels.push_back(this->texture_file.get_level(level));
+    }
+    upload_texture_levels(levels);
+
+    this->texture_file.close();
+
+    if (CONFIG_DEBUG_VERBOSE) {
+        std::cout << "baked texture " << CONFIG_TEXTURE_KTX2_PATH << ": " << vk::to_string(this->texture_format)
+                  << ", " << this->mip_levels << " levels\n";
+    }
+}
+
+void Engine::create_cpu_mipped_texture_image(void)
+{
+    std::vector<std::vector<uint8_t>> levels;
+    {
+        auto zone = this->tracer.zone("generate_mips");
+        levels = generate_mips(
+            this->texture_pixels.get(),
+            this->texture_width,
+            this->texture_height,
+            CONFIG_TEXTURE_MIP_FILTER,
+            this->jobs
+        );
+    }
+    this->texture_pixels.reset();
+
+    upload_texture_levels(std::vector<std::span<const uint8_t>>(levels.begin(), levels.end()));
+}
+
+// image of texture_format with levels as its mips, level 0 of texture_width x texture_height
+void Engine::upload_texture_levels(const std::vector<std::span<const uint8_t>> &levels)
+{
+    uint32_t width  = this->texture_width;
+    uint32_t height = this->texture_height;
+
+    this->mip_levels = levels.size();
+
+    // every level goes into one staging buffer, at offsets that are a multiple of any block size
+    std::vector<vk::BufferImageCopy> regions;
+    vk::DeviceSize                   size = 0;
+    for (uint32_t level = 0; level < this->mip_levels; level++) {
+        regions.emplace_back(
+            size,
+            0,
+            0,
+            vk::ImageSubresourceLayers(
+                vk::ImageAspectFlagBits::eColor,
+                level,
+                0,
+                1
+            ),
+            vk::Offset3D{ 0, 0, 0 },
+            vk::Extent3D{ std::max(width >> level, 1u), std::max(height >> level, 1u), 1 }
+        );
+        size += (levels[level].size() + 15) & ~vk::DeviceSize(15);
+    }
+
+    auto [staging_buffer, staging_buffer_mem] = create_buffer(
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging
+    );
+
+    uint8_t *ptr = static_cast<uint8_t *>(staging_buffer_mem.mapMemory(0, size));
+    for (uint32_t level = 0; level < this->mip_levels; level++) {
+        memcpy(ptr + regions[level].bufferOffset, levels[level].data(), levels[level].size());
+    }
+    staging_buffer_mem.unmapMemory();
+
+    std::tie(this->texture_image, this->texture_image_mem) = create_image(
+        width,
+        height,
+        this->texture_format,
+        this->mip_levels,
+        vk::SampleCountFlagBits::e1,
+        vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Texture
+    );
+
+    vk::raii::CommandBuffer cb = begin_single_time_commands(this->command_pool);
+    transition_image_layout(
+        cb,
+        this->texture_image,
+        this->mip_levels,
+        vk::ImageAspectFlagBits::eColor,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eTransferDstOptimal,
+        {},
+        vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eTopOfPipe,
+        vk::PipelineStageFlagBits2::eTransfer
+    );
+
+    // no blit chain, every level is already there
+    uint32_t pass = this->gpu_profiler.begin_pass(cb, "upload");
+    cb.copyBufferToImage(staging_buffer, this->texture_image, vk::ImageLayout::eTransferDstOptimal, regions);
+    this->gpu_profiler.end_pass(cb, pass);
+
+    transition_image_layout(
+        cb,
+        this->texture_image,
+        this->mip_levels,
+        vk::ImageAspectFlagBits::eColor,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::AccessFlagBits2::eTransferWrite,
+        vk::AccessFlagBits2::eShaderSampledRead,
+        vk::PipelineStageFlagBits2::eTransfer,
+        vk::PipelineStageFlagBits2::eFragmentShader
+    );
 
     end_single_time_commands(std::move(cb));
 }
@@ -635,7 +1134,7 @@ void Engine::create_texture_image_view(void)
 {
     this->texture_image_view = create_image_view(
         this->texture_image,
-        vk::Format::eR8G8B8A8Srgb,
+        this->texture_format,
         vk::ImageAspectFlagBits::eColor,
         this->mip_levels
     );
@@ -669,60 +1168,184 @@ void Engine::create_texture_sampler(void)
 
 void Engine::load_model(void)
 {
-    tinyobj::attrib_t                attrib;
-    std::vector<tinyobj::shape_t>    shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string                      warn, err;
-    std::unordered_map<Vertex, uint32_t> uniq_vertices;
+    auto zone = this->tracer.zone("load_model");
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, CONFIG_MODEL_PATH)) {
-        throw std::runtime_error(warn + err);
-    }
+    std::vector<MeshLod> mesh_lods;
 
-    for (const tinyobj::shape_t &shape : shapes) {
-        for (const tinyobj::index_t &index : shape.mesh.indices) {
-            Vertex vertex;
+    // a cache built with other settings is rebuilt
+    MeshCache::Settings settings = {
+        .optimize                    = CONFIG_MESH_OPTIMIZE,
+        .optimize_cache_size         = CONFIG_MESH_OPTIMIZE_CACHE_SIZE,
+        .optimize_overdraw_threshold = CONFIG_MESH_OPTIMIZE_OVERDRAW_THRESHOLD,
+        .lod_count                   = std::min<uint32_t>(CONFIG_LOD_COUNT, MeshCache::MAX_LODS),
+        .lod_ratio                   = CONFIG_LOD_RATIO,
+    };
 
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2],
-            };
+    if (std::string(CONFIG_MESH_CACHE_PATH).empty() ||
+        not this->mesh_cache.open(CONFIG_MESH_CACHE_PATH, CONFIG_MODEL_PATH, settings, CONFIG_MESH_CACHE_VERIFY)) {
+        load_obj(CONFIG_MODEL_PATH, this->jobs, this->vertices, this->indices);
+
+        if (CONFIG_MESH_OPTIMIZE) {
+            auto optimize_zone = this->tracer.zone("optimize_mesh");
+            auto [before, after] = optimize_mesh(
+                this->vertices,
+                this->indices,
+                CONFIG_MESH_OPTIMIZE_CACHE_SIZE,
+                CONFIG_MESH_OPTIMIZE_OVERDRAW_THRESHOLD
+            );
+
+            if (CONFIG_DEBUG_VERBOSE) {
+                std::cout << "mesh optimized: ACMR " << before.acmr << " -> " << after.acmr
+                          << ", ATVR " << before.atvr << " -> " << after.atvr << '\n';
+            }
+        }
 
-            vertex.tex_coord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-            };
+        {
+            // every LOD indexes the same vertices, in the order LOD 0 was optimized for
+            auto lod_zone = this->tracer.zone("build_lod_chain");
+            mesh_lods = build_lod_chain(
+                this->indices,
+                this->vertices,
+                settings.lod_count,
+                settings.lod_ratio
+            );
+            if (CONFIG_MESH_OPTIMIZE) {
+                for (size_t i = 1; i < mesh_lods.size(); i++) {
+                    optimize_vertex_cache(
+                        std::span(this->indices).subspan(mesh_lods[i].first_index, mesh_lods[i].index_count),
+                        this->vertices.size(),
+                        CONFIG_MESH_OPTIMIZE_CACHE_SIZE
+                    );
+                }
+            }
+        }
 
-            auto [it, inserted] = uniq_vertices.insert({vertex, this->vertices.size()});
-            if (inserted) {
-                vertices.push_back(vertex);
+        if (CONFIG_DEBUG_VERBOSE) {
+            for (size_t i = 0; i < mesh_lods.size(); i++) {
+                std::cout << "LOD " << i << ": " << mesh_lods[i].index_count / 3 << " triangles, error "
+                          << mesh_lods[i].error << '\n';
             }
+        }
 
-            this->indices.push_back(it->second);
+        this->vertex_data = this->vertices;
+        this->index_data = this->indices;
+        this->mesh_bounds = MeshCache::compute_bounds(this->vertices);
+
+        if (not std::string(CONFIG_MESH_CACHE_PATH).empty()) {
+            try {
+                write_file_atomic(
+                    CONFIG_MESH_CACHE_PATH,
+                    MeshCache::serialize(CONFIG_MODEL_PATH, settings, this->vertices, this->indices, mesh_lods)
+                );
+            } catch (const std::exception &e) {
+                std::cerr << "failed to save mesh cache: " << e.what() << '\n';
+            }
         }
+    } else {
+        // no per-vertex work, the staging copies read straight from the mapping
+        this->vertex_data = this->mesh_cache.get_vertices();
+        this->index_data = this->mesh_cache.get_indices();
+        this->mesh_bounds = this->mesh_cache.get_bounds();
+        std::span<const MeshLod> cached_lods = this->mesh_cache.get_lods();
+        mesh_lods.assign(cached_lods.begin(), cached_lods.end());
+    }
+    if (mesh_lods.empty()) {
+        mesh_lods.push_back({ 0, uint32_t(this->index_data.size()), 0.0f });
     }
 
+    glm::vec3 center = (this->mesh_bounds.min + this->mesh_bounds.max) * 0.5f;
+    float     radius = glm::length(this->mesh_bounds.max - this->mesh_bounds.min) * 0.5f;
+    this->model_sphere = glm::vec4(center, radius);
+
+    for (const MeshLod &mesh_lod : mesh_lods) {
+        ModelLod lod = {};
+        lod.mesh = mesh_lod;
+
+        std::span<const uint32_t> lod_indices = this->index_data.subspan(mesh_lod.first_index, mesh_lod.index_count);
+        if (CONFIG_GPU_CULLING && this->instance_count == 0) {
+            auto meshlet_zone = this->tracer.zone("build_meshlets");
+
+            // 16 meshlets are 768 bytes, every LOD starts at a multiple of any minStorageBufferOffsetAlignment
+            this->meshlets.resize((this->meshlets.size() + 15) / 16 * 16, Meshlet {});
+            std::vector<Meshlet> meshlets = build_meshlets(
+                lod_indices,
+                this->vertex_data,
+                CONFIG_MESHLET_MAX_VERTICES,
+                CONFIG_MESHLET_MAX_TRIANGLES
+            );
+            for (Meshlet &meshlet : meshlets) {
+                meshlet.first_index += mesh_lod.first_index;
+            }
+            lod.first_meshlet = this->meshlets.size();
+            lod.meshlet_count = meshlets.size();
+            this->meshlets.insert(this->meshlets.end(), meshlets.begin(), meshlets.end());
+        }
+
+        // split the mesh into chunks so the draw list is long enough to spread over recording threads
+        uint32_t chunk = CONFIG_DRAW_CHUNK_TRIANGLES ? CONFIG_DRAW_CHUNK_TRIANGLES * 3 : lod_indices.size();
+        lod.first_draw = this->draws.size();
+        for (uint32_t first = 0; first < lod_indices.size(); first += chunk) {
+            this->draws.push_back({
+                mesh_lod.first_index + first,
+                std::min<uint32_t>(chunk, lod_indices.size() - first),
+                0
+            });
+        }
+        lod.draw_count = this->draws.size() - lod.first_draw;
+
+        this->lods.push_back(lod);
+    }
 }
 
 void Engine::create_vertex_buffer(void)
 {
-    vk::DeviceSize size = sizeof(this->vertices[0]) * this->vertices.size();
+    this->jobs.wait(this->model_loaded);
+
+    vk::DeviceSize size = this->packed_vertices ? this->vertex_data.size() * sizeof(PackedVertex)
+                                                : this->vertex_data.size_bytes();
 
     auto [staging_buffer, staging_buffer_mem] = create_buffer(
         size,
         vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging
     );
 
     void *ptr = staging_buffer_mem.mapMemory(0, size);
-    memcpy(ptr, this->vertices.data(), size);
+    if (this->packed_vertices) {
+        // a flat axis keeps scale 0, every position on it packs to 0
+        glm::vec3 extent = this->mesh_bounds.max - this->mesh_bounds.min;
+        glm::vec3 inv_extent = glm::vec3(
+            extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+            extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+            extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+        );
+        this->position_offset = glm::vec4(this->mesh_bounds.min, 0.0f);
+        this->position_scale = glm::vec4(extent, 0.0f);
+
+        PackedVertex *packed = static_cast<PackedVertex *>(ptr);
+        size_t        blocks = this->jobs.thread_count();
+        this->jobs.parallel_for(blocks, [&](size_t block) {
+            size_t end = this->vertex_data.size() * (block + 1) / blocks;
+            for (size_t i = this->vertex_data.size() * block / blocks; i < end; i++) {
+                packed[i] = pack_vertex(this->vertex_data[i], this->mesh_bounds.min, inv_extent);
+            }
+        });
+    } else {
+        memcpy(ptr, this->vertex_data.data(), size);
+    }
     staging_buffer_mem.unmapMemory();
 
+    if (CONFIG_DEBUG_VERBOSE) {
+        std::cout << "vertex buffer: " << this->vertex_data.size() << " vertices, "
+                  << (this->packed_vertices ? "packed, " : "") << size / 1024 << " KiB\n";
+    }
+
     std::tie(this->vertex_buffer, this->vertex_buffer_mem) = create_buffer(
         size,
         vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Vertex
     );
 
     copy_buffer(this->vertex_buffer, staging_buffer, size);
@@ -730,44 +1353,226 @@ void Engine::create_vertex_buffer(void)
 
 void Engine::create_index_buffer(void)
 {
-    vk::DeviceSize size = sizeof(this->indices[0]) * this->indices.size();
+    vk::DeviceSize size = this->index_data.size_bytes();
 
     auto [staging_buffer, staging_buffer_mem] = create_buffer(
         size,
         vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging
     );
 
     void *ptr = staging_buffer_mem.mapMemory(0, size);
-    memcpy(ptr, this->indices.data(), size);
+    memcpy(ptr, this->index_data.data(), size);
     staging_buffer_mem.unmapMemory();
 
+    // the meshlet culling pass reads it as a storage buffer
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    if (not this->meshlets.empty()) {
+        usage |= vk::BufferUsageFlagBits::eStorageBuffer;
+    }
+
     std::tie(this->index_buffer, this->index_buffer_mem) = create_buffer(
         size,
-        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
+        usage,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Index
     );
 
     copy_buffer(this->index_buffer, staging_buffer, size);
 }
 
-void Engine::create_uniform_buffers(void)
+void Engine::create_cull_buffers(void)
 {
-    this->uniform_buffers.clear();
+    if (not CONFIG_GPU_CULLING || this->meshlets.empty()) {
+        return;
+    }
 
-    for (int i = 0; i < CONFIG_VK_MAX_FRAMES_IN_FLIGHT; i++) {
-        vk::DeviceSize size = sizeof(UniformBufferObject);
+    // cull_main addresses the whole index buffer through one storage buffer descriptor
+    vk::DeviceSize index_size = this->index_data.size_bytes();
+    if (index_size > this->physical_device.getProperties().limits.maxStorageBufferRange) {
+        std::cerr << "index buffer exceeds maxStorageBufferRange, drawing without GPU culling\n";
+        return;
+    }
 
-        auto [buffer, buffer_mem] = create_buffer(
-            size,
-            vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-        );
+    vk::DeviceSize meshlet_size = this->meshlets.size() * sizeof(Meshlet);
 
-        this->uniform_buffers_map.emplace_back(std::move(buffer_mem.mapMemory(0, size)));
-        this->uniform_buffers.emplace_back(std::move(buffer));
-        this->uniform_buffers_mem.emplace_back(std::move(buffer_mem));
-    }
+    auto [staging_buffer, staging_buffer_mem] = create_buffer(
+        meshlet_size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging
+    );
+
+    void *ptr = staging_buffer_mem.mapMemory(0, meshlet_size);
+    memcpy(ptr, this->meshlets.data(), meshlet_size);
+    staging_buffer_mem.unmapMemory();
+
+    std::tie(this->meshlet_buffer, this->meshlet_buffer_mem) = create_buffer(
+        meshlet_size,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Storage
+    );
+
+    copy_buffer(this->meshlet_buffer, staging_buffer, meshlet_size);
+
+    for (ModelLod &lod : this->lods) {
+        lod.meshlet_buffer_id = this->bindless_heap.add_buffer(
+            this->meshlet_buffer,
+            lod.first_meshlet * sizeof(Meshlet),
+            lod.meshlet_count * sizeof(Meshlet)
+        );
+    }
+    this->index_buffer_id = this->bindless_heap.add_buffer(this->index_buffer, 0, index_size);
+
+    // written by the culling pass of every frame, one set per frame in flight. LOD 0 has the most
+    // indices, any LOD fits
+    vk::DeviceSize cull_index_size = this->lods.front().mesh.index_count * sizeof(uint32_t);
+    for (uint32_t frame = 0; frame < CONFIG_VK_MAX_FRAMES_IN_FLIGHT; frame++) {
+        auto [indices, indices_mem] = create_buffer(
+            cull_index_size,
+            vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            MemoryCategory::Index
+        );
+        this->cull_index_buffer_ids.push_back(this->bindless_heap.add_buffer(indices, 0, cull_index_size));
+        this->cull_index_buffers.push_back(std::move(indices));
+        this->cull_index_buffers_mem.push_back(std::move(indices_mem));
+
+        auto [indirect, indirect_mem] = create_buffer(
+            sizeof(vk::DrawIndexedIndirectCommand),
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+                vk::BufferUsageFlagBits::eStorageBuffer |
+                vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            MemoryCategory::Storage
+        );
+        this->cull_indirect_buffer_ids.push_back(
+            this->bindless_heap.add_buffer(indirect, 0, sizeof(vk::DrawIndexedIndirectCommand))
+        );
+        this->cull_indirect_buffers.push_back(std::move(indirect));
+        this->cull_indirect_buffers_mem.push_back(std::move(indirect_mem));
+    }
+
+    this->gpu_culling = true;
+
+    if (CONFIG_DEBUG_VERBOSE) {
+        const ModelLod &lod = this->lods.front();
+        std::cout << "GPU culling: " << lod.meshlet_count << " meshlets in LOD 0, "
+                  << lod.mesh.index_count / 3.0 / lod.meshlet_count << " triangles each on average\n";
+    }
+}
+
+void Engine::create_scene_buffers(void)
+{
+    if (this->instance_count == 0) {
+        return;
+    }
+    if (this->index_data.empty()) {
+        this->instance_count = 0;
+        return;
+    }
+
+    vk::PhysicalDeviceLimits limits = this->physical_device.getProperties().limits;
+    vk::DeviceSize instance_size = this->instance_count * sizeof(glm::mat4);
+    vk::DeviceSize visible_size = this->instance_count * this->lods.size() * sizeof(uint32_t);
+    if (instance_size > limits.maxStorageBufferRange ||
+        visible_size > limits.maxStorageBufferRange ||
+        (this->instance_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE > limits.maxComputeWorkGroupCount[0]) {
+        throw std::runtime_error("scene of " + std::to_string(this->instance_count) + " instances is too large");
+    }
+
+    std::vector<glm::mat4> instances = generate_scene(this->instance_count, this->model_sphere.w, CONFIG_SCENE_SEED);
+
+    auto [staging_buffer, staging_buffer_mem] = create_buffer(
+        instance_size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging
+    );
+
+    void *ptr = staging_buffer_mem.mapMemory(0, instance_size);
+    memcpy(ptr, instances.data(), instance_size);
+    staging_buffer_mem.unmapMemory();
+
+    std::tie(this->instance_buffer, this->instance_buffer_mem) = create_buffer(
+        instance_size,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryCategory::Storage
+    );
+
+    copy_buffer(this->instance_buffer, staging_buffer, instance_size);
+
+    this->instance_buffer_id = this->bindless_heap.add_buffer(this->instance_buffer, 0, instance_size);
+
+    // written by the culling pass of every frame, one set per frame in flight
+    vk::DeviceSize draw_size = this->lods.size() * sizeof(SceneDraw);
+    for (uint32_t frame = 0; frame < CONFIG_VK_MAX_FRAMES_IN_FLIGHT; frame++) {
+        auto [visible, visible_mem] = create_buffer(
+            visible_size,
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            MemoryCategory::Storage
+        );
+        this->visible_buffer_ids.push_back(this->bindless_heap.add_buffer(visible, 0, visible_size));
+        this->visible_buffers.push_back(std::move(visible));
+        this->visible_buffers_mem.push_back(std::move(visible_mem));
+
+        auto [draw, draw_mem] = create_buffer(
+            draw_size,
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+                vk::BufferUsageFlagBits::eStorageBuffer |
+                vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            MemoryCategory::Storage
+        );
+        this->scene_draw_buffer_ids.push_back(this->bindless_heap.add_buffer(draw, 0, draw_size));
+        this->scene_draw_buffers.push_back(std::move(draw));
+        this->scene_draw_buffers_mem.push_back(std::move(draw_mem));
+    }
+
+    if (CONFIG_DEBUG_VERBOSE) {
+        std::cout << "scene: " << this->instance_count << " instances, " << this->lods.size() << " LODs\n";
+    }
+}
+
+void Engine::create_uniform_buffers(void)
+{
+    this->uniform_ring.init(
+        this->physical_device,
+        this->device,
+        this->memory_tracker,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        CONFIG_UNIFORM_RING_FRAME_SIZE,
+        CONFIG_VK_MAX_FRAMES_IN_FLIGHT
+    );
+}
+
+void Engine::create_material_buffer(void)
+{
+    std::vector<Material> materials = {
+        {
+            this->bindless_heap.add_texture(this->texture_image_view, vk::ImageLayout::eShaderReadOnlyOptimal),
+            this->bindless_heap.add_sampler(this->texture_sampler),
+        },
+    };
+    vk::DeviceSize size = sizeof(Material) * materials.size();
+
+    // read once per draw by the fragment shader, not worth a staging copy
+    std::tie(this->material_buffer, this->material_buffer_mem) = create_buffer(
+        size,
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Storage
+    );
+
+    void *ptr = this->material_buffer_mem.mapMemory(0, size);
+    memcpy(ptr, materials.data(), size);
+    this->material_buffer_mem.unmapMemory();
+
+    this->material_buffer_id = this->bindless_heap.add_buffer(this->material_buffer, 0, size);
 }
 
 void Engine::create_command_pool(void)
@@ -780,6 +1585,23 @@ void Engine::create_command_pool(void)
     this->command_pool = vk::raii::CommandPool(this->device, create_info);
 }
 
+void Engine::create_gpu_profiler(void)
+{
+    this->gpu_profiler.init(
+        this->physical_device,
+        this->device,
+        this->queue_index,
+        CONFIG_GPU_PROFILER_LATENCY,
+        CONFIG_GPU_PROFILER_HISTORY,
+        this->physical_device.getFeatures().pipelineStatisticsQuery
+    );
+
+    if (this->tracer.enabled()) {
+        this->gpu_profiler.set_tracer(&this->tracer);
+        this->gpu_profiler.calibrate(this->device, this->queue, this->command_pool, this->calibrated_timestamps);
+    }
+}
+
 void Engine::create_command_buffers(void)
 {
     vk::CommandBufferAllocateInfo allocate_info(
@@ -791,12 +1613,53 @@ void Engine::create_command_buffers(void)
     this->command_buffers = vk::raii::CommandBuffers(this->device, allocate_info);
 }
 
+void Engine::create_secondary_command_buffers(void)
+{
+    if (not CONFIG_PARALLEL_RECORDING) {
+        return;
+    }
+
+    // transient - buffers are re-recorded every frame and freed by resetting the whole pool
+    vk::CommandPoolCreateInfo create_info(
+        vk::CommandPoolCreateFlagBits::eTransient,
+        this->queue_index
+    );
+
+    this->secondary_command_pools.resize(CONFIG_VK_MAX_FRAMES_IN_FLIGHT);
+    this->secondary_command_buffers.resize(CONFIG_VK_MAX_FRAMES_IN_FLIGHT);
+
+    for (uint32_t frame = 0; frame < CONFIG_VK_MAX_FRAMES_IN_FLIGHT; frame++) {
+        for (size_t slice = 0; slice < this->jobs.thread_count(); slice++) {
+            vk::raii::CommandPool &pool = this->secondary_command_pools.at(frame).emplace_back(
+                this->device,
+                create_info
+            );
+
+            vk::CommandBufferAllocateInfo allocate_info(
+                pool,
+                vk::CommandBufferLevel::eSecondary,
+                1
+            );
+            vk::raii::CommandBuffers cbs(this->device, allocate_info);
+            this->secondary_command_buffers.at(frame).emplace_back(std::move(cbs.front()));
+        }
+    }
+}
+
 void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
 {
     vk::raii::CommandBuffer &cb = this->command_buffers.at(frame_index);
+    auto zone = this->tracer.zone("record_command_buffer");
 
     // begin command buffer
     cb.begin({});
+    this->gpu_profiler.begin_frame(cb);
+
+    if (this->instance_count > 0) {
+        record_scene_cull_pass(cb, frame_index);
+    } else if (this->gpu_culling) {
+        record_cull_pass(cb, frame_index);
+    }
 
     // before starting rendering - transition the swapchain image to COLOR_ATTACHMENT_OPTIMAL
     transition_image_layout(
@@ -870,8 +1733,224 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         &depth_attachment_info,
         {}
     );
-    cb.beginRendering(rendering_info);
+    uint32_t pass = this->gpu_profiler.begin_pass(
+        cb,
+        "render",
+        not CONFIG_PARALLEL_RECORDING || this->inherited_queries
+    );
+
+    if (CONFIG_PARALLEL_RECORDING) {
+        // secondaries inherit the dynamic rendering state, the primary only stitches them together
+        // culling leaves one indirect draw, nothing to spread
+        bool   indirect = this->gpu_culling || this->instance_count > 0;
+        size_t slices = std::min(this->jobs.thread_count(), indirect ? 1 : this->lods.at(this->lod).draw_count);
+        record_secondary_command_buffers(frame_index, slices);
+
+        std::vector<vk::CommandBuffer> secondaries;
+        for (size_t slice = 0; slice < slices; slice++) {
+            secondaries.push_back(*this->secondary_command_buffers.at(frame_index).at(slice));
+        }
+
+        rendering_info.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+        cb.beginRendering(rendering_info);
+        cb.executeCommands(secondaries);
+    } else {
+        const ModelLod &lod = this->lods.at(this->lod);
+        cb.beginRendering(rendering_info);
+        record_draws(cb, frame_index, lod.first_draw, lod.first_draw + lod.draw_count);
+    }
+
+    // end rendering
+    cb.endRendering();
+    this->gpu_profiler.end_pass(cb, pass);
+
+    // transition the swapchain image to PRESENT_SRC
+    transition_image_layout(
+        cb,
+        this->swapchain_images.at(image_index),
+        1,
+        vk::ImageAspectFlagBits::eColor,
+        vk::ImageLayout::eColorAttachmentOptimal,
+        vk::ImageLayout::ePresentSrcKHR,
+        vk::AccessFlagBits2::eColorAttachmentWrite,
+        {},
+        vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits2::eBottomOfPipe
+    );
+
+    // end command buffer
+    cb.end();
+}
+
+void Engine::record_secondary_command_buffers(uint32_t frame_index, size_t slices)
+{
+    vk::CommandBufferInheritanceRenderingInfo inheritance_rendering;
+    inheritance_rendering
+        .setColorAttachmentCount(1)
+        .setPColorAttachmentFormats(&this->swapchain_surface_format.format)
+        .setDepthAttachmentFormat(this->depth_format)
+        .setRasterizationSamples(this->msaa_samples);
+
+    vk::CommandBufferInheritanceInfo inheritance;
+    inheritance.setPNext(&inheritance_rendering);
+    if (this->inherited_queries) {
+        inheritance.setPipelineStatistics(this->gpu_profiler.inherited_statistics());
+    }
+
+    vk::CommandBufferBeginInfo begin_info(
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+        &inheritance
+    );
+
+    this->jobs.parallel_for(slices, [&](size_t slice) {
+        auto zone = this->tracer.zone("record_slice");
+
+        // the fence of this frame slot was waited on, nothing recorded from the pool is in flight
+        this->secondary_command_pools.at(frame_index).at(slice).reset();
+
+        const vk::raii::CommandBuffer &cb = this->secondary_command_buffers.at(frame_index).at(slice);
+        const ModelLod                &lod = this->lods.at(this->lod);
+        cb.begin(begin_info);
+        record_draws(
+            cb,
+            frame_index,
+            lod.first_draw + lod.draw_count * slice / slices,
+            lod.first_draw + lod.draw_count * (slice + 1) / slices
+        );
+        cb.end();
+    });
+}
+
+void Engine::record_cull_pass(const vk::raii::CommandBuffer &cb, uint32_t frame_index)
+{
+    uint32_t pass = this->gpu_profiler.begin_pass(cb, "cull");
+
+    // no indices until cull_main adds the visible meshlets
+    cb.updateBuffer<vk::DrawIndexedIndirectCommand>(
+        this->cull_indirect_buffers.at(frame_index),
+        0,
+        vk::DrawIndexedIndirectCommand(0, 1, 0, 0, 0)
+    );
+    vk::MemoryBarrier2 clear_barrier(
+        vk::PipelineStageFlagBits2::eTransfer,
+        vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+    );
+    cb.pipelineBarrier2(vk::DependencyInfo({}, clear_barrier));
+
+    CullConstants constants = {};
+    std::ranges::copy(this->frustum_planes, constants.planes);
+    std::ranges::copy(std::span<const float>(&this->camera_position.x, 3), constants.camera);
+    constants.meshlet_count = this->lods.at(this->lod).meshlet_count;
+    constants.meshlet_buffer = this->lods.at(this->lod).meshlet_buffer_id;
+    constants.index_buffer = this->index_buffer_id;
+    constants.cull_index_buffer = this->cull_index_buffer_ids.at(frame_index);
+    constants.indirect_buffer = this->cull_indirect_buffer_ids.at(frame_index);
+
+    cb.bindPipeline(
+        vk::PipelineBindPoint::eCompute,
+        this->cull_pipeline
+    );
+    cb.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute,
+        this->cull_pipeline_layout,
+        0,
+        { *this->bindless_heap.get_set() },
+        {}
+    );
+    cb.pushConstants<CullConstants>(
+        this->cull_pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        constants
+    );
+    cb.dispatch((constants.meshlet_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    vk::MemoryBarrier2 cull_barrier(
+        vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eShaderStorageWrite,
+        vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eIndexInput,
+        vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eIndexRead
+    );
+    cb.pipelineBarrier2(vk::DependencyInfo({}, cull_barrier));
+
+    this->gpu_profiler.end_pass(cb, pass);
+}
+
+void Engine::record_scene_cull_pass(const vk::raii::CommandBuffer &cb, uint32_t frame_index)
+{
+    uint32_t pass = this->gpu_profiler.begin_pass(cb, "scene_cull");
+
+    // no draws and no instances until instance_cull_main adds the visible ones to their LOD
+    std::array<SceneDraw, MeshCache::MAX_LODS> draws = {};
+    for (size_t i = 0; i < this->lods.size(); i++) {
+        draws[i].draw = vk::DrawIndexedIndirectCommand(
+            this->lods[i].mesh.index_count,
+            0,
+            this->lods[i].mesh.first_index,
+            0,
+            0
+        );
+    }
+    cb.updateBuffer<SceneDraw>(
+        this->scene_draw_buffers.at(frame_index),
+        0,
+        vk::ArrayProxy<const SceneDraw>(this->lods.size(), draws.data())
+    );
+
+    vk::MemoryBarrier2 clear_barrier(
+        vk::PipelineStageFlagBits2::eTransfer,
+        vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+    );
+    cb.pipelineBarrier2(vk::DependencyInfo({}, clear_barrier));
+
+    SceneCullConstants constants = {};
+    constants.instance_count = this->instance_count;
+    constants.lod_count = this->lods.size();
+    constants.instance_buffer = this->instance_buffer_id;
+    constants.visible_buffer = this->visible_buffer_ids.at(frame_index);
+    constants.draw_buffer = this->scene_draw_buffer_ids.at(frame_index);
+
+    cb.bindPipeline(
+        vk::PipelineBindPoint::eCompute,
+        this->scene_cull_pipeline
+    );
+    cb.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute,
+        this->cull_pipeline_layout,
+        0,
+        { *this->bindless_heap.get_set(), *this->descriptor_set },
+        { this->scene_cull_offset }
+    );
+    cb.pushConstants<SceneCullConstants>(
+        this->cull_pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        constants
+    );
+    cb.dispatch((this->instance_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    vk::MemoryBarrier2 cull_barrier(
+        vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eShaderStorageWrite,
+        vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader,
+        vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead
+    );
+    cb.pipelineBarrier2(vk::DependencyInfo({}, cull_barrier));
 
+    this->gpu_profiler.end_pass(cb, pass);
+}
+
+void Engine::record_draws(
+        const vk::raii::CommandBuffer &cb,
+        uint32_t frame_index,
+        size_t first_draw,
+        size_t last_draw
+    )
+{
     // bind pipeline
     cb.bindPipeline(
         vk::PipelineBindPoint::eGraphics,
@@ -885,9 +1964,9 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         { 0 }
     );
 
-    // bind index buffer
+    // bind index buffer, with culling the one compacted for this frame
     cb.bindIndexBuffer(
-        this->index_buffer,
+        this->gpu_culling ? this->cull_index_buffers.at(frame_index) : this->index_buffer,
         0,
         vk::IndexType::eUint32
     );
@@ -897,8 +1976,8 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         vk::PipelineBindPoint::eGraphics,
         this->pipeline_layout,
         0,
-        *this->descriptor_sets.at(frame_index),
-        {}
+        { *this->bindless_heap.get_set(), *this->descriptor_set },
+        { this->uniform_offset }
     );
 
     // set dynamic states
@@ -919,55 +1998,95 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
     );
 
     // draw
-    cb.drawIndexed(
-        this->indices.size(),
-        1,
-        0,
-        0,
-        0
-    );
+    if (this->instance_count > 0) {
+        // every visible instance of a LOD in one draw, instance_cull_main wrote their ids and count
+        const vk::raii::Buffer &buffer = this->scene_draw_buffers.at(frame_index);
+        for (uint32_t lod = 0; lod < this->lods.size(); lod++) {
+            DrawConstants constants = {
+                this->material_buffer_id,
+                this->draws.at(first_draw).material,
+                this->instance_buffer_id,
+                this->visible_buffer_ids.at(frame_index),
+                lod * this->instance_count,
+            };
+            cb.pushConstants<DrawConstants>(
+                this->pipeline_layout,
+                vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                0,
+                constants
+            );
+
+            // instanceCount stays 0 for a LOD without visible instances, the draw is then a no-op
+            cb.drawIndexedIndirect(
+                buffer,
+                lod * sizeof(SceneDraw) + offsetof(SceneDraw, draw),
+                1,
+                sizeof(vk::DrawIndexedIndirectCommand)
+            );
+        }
+        return;
+    }
 
-    // end rendering
-    cb.endRendering();
+    if (this->gpu_culling) {
+        // the mesh has a single material, the draw covers whatever cull_main let through
+        DrawConstants constants = {
+            this->material_buffer_id,
+            this->draws.at(first_draw).material,
+            NO_INSTANCES,
+            0,
+            0,
+        };
+        cb.pushConstants<DrawConstants>(
+            this->pipeline_layout,
+            vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+            0,
+            constants
+        );
+        cb.drawIndexedIndirect(
+            this->cull_indirect_buffers.at(frame_index),
+            0,
+            1,
+            sizeof(vk::DrawIndexedIndirectCommand)
+        );
+        return;
+    }
 
-    // transition the swapchain image to PRESENT_SRC
-    transition_image_layout(
-        cb,
-        this->swapchain_images.at(image_index),
-        1,
-        vk::ImageAspectFlagBits::eColor,
-        vk::ImageLayout::eColorAttachmentOptimal,
-        vk::ImageLayout::ePresentSrcKHR,
-        vk::AccessFlagBits2::eColorAttachmentWrite,
-        {},
-        vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-        vk::PipelineStageFlagBits2::eBottomOfPipe
-    );
+    for (size_t i = first_draw; i < last_draw; i++) {
+        // materials are only indices, switching one is a push constant instead of a descriptor bind
+        if (i == first_draw || this->draws.at(i).material != this->draws.at(i - 1).material) {
+            DrawConstants constants = { this->material_buffer_id, this->draws.at(i).material, NO_INSTANCES, 0, 0 };
+            cb.pushConstants<DrawConstants>(
+                this->pipeline_layout,
+                vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                0,
+                constants
+            );
+        }
 
-    // end command buffer
-    cb.end();
+        cb.drawIndexed(
+            this->draws.at(i).index_count,
+            1,
+            this->draws.at(i).first_index,
+            0,
+            0
+        );
+    }
 }
 
 void Engine::create_descriptor_pool(void)
 {
     vk::DescriptorPoolSize uniform_pool_size(
-        vk::DescriptorType::eUniformBuffer,
-        CONFIG_VK_MAX_FRAMES_IN_FLIGHT
-    );
-
-    vk::DescriptorPoolSize sampler_pool_size(
-        vk::DescriptorType::eCombinedImageSampler,
-        CONFIG_VK_MAX_FRAMES_IN_FLIGHT
+        vk::DescriptorType::eUniformBufferDynamic,
+        1
     );
 
     std::vector<vk::DescriptorPoolSize> pool_size = {
         uniform_pool_size,
-        sampler_pool_size,
     };
 
     vk::DescriptorPoolCreateInfo pool_info(
         vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-        CONFIG_VK_MAX_FRAMES_IN_FLIGHT,
+        1,
         pool_size
     );
 
@@ -976,56 +2095,30 @@ void Engine::create_descriptor_pool(void)
 
 void Engine::create_descriptor_sets(void)
 {
-    std::vector<vk::DescriptorSetLayout> layouts(
-        CONFIG_VK_MAX_FRAMES_IN_FLIGHT,
-        *this->descriptor_layout
-    );
-
     vk::DescriptorSetAllocateInfo set_info(
         this->descriptor_pool,
-        layouts
+        *this->descriptor_layout
     );
 
-    this->descriptor_sets = this->device.allocateDescriptorSets(set_info);
-
-    for (int i = 0; i < CONFIG_VK_MAX_FRAMES_IN_FLIGHT; i++) {
-        vk::DescriptorBufferInfo buffer_info(
-            this->uniform_buffers.at(i),
-            0,
-            sizeof(UniformBufferObject)
-        );
-
-        vk::WriteDescriptorSet buffer_write(
-            this->descriptor_sets.at(i),
-            0,
-            0,
-            vk::DescriptorType::eUniformBuffer,
-            {},
-            buffer_info
-        );
-
-        vk::DescriptorImageInfo image_info(
-            this->texture_sampler,
-            this->texture_image_view,
-            vk::ImageLayout::eShaderReadOnlyOptimal
-        );
+    // a single set for all frames, the frame's data is picked by the dynamic offset when binding
+    this->descriptor_set = std::move(this->device.allocateDescriptorSets(set_info).front());
 
-        vk::WriteDescriptorSet image_write(
-            this->descriptor_sets.at(i),
-            1,
-            0,
-            vk::DescriptorType::eCombinedImageSampler,
-            image_info,
-            {}
-        );
+    vk::DescriptorBufferInfo buffer_info(
+        this->uniform_ring.get_buffer(),
+        0,
+        sizeof(UniformBufferObject)
+    );
 
-        std::vector<vk::WriteDescriptorSet> descriptor_writes = {
-            buffer_write,
-            image_write
-        };
+    vk::WriteDescriptorSet buffer_write(
+        this->descriptor_set,
+        0,
+        0,
+        vk::DescriptorType::eUniformBufferDynamic,
+        {},
+        buffer_info
+    );
 
-        this->device.updateDescriptorSets(descriptor_writes, {});
-    }
+    this->device.updateDescriptorSets(buffer_write, {});
 }
 
 void Engine::create_sync_objects(void)
@@ -1057,9 +2150,27 @@ void Engine::create_swapchain_sync_objects(void)
 
 void Engine::recreate_swapchain(void)
 {
-    this->device.waitIdle();
+    int width  = 0;
+    int height = 0;
 
-    cleanup_swapchain();
+    // minimized window has no area to present to, keep the outdated swapchain until it is restored
+    glfwGetFramebufferSize(this->window, &width, &height);
+    if (width == 0 || height == 0) {
+        return;
+    }
+    this->swapchain_outdated = false;
+
+    // no device wait - draw_frame waits for its fence right after submit, so only presentation
+    // can still use the old images and semaphores. Color and depth images are free to go
+    this->retired_swapchains.push_back({
+        std::move(this->swapchain),
+        std::move(this->swapchain_image_views),
+        std::move(this->render_finished),
+        this->frame_count + this->swapchain_images.size() + CONFIG_VK_MAX_FRAMES_IN_FLIGHT
+    });
+    this->swapchain = nullptr;
+    this->swapchain_image_views.clear();
+    this->render_finished.clear();
 
     create_swapchain();
     create_image_views();
@@ -1068,23 +2179,121 @@ void Engine::recreate_swapchain(void)
     create_swapchain_sync_objects();
 }
 
+void Engine::release_retired_swapchains(void)
+{
+    // without VK_EXT_swapchain_maintenance1 there is no fence for presentation, but every image
+    // of the old swapchain is released once that many frames were presented after it
+    while (not this->retired_swapchains.empty() &&
+           this->retired_swapchains.front().release_frame <= this->frame_count) {
+        this->retired_swapchains.pop_front();
+    }
+}
+
 void Engine::cleanup_swapchain(void)
 {
+    this->retired_swapchains.clear();
     this->swapchain_image_views.clear();
     this->swapchain = nullptr;
 }
 
+void Engine::framebuffer_size_callback(GLFWwindow *window, int, int)
+{
+    auto *engine = static_cast<Engine *>(glfwGetWindowUserPointer(window));
+    if (engine == nullptr) {
+        return;
+    }
+
+    // not every platform reports resize through vkQueuePresentKHR results
+    engine->swapchain_outdated = true;
+}
+
+void Engine::refresh_callback(GLFWwindow *window)
+{
+    auto *engine = static_cast<Engine *>(glfwGetWindowUserPointer(window));
+    if (engine == nullptr) {
+        return;
+    }
+
+    // some platforms block in glfwPollEvents for the whole resize drag - draw from inside it
+    engine->draw_frame(engine->current_frame);
+    engine->current_frame = (engine->current_frame + 1) % CONFIG_VK_MAX_FRAMES_IN_FLIGHT;
+}
+
 void Engine::main_loop(void)
 {
-    uint32_t current_frame = 0;
+    {
+        auto scope = this->startup_profiler.scope("first_frame");
+        glfwPollEvents();
+        draw_frame(this->current_frame);
+        this->current_frame = (this->current_frame + 1) % CONFIG_VK_MAX_FRAMES_IN_FLIGHT;
+    }
+    report_startup();
 
     while (not glfwWindowShouldClose(this->window)) {
-        glfwPollEvents();
-        draw_frame(current_frame);
-        current_frame = (current_frame + 1) % CONFIG_VK_MAX_FRAMES_IN_FLIGHT;
+        // nothing to render while minimized - sleep until the window comes back
+        if (this->swapchain_outdated && glfwGetWindowAttrib(this->window, GLFW_ICONIFIED)) {
+            glfwWaitEvents();
+        } else {
+            glfwPollEvents();
+        }
+
+        uint64_t presented = this->frame_count;
+        draw_frame(this->current_frame);
+        this->current_frame = (this->current_frame + 1) % CONFIG_VK_MAX_FRAMES_IN_FLIGHT;
+
+        // periodic work is per presented frame, not per attempt
+        if (this->frame_count == presented) {
+            continue;
+        }
+        if (CONFIG_GPU_PROFILER_REPORT_FRAMES && this->frame_count % CONFIG_GPU_PROFILER_REPORT_FRAMES == 0) {
+            this->gpu_profiler.print(std::cout);
+        }
+        if (CONFIG_MEMORY_BUDGET_POLL_FRAMES && this->frame_count % CONFIG_MEMORY_BUDGET_POLL_FRAMES == 0) {
+            this->memory_tracker.update_budget(this->physical_device);
+        }
+        if (CONFIG_MEMORY_REPORT_FRAMES && this->frame_count % CONFIG_MEMORY_REPORT_FRAMES == 0) {
+            this->memory_tracker.print(std::cout);
+        }
+        if (CONFIG_TRACE_CALIBRATION_FRAMES && this->tracer.enabled() && this->calibrated_timestamps &&
+            this->frame_count % CONFIG_TRACE_CALIBRATION_FRAMES == 0) {
+            this->gpu_profiler.calibrate(this->device, this->queue, this->command_pool, true);
+        }
     }
 
     this->device.waitIdle();
+    this->gpu_profiler.collect();
+    this->gpu_profiler.print(std::cout);
+    this->memory_tracker.update_budget(this->physical_device);
+    this->memory_tracker.print(std::cout);
+}
+
+void Engine::report_startup(void)
+{
+    if (not CONFIG_STARTUP_PROFILE) {
+        return;
+    }
+
+    this->startup_profiler.print(std::cout);
+    std::cout << "time to first frame: " << this->startup_profiler.total_ms() << " ms\n";
+
+    // the profile is on for every launch, a read-only working directory must not stop the engine
+    if (CONFIG_STARTUP_PROFILE_JSON[0] != '\0') {
+        try {
+            this->startup_profiler.write_json(CONFIG_STARTUP_PROFILE_JSON);
+        } catch (const std::exception &e) {
+            std::cerr << "failed to save startup profile: " << e.what() << '\n';
+        }
+    }
+
+    size_t regressions = this->startup_profiler.check_regressions(
+        CONFIG_STARTUP_BASELINE_PATH,
+        CONFIG_STARTUP_REGRESSION_PCT,
+        CONFIG_STARTUP_REGRESSION_MIN_MS,
+        std::cerr
+    );
+    if (regressions != 0 && CONFIG_STARTUP_FAIL_ON_REGRESSION) {
+        throw std::runtime_error(std::to_string(regressions) + " startup phases regressed");
+    }
 }
 
 void Engine::update_uniform_buffer(int frame_idx)
@@ -1094,6 +2303,14 @@ void Engine::update_uniform_buffer(int frame_idx)
     auto now = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float>(now - start).count();
 
+    // benchmark camera path depends only on the frame number, every run renders the same images
+    if (this->bench_options) {
+        time = this->bench_frame_idx / 60.0f;
+    }
+
+    // a scene spins around the origin like the single model, seen from further away
+    float distance = this->instance_count > 0 ? CONFIG_SCENE_VIEW_SCALE : 1.0f;
+
     UniformBufferObject ubo;
     ubo.model = glm::rotate(
         glm::mat4(1.0f),
@@ -1101,48 +2318,112 @@ void Engine::update_uniform_buffer(int frame_idx)
         glm::vec3(0.0f, 0.0f, 1.0f)
     );
     ubo.view = glm::lookAt(
-        glm::vec3(2.0f, 2.0f, 2.0f),
+        glm::vec3(2.0f, 2.0f, 2.0f) * distance,
         glm::vec3(0.0f, 0.0f, 0.0f),
         glm::vec3(0.0f, 0.0f, 1.0f)
     );
     ubo.proj = glm::perspective(
         glm::radians(45.0f),
         static_cast<float>(this->swapchain_extent.width) / this->swapchain_extent.height,
-        0.1f,
-        10.0f
+        0.1f * distance,
+        10.0f * distance
     );
     ubo.proj[1][1] *= -1;
-
-    memcpy(this->uniform_buffers_map.at(frame_idx), &ubo, sizeof(UniformBufferObject));
+    ubo.position_offset = this->position_offset;
+    ubo.position_scale = this->position_scale;
+
+    // the culling passes work in model space, where the meshlet bounds and instances are
+    this->frustum_planes = get_frustum_planes(ubo.proj * ubo.view * ubo.model);
+    this->camera_position = glm::inverse(ubo.view * ubo.model)[3];
+
+    // the frame fence was waited on, nothing reads this frame's slot anymore
+    this->uniform_ring.begin_frame(frame_idx);
+    this->uniform_offset = this->uniform_ring.push(ubo);
+
+    // a LOD is good enough once its error projects to CONFIG_LOD_ERROR_PIXELS at most, error / distance
+    // times this is how many times that it projects to
+    float lod_scale = std::abs(ubo.proj[1][1]) * this->swapchain_extent.height * 0.5f / CONFIG_LOD_ERROR_PIXELS;
+
+    if (this->instance_count > 0) {
+        // instance_cull_main picks the LOD of every instance
+        SceneCullUniforms cull = {};
+        std::ranges::copy(this->frustum_planes, cull.planes);
+        cull.sphere = this->model_sphere;
+        cull.camera = glm::vec4(glm::vec3(this->camera_position), lod_scale);
+        for (size_t i = 0; i < this->lods.size(); i++) {
+            cull.lod_errors[i / 4][i % 4] = this->lods[i].mesh.error;
+        }
+        this->scene_cull_offset = this->uniform_ring.push(cull);
+    } else {
+        // errors grow with every LOD, the last one within the threshold is the coarsest that is
+        float camera_distance = glm::length(glm::vec3(this->camera_position) - glm::vec3(this->model_sphere));
+        camera_distance = std::max(camera_distance - this->model_sphere.w, 0.0f);
+
+        this->lod = 0;
+        for (uint32_t i = 1; i < this->lods.size(); i++) {
+            if (this->lods[i].mesh.error * lod_scale <= camera_distance) {
+                this->lod = i;
+            }
+        }
+    }
 }
 
 void Engine::draw_frame(int frame_idx)
 {
+    auto       frame_zone = this->tracer.zone("draw_frame");
+    vk::Result result;
+    uint32_t   image_index;
+
+    release_retired_swapchains();
+    if (this->swapchain_outdated) {
+        recreate_swapchain();
+        if (this->swapchain_outdated) {
+            return;
+        }
+    }
+
     update_uniform_buffer(frame_idx);
 
-    auto [result, image_index] = this->swapchain.acquireNextImage(
-        UINT64_MAX,
-        present_complete.at(frame_idx),
-        nullptr
-    );
+    try {
+        auto zone = this->tracer.zone("acquire");
+        std::tie(result, image_index) = this->swapchain.acquireNextImage(
+            UINT64_MAX,
+            present_complete.at(frame_idx),
+            nullptr
+        );
+    } catch (const vk::OutOfDateKHRError &) {
+        // nothing waits on the semaphore, it stays unsignaled and the frame is skipped
+        this->swapchain_outdated = true;
+        return;
+    }
+    if (result == vk::Result::eSuboptimalKHR) {
+        // image is still presentable - render this frame, recreate before the next one
+        this->swapchain_outdated = true;
+    }
     record_command_buffer(image_index, frame_idx);
 
-    vk::PipelineStageFlags stage_flags(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-    vk::SubmitInfo submit_info(
-        *present_complete.at(frame_idx),
-        stage_flags,
-        *this->command_buffers.at(frame_idx),
-        *render_finished.at(image_index)
-    );
-    this->queue.submit(submit_info, *frame_finished.at(frame_idx));
+    {
+        auto zone = this->tracer.zone("submit");
+        vk::PipelineStageFlags stage_flags(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+        vk::SubmitInfo submit_info(
+            *present_complete.at(frame_idx),
+            stage_flags,
+            *this->command_buffers.at(frame_idx),
+            *render_finished.at(image_index)
+        );
+        this->queue.submit(submit_info, *frame_finished.at(frame_idx));
+    }
 
-    while (this->device.waitForFences({ frame_finished.at(frame_idx) },
-                                      true,
-                                      UINT64_MAX) ==
-           vk::Result::eTimeout) {
-        /* do nothing */
+    {
+        auto zone = this->tracer.zone("fence_wait");
+        while (this->device.waitForFences({ frame_finished.at(frame_idx) },
+                                          true,
+                                          UINT64_MAX) ==
+               vk::Result::eTimeout) {
+            /* do nothing */
+        }
+        this->device.resetFences({ frame_finished.at(frame_idx) });
     }
-    this->device.resetFences({ frame_finished.at(frame_idx) });
 
     vk::PresentInfoKHR present_info(
         *render_finished.at(image_index),
@@ -1150,24 +2431,36 @@ void Engine::draw_frame(int frame_idx)
         image_index
     );
 
-    result = this->queue.presentKHR(present_info);
-    if (CONFIG_DEBUG_VERBOSE) {
-        switch (result) {
-        case vk::Result::eSuccess:
-            break;
-        case vk::Result::eSuboptimalKHR:
-            std::cout << "vk::Queue::PresentKHR: eSuboptimalKHR\n";
-            recreate_swapchain();
-            break;
-        default:
-            std::cout << "vk::Queue::PresentKHR returned unexpected result: " << result << '\n';
-            break;
+    try {
+        auto zone = this->tracer.zone("present");
+        result = this->queue.presentKHR(present_info);
+        // retired swapchains are released by this count, only presents that were queued advance it
+        this->frame_count++;
+    } catch (const vk::OutOfDateKHRError &) {
+        result = vk::Result::eErrorOutOfDateKHR;
+    }
+    if (result != vk::Result::eSuccess) {
+        if (CONFIG_DEBUG_VERBOSE) {
+            std::cout << "vk::Queue::PresentKHR: " << vk::to_string(result) << '\n';
         }
+        this->swapchain_outdated = true;
+    }
+}
+
+void Engine::save_pipeline_cache(void)
+{
+    // losing the cache only costs startup time on next launch - do not fail shutdown because of it
+    try {
+        write_file_atomic(CONFIG_PIPELINE_CACHE_PATH, this->pipeline_cache.getData());
+    } catch (const std::exception &e) {
+        std::cerr << "failed to save pipeline cache: " << e.what() << '\n';
     }
 }
 
 void Engine::cleanup(void)
 {
+    this->tracer.close();
+    save_pipeline_cache();
     cleanup_swapchain();
 
     glfwDestroyWindow(this->window);
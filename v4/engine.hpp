@@ -1,6 +1,17 @@
 #ifndef ENGINE_HPP
 #define ENGINE_HPP
 
+#include "bindless_heap.hpp"
+#include "debug_logger.hpp"
+#include "gpu_profiler.hpp"
+#include "job_system.hpp"
+#include "ktx2_file.hpp"
+#include "memory_tracker.hpp"
+#include "mesh_cache.hpp"
+#include "meshlet_builder.hpp"
+#include "startup_profiler.hpp"
+#include "tracer.hpp"
+#include "uniform_ring.hpp"
 #include "vertex.hpp"
 
 #include "vulkan/vulkan.hpp"
@@ -9,18 +20,84 @@
 
 #include <GLFW/glfw3.h>
 
+#include <array>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
+// contiguous range of the index buffer drawn with one vkCmdDrawIndexed
+struct DrawCommand {
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t material;
+};
+
+// level of detail of the model as drawn, the single model picks one in update_uniform_buffer and
+// every instance of a scene its own in instance_cull_main
+struct ModelLod {
+    MeshLod  mesh;
+    // registered on its own, cull_main sees the meshlets of the LOD as a whole buffer
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+    uint32_t meshlet_buffer_id;
+    size_t   first_draw;
+    size_t   draw_count;
+};
+
+// swapchain replaced by recreate_swapchain(), presentation may still use its images and semaphores
+struct RetiredSwapchain {
+    vk::raii::SwapchainKHR           swapchain;
+    std::vector<vk::raii::ImageView> image_views;
+    std::vector<vk::raii::Semaphore> render_finished;
+    uint64_t                         release_frame;
+};
+
+// fixed-size run without user input, see bench.cpp
+struct BenchOptions {
+    uint32_t width;
+    uint32_t height;
+    // GLFW null platform, the surface comes from VK_EXT_headless_surface
+    bool     headless;
+    // scene of this many instances of the model (generate_scene), 0 draws the model once
+    uint32_t instances;
+};
+
+struct BenchFrame {
+    double cpu_ms;
+    // negative when the frame has no GPU timing
+    double gpu_ms;
+};
+
 class Engine {
+    // measures the host-side util functions, see microbench.cpp
+    friend struct MicroBench;
+
 public:
     void run(void);
 
+    // benchmark driving - init returns time to the first frame, frames follow a scripted path
+    double bench_init(const BenchOptions &options);
+    BenchFrame bench_frame(uint32_t frame);
+    void bench_cleanup(void);
+
+    // first memory type of type_filter with all of properties, shared with the modules that allocate
+    // their own memory (UniformRing) so the policy stays in one place
+    [[nodiscard]]
+    static uint32_t find_memory_type(
+        const vk::raii::PhysicalDevice &pd,
+        uint32_t type_filter,
+        vk::MemoryPropertyFlags properties
+    );
+
 private:
     // run functions
     void init_window(void);
     void init_vulkan(void);
         // init_vulkan functions
+        void start_asset_jobs(void);
         void create_instance(void);
 
         void setup_debug_messanger(void);
@@ -34,37 +111,64 @@ private:
         void create_image_views(void);
 
         void create_descriptor_set_layout(void);
+        void create_bindless_heap(void);
         void create_descriptor_pool(void);
         void create_descriptor_sets(void);
+        void create_pipeline_cache(void);
         void create_graphics_pipeline(void);
+        void create_cull_pipeline(void);
 
         void create_color_resources(void);
         void create_depth_resources(void);
+        void decode_texture(void);
+        void decode_png(void);
         void create_texture_image(void);
+        void create_baked_texture_image(void);
+        void create_cpu_mipped_texture_image(void);
+        void upload_texture_levels(const std::vector<std::span<const uint8_t>> &levels);
         void create_texture_image_view(void);
         void create_texture_sampler(void);
 
         void load_model(void);
         void create_vertex_buffer(void);
         void create_index_buffer(void);
+        void create_cull_buffers(void);
+        void create_scene_buffers(void);
         void create_uniform_buffers(void);
+        void create_material_buffer(void);
 
         void create_command_pool(void);
+        void create_gpu_profiler(void);
         void create_command_buffers(void);
+        void create_secondary_command_buffers(void);
         void record_command_buffer(uint32_t image_index, uint32_t frame_index);
+        void record_secondary_command_buffers(uint32_t frame_index, size_t slices);
+        void record_cull_pass(const vk::raii::CommandBuffer &cb, uint32_t frame_index);
+        void record_scene_cull_pass(const vk::raii::CommandBuffer &cb, uint32_t frame_index);
+        void record_draws(
+            const vk::raii::CommandBuffer &cb,
+            uint32_t frame_index,
+            size_t first_draw,
+            size_t last_draw
+        );
 
         void create_sync_objects(void);
         void create_swapchain_sync_objects(void);
 
     // window resize functions
     void recreate_swapchain(void);
+    void release_retired_swapchains(void);
     void cleanup_swapchain(void);
+    static void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+    static void refresh_callback(GLFWwindow *window);
 
     // main loop functions
     void main_loop(void);
+        void report_startup(void);
         void update_uniform_buffer(int frame_idx);
         void draw_frame(int frame_idx);
 
+    void save_pipeline_cache(void);
     void cleanup(void);
 
     // util functions
@@ -102,14 +206,15 @@ private:
     );
 
     [[nodiscard]]
-    std::pair<vk::raii::Image, vk::raii::DeviceMemory> create_image(
+    std::pair<vk::raii::Image, TrackedMemory> create_image(
         uint32_t width,
         uint32_t height,
         vk::Format format,
         uint32_t mip_levels,
         vk::SampleCountFlagBits num_samples,
         vk::ImageUsageFlags usage,
-        vk::MemoryPropertyFlags properties
+        vk::MemoryPropertyFlags properties,
+        MemoryCategory category
     );
 
     [[nodiscard]]
@@ -121,18 +226,16 @@ private:
     );
 
     [[nodiscard]]
-    std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> create_buffer(
+    std::pair<vk::raii::Buffer, TrackedMemory> create_buffer(
         vk::DeviceSize size,
         vk::BufferUsageFlags usage,
-        vk::MemoryPropertyFlags properties
+        vk::MemoryPropertyFlags properties,
+        MemoryCategory category
     );
 
+    // normalized planes of the clip volume of clip, inside is dot(plane.xyz, pos) + plane.w >= 0
     [[nodiscard]]
-    static uint32_t find_memory_type(
-        const vk::raii::PhysicalDevice &pd,
-        uint32_t typeFileter,
-        vk::MemoryPropertyFlags properties
-    );
+    static std::array<glm::vec4, 6> get_frustum_planes(const glm::mat4 &clip);
 
     static void generate_mipmaps(
         const vk::raii::CommandBuffer &cb,
@@ -192,6 +295,21 @@ private:
     [[nodiscard]]
     static std::vector<const char *> get_required_device_extensions();
 
+    [[nodiscard]]
+    static bool supports_calibrated_timestamps(const vk::raii::PhysicalDevice &pd);
+
+    [[nodiscard]]
+    static bool supports_memory_budget(const vk::raii::PhysicalDevice &pd);
+
+    [[nodiscard]]
+    static bool supports_packed_vertices(const vk::raii::PhysicalDevice &pd);
+
+    [[nodiscard]]
+    static bool supports_texture_format(const vk::raii::PhysicalDevice &pd, vk::Format format);
+
+    [[nodiscard]]
+    static bool supports_blit_mipmaps(const vk::raii::PhysicalDevice &pd, vk::Format format);
+
     [[nodiscard]]
     static std::vector<const char *> get_required_instance_extensions();
 
@@ -200,7 +318,21 @@ private:
         vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
         vk::DebugUtilsMessageTypeFlagsEXT type,
         const vk::DebugUtilsMessengerCallbackDataEXT *callback_data,
-        void *
+        void *user_data
+    );
+
+    [[nodiscard]]
+    static bool is_pipeline_cache_compatible(
+        const std::vector<char> &data,
+        const vk::PhysicalDeviceProperties &props
+    );
+
+    // parses an OBJ on the job system and merges vertices shared between faces
+    static void load_obj(
+        const std::string &fname,
+        JobSystem &jobs,
+        std::vector<Vertex> &vertices,
+        std::vector<uint32_t> &indices
     );
 
     [[nodiscard]]
@@ -209,6 +341,9 @@ private:
 private:
     GLFWwindow                       *window         = nullptr;
 
+    // declared before the instance so it outlives the debug messenger
+    DebugLogger                      debug_logger;
+
     vk::raii::Context                context;
     vk::raii::Instance               instance        = nullptr;
     vk::raii::DebugUtilsMessengerEXT debug_messenger = nullptr;
@@ -219,6 +354,14 @@ private:
 
     vk::SampleCountFlagBits          msaa_samples    = vk::SampleCountFlagBits::e1;
 
+    bool                             calibrated_timestamps = false;
+    bool                             inherited_queries     = false;
+    // vertex buffer holds PackedVertex instead of Vertex, see CONFIG_VERTEX_QUANTIZE
+    bool                             packed_vertices       = false;
+
+    // declared before any TrackedMemory, which reports to it when freed
+    MemoryTracker                    memory_tracker;
+
     uint32_t                         queue_index     = -1;
     vk::raii::Queue                  queue           = nullptr;
 
@@ -228,48 +371,137 @@ private:
 
     std::vector<vk::Image>           swapchain_images;
     std::vector<vk::raii::ImageView> swapchain_image_views;
+    std::deque<RetiredSwapchain>     retired_swapchains;
+    bool                             swapchain_outdated = false;
 
+    BindlessHeap                     bindless_heap;
+
+    // materials are an array of Material in a storage buffer of the bindless heap
+    vk::raii::Buffer                 material_buffer     = nullptr;
+    TrackedMemory                    material_buffer_mem = nullptr;
+    uint32_t                         material_buffer_id  = 0;
+
+    // uniform ring (set 1, dynamic offset), the bindless heap is set 0
     vk::raii::DescriptorSetLayout    descriptor_layout = nullptr;
     vk::raii::DescriptorPool         descriptor_pool   = nullptr;
-    std::vector<vk::raii::DescriptorSet> descriptor_sets;
+    vk::raii::DescriptorSet          descriptor_set    = nullptr;
 
+    vk::raii::PipelineCache          pipeline_cache    = nullptr;
     vk::raii::PipelineLayout         pipeline_layout   = nullptr;
     vk::raii::Pipeline               pipeline          = nullptr;
 
+    // the mesh is mapped from the cache, the vectors only hold it when it had to be parsed
+    MeshCache                        mesh_cache;
     std::vector<Vertex>              vertices;
     std::vector<uint32_t>            indices;
+    std::span<const Vertex>          vertex_data;
+    std::span<const uint32_t>        index_data;
+    MeshCache::Bounds                mesh_bounds;
+    std::vector<DrawCommand>         draws;
+    // CONFIG_LOD_COUNT levels at most, the draws and meshlets of each follow the ones before
+    std::vector<ModelLod>            lods;
+    uint32_t                         lod               = 0;
+    // bounding sphere of the model, what instances are culled by and LODs picked by
+    glm::vec4                        model_sphere      = glm::vec4(0.0f);
 
     vk::raii::Buffer                 vertex_buffer     = nullptr;
-    vk::raii::DeviceMemory           vertex_buffer_mem = nullptr;
+    TrackedMemory                    vertex_buffer_mem = nullptr;
+    // maps the positions in the vertex buffer to model space, identity unless packed_vertices
+    glm::vec4                        position_offset   = glm::vec4(0.0f);
+    glm::vec4                        position_scale    = glm::vec4(1.0f);
 
     vk::raii::Buffer                 index_buffer      = nullptr;
-    vk::raii::DeviceMemory           index_buffer_mem  = nullptr;
+    TrackedMemory                    index_buffer_mem  = nullptr;
+
+    // meshlets are culled by a compute pass that compacts their indices into this frame slot's index
+    // buffer and the count of one indirect draw, see CONFIG_GPU_CULLING and create_cull_buffers
+    bool                             gpu_culling       = false;
+    std::vector<Meshlet>             meshlets;
+    vk::raii::PipelineLayout         cull_pipeline_layout = nullptr;
+    vk::raii::Pipeline               cull_pipeline     = nullptr;
+    vk::raii::Buffer                 meshlet_buffer    = nullptr;
+    TrackedMemory                    meshlet_buffer_mem = nullptr;
+    uint32_t                         index_buffer_id   = 0;
+    std::vector<vk::raii::Buffer>    cull_index_buffers;
+    std::vector<TrackedMemory>       cull_index_buffers_mem;
+    std::vector<uint32_t>            cull_index_buffer_ids;
+    std::vector<vk::raii::Buffer>    cull_indirect_buffers;
+    std::vector<TrackedMemory>       cull_indirect_buffers_mem;
+    std::vector<uint32_t>            cull_indirect_buffer_ids;
+
+    // GPU-driven scene of instance_count copies of the model, replaces meshlet culling. Instances are
+    // culled by a compute pass that writes the ids of the visible ones and the instance count of one
+    // indirect draw per LOD, the CPU cost of a frame does not depend on how many there are
+    uint32_t                         instance_count    = 0;
+    vk::raii::Pipeline               scene_cull_pipeline = nullptr;
+    vk::raii::Buffer                 instance_buffer   = nullptr;
+    TrackedMemory                    instance_buffer_mem = nullptr;
+    uint32_t                         instance_buffer_id = 0;
+    std::vector<vk::raii::Buffer>    visible_buffers;
+    std::vector<TrackedMemory>       visible_buffers_mem;
+    std::vector<uint32_t>            visible_buffer_ids;
+    std::vector<vk::raii::Buffer>    scene_draw_buffers;
+    std::vector<TrackedMemory>       scene_draw_buffers_mem;
+    std::vector<uint32_t>            scene_draw_buffer_ids;
+
+    // model space, written by update_uniform_buffer
+    std::array<glm::vec4, 6>         frustum_planes;
+    glm::vec4                        camera_position   = glm::vec4(0.0f);
+
+    // filled by asset jobs, see start_asset_jobs()
+    JobSystem::Counter               model_loaded;
+    JobSystem::Counter               texture_decoded;
+    std::unique_ptr<uint8_t, void (*)(void *)> texture_pixels{ nullptr, nullptr };
+    int                              texture_width     = 0;
+    int                              texture_height    = 0;
+    // baked mip chain, mapped by decode_texture instead of decoding the PNG, see bake.cpp
+    Ktx2File                         texture_file;
+    vk::Format                       texture_format    = vk::Format::eR8G8B8A8Srgb;
 
     uint32_t                         mip_levels        = 0;
     vk::raii::Image                  texture_image     = nullptr;
-    vk::raii::DeviceMemory           texture_image_mem = nullptr;
+    TrackedMemory                    texture_image_mem = nullptr;
     vk::raii::ImageView              texture_image_view= nullptr;
     vk::raii::Sampler                texture_sampler   = nullptr;
 
     vk::raii::Image                  depth_image      = nullptr;
-    vk::raii::DeviceMemory           depth_image_mem  = nullptr;
+    TrackedMemory                    depth_image_mem  = nullptr;
     vk::raii::ImageView              depth_image_view = nullptr;
     vk::Format                       depth_format     = vk::Format::eUndefined;
 
     vk::raii::Image                  color_image       = nullptr;
-    vk::raii::DeviceMemory           color_image_mem   = nullptr;
+    TrackedMemory                    color_image_mem   = nullptr;
     vk::raii::ImageView              color_image_view  = nullptr;
 
-    std::vector<vk::raii::Buffer>       uniform_buffers;
-    std::vector<vk::raii::DeviceMemory> uniform_buffers_mem;
-    std::vector<void *>                 uniform_buffers_map;
+    UniformRing                      uniform_ring;
+    // offset of this frame's UniformBufferObject in uniform_ring
+    uint32_t                         uniform_offset    = 0;
+    // offset of this frame's SceneCullUniforms in uniform_ring
+    uint32_t                         scene_cull_offset = 0;
 
     vk::raii::CommandPool            command_pool    = nullptr;
     std::vector<vk::raii::CommandBuffer> command_buffers;
 
+    // one pool per recording slice and frame slot, indexed [frame][slice] - a pool is only
+    // touched by the thread recording its slice and reset as a whole once the frame is done
+    std::vector<std::vector<vk::raii::CommandPool>>   secondary_command_pools;
+    std::vector<std::vector<vk::raii::CommandBuffer>> secondary_command_buffers;
+
+    StartupProfiler                  startup_profiler;
+    GpuProfiler                      gpu_profiler;
+    Tracer                           tracer;
+    uint64_t                         frame_count     = 0;
+    uint32_t                         current_frame   = 0;
+
+    std::optional<BenchOptions>      bench_options;
+    uint32_t                         bench_frame_idx = 0;
+
     std::vector<vk::raii::Semaphore> present_complete;
     std::vector<vk::raii::Semaphore> render_finished;
     std::vector<vk::raii::Fence>     frame_finished;
+
+    // declared last - destruction joins the workers before anything a job may touch is gone
+    JobSystem                        jobs;
 };
 
 #endif /* ENGINE_HPP */
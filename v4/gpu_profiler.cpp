@@ -0,0 +1,343 @@
+
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+// order of the results matches order of the bits, see vkGetQueryPoolResults
+static constexpr vk::QueryPipelineStatisticFlags g_statistic_flags =
+    vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+    vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+    vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+    vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+    vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+
+void GpuProfiler::init(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        uint32_t queue_family_index,
+        uint32_t latency,
+        size_t history,
+        bool pipeline_statistics
+    )
+{
+    vk::PhysicalDeviceProperties props = pd.getProperties();
+    uint32_t valid_bits = pd.getQueueFamilyProperties().at(queue_family_index).timestampValidBits;
+
+    // timestamps are optional - profiler silently stays disabled without them
+    if (valid_bits == 0 || props.limits.timestampPeriod == 0 || latency == 0) {
+        return;
+    }
+
+    this->timestamp_period = props.limits.timestampPeriod;
+    this->timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+    this->history_size = std::max<size_t>(history, 1);
+    this->slots.assign(latency, Slot());
+    this->current_slot = latency - 1;
+
+    // one extra query at the end is used by calibrate()
+    vk::QueryPoolCreateInfo timestamp_info(
+        {},
+        vk::QueryType::eTimestamp,
+        latency * MAX_PASSES_PER_FRAME * 2 + 1
+    );
+    this->timestamp_pool = vk::raii::QueryPool(dev, timestamp_info);
+
+    if (pipeline_statistics) {
+        vk::QueryPoolCreateInfo statistics_info(
+            {},
+            vk::QueryType::ePipelineStatistics,
+            latency * MAX_PASSES_PER_FRAME,
+            g_statistic_flags
+        );
+        this->statistics_pool = vk::raii::QueryPool(dev, statistics_info);
+    }
+}
+
+bool GpuProfiler::enabled(void) const
+{
+    return static_cast<bool>(*this->timestamp_pool);
+}
+
+void GpuProfiler::set_tracer(Tracer *tracer)
+{
+    this->tracer = tracer;
+}
+
+void GpuProfiler::calibrate(
+        const vk::raii::Device &dev,
+        const vk::raii::Queue &queue,
+        const vk::raii::CommandPool &command_pool,
+        bool calibrated_timestamps
+    )
+{
+    if (not enabled()) {
+        return;
+    }
+
+    if (calibrated_timestamps) {
+        std::array<vk::CalibratedTimestampInfoKHR, 2> infos = {
+            vk::CalibratedTimestampInfoKHR(vk::TimeDomainKHR::eDevice),
+            vk::CalibratedTimestampInfoKHR(vk::TimeDomainKHR::eClockMonotonic),
+        };
+
+        auto [stamps, max_deviation] = dev.getCalibratedTimestampsKHR(infos);
+        (void)max_deviation;
+
+        this->calibration_gpu = stamps.at(0);
+        this->calibration_cpu = stamps.at(1);
+        this->calibrated = true;
+        return;
+    }
+
+    uint32_t query = this->slots.size() * MAX_PASSES_PER_FRAME * 2;
+
+    vk::CommandBufferAllocateInfo allocate_info(
+        command_pool,
+        vk::CommandBufferLevel::ePrimary,
+        1
+    );
+    vk::raii::CommandBuffers cbs(dev, allocate_info);
+    vk::raii::CommandBuffer &cb = cbs.front();
+
+    cb.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    cb.resetQueryPool(this->timestamp_pool, query, 1);
+    cb.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, this->timestamp_pool, query);
+    cb.end();
+
+    queue.submit(vk::SubmitInfo({}, {}, *cb));
+    queue.waitIdle();
+    int64_t cpu_ns = Tracer::now_ns();
+
+    auto [result, stamps] = this->timestamp_pool.getResults<uint64_t>(
+        query,
+        1,
+        sizeof(uint64_t),
+        sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait
+    );
+    if (result == vk::Result::eSuccess) {
+        this->calibration_gpu = stamps.at(0);
+        this->calibration_cpu = cpu_ns;
+        this->calibrated = true;
+    }
+}
+
+int64_t GpuProfiler::to_cpu_ns(uint64_t ticks) const
+{
+    // masked difference handles wrap around of timestamps narrower than 64 bits
+    uint64_t forward  = (ticks - this->calibration_gpu) & this->timestamp_mask;
+    uint64_t backward = (this->calibration_gpu - ticks) & this->timestamp_mask;
+
+    if (forward <= backward) {
+        return this->calibration_cpu + static_cast<int64_t>(forward * this->timestamp_period);
+    }
+    return this->calibration_cpu - static_cast<int64_t>(backward * this->timestamp_period);
+}
+
+void GpuProfiler::begin_frame(const vk::raii::CommandBuffer &cb)
+{
+    if (not enabled()) {
+        return;
+    }
+
+    this->current_slot = (this->current_slot + 1) % this->slots.size();
+
+    // slot was written `latency` frames ago, if it is still not finished the sample is dropped
+    Slot &slot = this->slots.at(this->current_slot);
+    if (slot.pending) {
+        collect_slot(this->current_slot);
+    }
+    slot.passes.clear();
+    slot.pending = false;
+
+    cb.resetQueryPool(
+        this->timestamp_pool,
+        this->current_slot * MAX_PASSES_PER_FRAME * 2,
+        MAX_PASSES_PER_FRAME * 2
+    );
+    if (*this->statistics_pool) {
+        cb.resetQueryPool(
+            this->statistics_pool,
+            this->current_slot * MAX_PASSES_PER_FRAME,
+            MAX_PASSES_PER_FRAME
+        );
+    }
+}
+
+uint32_t GpuProfiler::begin_pass(const vk::raii::CommandBuffer &cb, const char *name, bool statistics)
+{
+    if (not enabled()) {
+        return UINT32_MAX;
+    }
+
+    Slot &slot = this->slots.at(this->current_slot);
+    if (slot.passes.size() >= MAX_PASSES_PER_FRAME) {
+        return UINT32_MAX;
+    }
+
+    uint32_t pass  = slot.passes.size();
+    uint32_t query = this->current_slot * MAX_PASSES_PER_FRAME + pass;
+
+    statistics = statistics && *this->statistics_pool;
+    slot.passes.push_back({ name, statistics });
+    slot.pending = true;
+
+    cb.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, this->timestamp_pool, query * 2);
+    if (statistics) {
+        cb.beginQuery(this->statistics_pool, query, {});
+    }
+
+    return pass;
+}
+
+void GpuProfiler::end_pass(const vk::raii::CommandBuffer &cb, uint32_t pass)
+{
+    if (pass == UINT32_MAX) {
+        return;
+    }
+
+    uint32_t query = this->current_slot * MAX_PASSES_PER_FRAME + pass;
+
+    if (this->slots.at(this->current_slot).passes.at(pass).statistics) {
+        cb.endQuery(this->statistics_pool, query);
+    }
+    cb.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, this->timestamp_pool, query * 2 + 1);
+}
+
+vk::QueryPipelineStatisticFlags GpuProfiler::inherited_statistics(void) const
+{
+    return *this->statistics_pool ? g_statistic_flags : vk::QueryPipelineStatisticFlags();
+}
+
+double GpuProfiler::collect(void)
+{
+    double total = 0;
+
+    for (uint32_t i = 0; i < this->slots.size(); i++) {
+        if (this->slots.at(i).pending) {
+            total += collect_slot(i).value_or(0);
+        }
+    }
+
+    return total;
+}
+
+std::optional<double> GpuProfiler::collect_slot(uint32_t slot_idx)
+{
+    Slot     &slot  = this->slots.at(slot_idx);
+    uint32_t first  = slot_idx * MAX_PASSES_PER_FRAME;
+    uint32_t count  = slot.passes.size();
+    double   total  = 0;
+
+    // no eWait - not finished slot just reports eNotReady
+    auto [result, stamps] = this->timestamp_pool.getResults<uint64_t>(
+        first * 2,
+        count * 2,
+        count * 2 * sizeof(uint64_t),
+        sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64
+    );
+    if (result != vk::Result::eSuccess) {
+        return std::nullopt;
+    }
+    slot.pending = false;
+
+    for (uint32_t pass = 0; pass < count; pass++) {
+        History &hist = this->history[slot.passes.at(pass).name];
+        uint64_t ticks = (stamps.at(pass * 2 + 1) - stamps.at(pass * 2)) & this->timestamp_mask;
+        double   ms    = ticks * this->timestamp_period / 1e6;
+
+        if (hist.samples.size() < this->history_size) {
+            hist.samples.push_back(ms);
+        } else {
+            hist.samples.at(hist.next) = ms;
+        }
+        hist.next = (hist.next + 1) % this->history_size;
+        total += ms;
+
+        if (this->tracer != nullptr && this->tracer->enabled() && this->calibrated) {
+            this->tracer->add_gpu_event(
+                slot.passes.at(pass).name,
+                to_cpu_ns(stamps.at(pass * 2)),
+                to_cpu_ns(stamps.at(pass * 2 + 1))
+            );
+        }
+
+        if (not slot.passes.at(pass).statistics) {
+            continue;
+        }
+
+        auto [stat_result, stats] = this->statistics_pool.getResults<uint64_t>(
+            first + pass,
+            1,
+            STATISTICS_COUNT * sizeof(uint64_t),
+            STATISTICS_COUNT * sizeof(uint64_t),
+            vk::QueryResultFlagBits::e64
+        );
+        if (stat_result == vk::Result::eSuccess) {
+            for (uint32_t i = 0; i < STATISTICS_COUNT; i++) {
+                hist.stat_sums.at(i) += stats.at(i);
+            }
+            hist.stat_samples++;
+        }
+    }
+
+    return total;
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::get_stats(void) const
+{
+    std::vector<PassStats> result;
+
+    for (const auto &[name, hist] : this->history) {
+        std::vector<double> sorted = hist.samples;
+        PassStats           stats;
+
+        if (sorted.empty()) {
+            continue;
+        }
+        std::ranges::sort(sorted);
+
+        stats.name = name;
+        stats.samples = sorted.size();
+        stats.min_ms = sorted.front();
+        for (double ms : sorted) {
+            stats.avg_ms += ms;
+        }
+        stats.avg_ms /= sorted.size();
+        stats.p99_ms = sorted.at(std::ceil(sorted.size() * 0.99) - 1);
+
+        if (hist.stat_samples != 0) {
+            stats.vertices = hist.stat_sums.at(0) / hist.stat_samples;
+            stats.primitives = hist.stat_sums.at(1) / hist.stat_samples;
+            stats.vertex_invocations = hist.stat_sums.at(2) / hist.stat_samples;
+            stats.clipped_primitives = hist.stat_sums.at(3) / hist.stat_samples;
+            stats.fragment_invocations = hist.stat_sums.at(4) / hist.stat_samples;
+        }
+
+        result.push_back(stats);
+    }
+
+    return result;
+}
+
+void GpuProfiler::print(std::ostream &os) const
+{
+    os << "GPU passes (min / avg / p99 ms):\n" << std::fixed << std::setprecision(3);
+    for (const PassStats &stats : get_stats()) {
+        os << '\t' << std::setw(12) << std::left << stats.name << std::right
+           << std::setw(9) << stats.min_ms
+           << std::setw(9) << stats.avg_ms
+           << std::setw(9) << stats.p99_ms
+           << "  (" << stats.samples << " samples)";
+        if (stats.vertex_invocations != 0 || stats.fragment_invocations != 0) {
+            os << " vs " << stats.vertex_invocations
+               << " prims " << stats.clipped_primitives
+               << " fs " << stats.fragment_invocations;
+        }
+        os << '\n';
+    }
+    os << std::defaultfloat;
+}
@@ -0,0 +1,124 @@
+
+#ifndef GPU_PROFILER_HPP
+#define GPU_PROFILER_HPP
+
+#include "tracer.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+#include <array>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Wraps passes of recorded command buffers in timestamp (and optionally pipeline statistics) queries.
+// Every begin_frame() takes next slot of a small ring of query ranges, results of the slot are read back
+// without waiting only when the slot comes around again, so profiling never stalls CPU on the GPU.
+class GpuProfiler {
+public:
+    static constexpr uint32_t MAX_PASSES_PER_FRAME = 8;
+
+    struct PassStats {
+        std::string name;
+        size_t      samples              = 0;
+        double      min_ms               = 0;
+        double      avg_ms               = 0;
+        double      p99_ms               = 0;
+        // averages over samples that had statistics query, zeros when statistics are not supported
+        uint64_t    vertices             = 0;
+        uint64_t    primitives           = 0;
+        uint64_t    vertex_invocations   = 0;
+        uint64_t    clipped_primitives   = 0;
+        uint64_t    fragment_invocations = 0;
+    };
+
+    void init(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        uint32_t queue_family_index,
+        uint32_t latency,
+        size_t history,
+        bool pipeline_statistics
+    );
+
+    [[nodiscard]]
+    bool enabled(void) const;
+
+    // collected passes are also emitted to the tracer, once GPU clock is calibrated
+    void set_tracer(Tracer *tracer);
+
+    // maps GPU timestamps to steady_clock. With VK_KHR_calibrated_timestamps both clocks are sampled by
+    // the driver, otherwise a timestamp is written by an empty submit and paired with CPU time after
+    // waiting for it, which is late by the wake-up latency (usually tens of microseconds)
+    void calibrate(
+        const vk::raii::Device &dev,
+        const vk::raii::Queue &queue,
+        const vk::raii::CommandPool &command_pool,
+        bool calibrated_timestamps
+    );
+
+    // must be called right after command buffer begin, before any pass
+    void begin_frame(const vk::raii::CommandBuffer &cb);
+
+    [[nodiscard]]
+    uint32_t begin_pass(const vk::raii::CommandBuffer &cb, const char *name, bool statistics = false);
+    void end_pass(const vk::raii::CommandBuffer &cb, uint32_t pass);
+
+    // VkCommandBufferInheritanceInfo::pipelineStatistics for secondaries executed inside a statistics pass
+    [[nodiscard]]
+    vk::QueryPipelineStatisticFlags inherited_statistics(void) const;
+
+    // reads back every slot that GPU already finished, returns summary GPU time of all collected passes
+    double collect(void);
+
+    [[nodiscard]]
+    std::vector<PassStats> get_stats(void) const;
+
+    void print(std::ostream &os) const;
+
+private:
+    struct Pass {
+        const char *name;
+        bool        statistics;
+    };
+
+    struct Slot {
+        std::vector<Pass> passes;
+        bool              pending = false;
+    };
+
+    static constexpr uint32_t STATISTICS_COUNT = 5;
+
+    struct History {
+        std::vector<double>                      samples;
+        size_t                                   next         = 0;
+        uint64_t                                 stat_samples = 0;
+        std::array<uint64_t, STATISTICS_COUNT>   stat_sums    = {};
+    };
+
+    std::optional<double> collect_slot(uint32_t slot_idx);
+
+    [[nodiscard]]
+    int64_t to_cpu_ns(uint64_t ticks) const;
+
+    vk::raii::QueryPool            timestamp_pool  = nullptr;
+    vk::raii::QueryPool            statistics_pool = nullptr;
+    double                         timestamp_period = 0;
+    uint64_t                       timestamp_mask   = 0;
+    size_t                         history_size     = 0;
+
+    std::vector<Slot>              slots;
+    uint32_t                       current_slot     = 0;
+
+    Tracer                         *tracer          = nullptr;
+    bool                           calibrated       = false;
+    uint64_t                       calibration_gpu  = 0;
+    int64_t                        calibration_cpu  = 0;
+
+    std::map<std::string, History> history;
+};
+
+#endif /* GPU_PROFILER_HPP */
@@ -0,0 +1,29 @@
+
+#include "image_decoder.hpp"
+
+#include <stb_image.h>
+
+#include <stdexcept>
+
+std::vector<DecodedImage> decode_images(std::span<const std::string> fnames, JobSystem &jobs)
+{
+    std::vector<DecodedImage> images(fnames.size());
+
+    // stb_image keeps no state between calls but the failure reason, which is thread local
+    jobs.parallel_for(fnames.size(), [&](size_t i) {
+        int width;
+        int height;
+        int channels;
+
+        stbi_uc *pixels = stbi_load(fnames[i].c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr) {
+            throw std::runtime_error("failed to load image " + fnames[i] + ": " + stbi_failure_reason());
+        }
+
+        images[i].pixels = { pixels, stbi_image_free };
+        images[i].width  = width;
+        images[i].height = height;
+    });
+
+    return images;
+}
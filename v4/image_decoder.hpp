@@ -0,0 +1,25 @@
+
+#ifndef IMAGE_DECODER_HPP
+#define IMAGE_DECODER_HPP
+
+#include "job_system.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// RGBA8 texels as stb_image returns them
+struct DecodedImage {
+    std::unique_ptr<uint8_t, void (*)(void *)> pixels{ nullptr, nullptr };
+    uint32_t                                   width  = 0;
+    uint32_t                                   height = 0;
+};
+
+// Decodes every file with stb_image, each one as a job of its own, in the order of fnames. Throws if
+// any of them fails. Needs STB_IMAGE_IMPLEMENTATION in another translation unit of the program
+[[nodiscard]]
+std::vector<DecodedImage> decode_images(std::span<const std::string> fnames, JobSystem &jobs);
+
+#endif /* IMAGE_DECODER_HPP */
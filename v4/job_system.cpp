@@ -0,0 +1,206 @@
+
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// index of the current thread in the job system that owns it, other threads use deque 0
+static thread_local const JobSystem *g_owner      = nullptr;
+static thread_local size_t           g_thread_idx = 0;
+
+bool JobSystem::Counter::done(void) const
+{
+    return this->pending.load() == 0;
+}
+
+JobSystem::~JobSystem()
+{
+    stop();
+}
+
+void JobSystem::start(size_t threads)
+{
+    stop();
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        this->queues.push_back(std::make_unique<Queue>());
+    }
+
+    g_owner = this;
+    g_thread_idx = 0;
+
+    for (size_t i = 1; i < threads; i++) {
+        this->workers.emplace_back([this, i](std::stop_token token) { worker_loop(token, i); });
+    }
+}
+
+void JobSystem::stop(void)
+{
+    for (std::jthread &worker : this->workers) {
+        worker.request_stop();
+    }
+    {
+        std::lock_guard lock(this->sleep_mutex);
+    }
+    this->sleep_cv.notify_all();
+
+    this->workers.clear();
+    this->queues.clear();
+    this->queued = 0;
+}
+
+size_t JobSystem::thread_count(void) const
+{
+    return this->workers.size() + 1;
+}
+
+void JobSystem::run(Job job, Counter *signal)
+{
+    if (signal != nullptr) {
+        signal->pending++;
+    }
+
+    push({ std::move(job), signal });
+}
+
+void JobSystem::wait(Counter &counter)
+{
+    size_t thread_idx = g_owner == this ? g_thread_idx : 0;
+
+    while (not counter.done()) {
+        if (not try_run_one(thread_idx)) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard lock(counter.mutex);
+        std::swap(error, counter.error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::parallel_for(size_t count, const std::function<void(size_t)> &fn)
+{
+    Counter counter;
+
+    for (size_t i = 0; i < count; i++) {
+        run([&fn, i]() { fn(i); }, &counter);
+    }
+
+    wait(counter);
+}
+
+void JobSystem::push(Task task)
+{
+    // not started - behave like a serial executor
+    if (this->queues.empty()) {
+        execute(task);
+        return;
+    }
+
+    Queue &queue = *this->queues.at(g_owner == this ? g_thread_idx : 0);
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    this->queued++;
+
+    // empty critical section orders the increment before a worker that is about to sleep checks it
+    {
+        std::lock_guard lock(this->sleep_mutex);
+    }
+    this->sleep_cv.notify_one();
+}
+
+void JobSystem::execute(Task &task)
+{
+    std::exception_ptr error;
+
+    try {
+        task.job();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    finish(task.signal, error);
+}
+
+void JobSystem::finish(Counter *signal, std::exception_ptr error)
+{
+    if (signal == nullptr) {
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception &e) {
+                std::cerr << "job failed: " << e.what() << '\n';
+            } catch (...) {
+                std::cerr << "job failed\n";
+            }
+        }
+        return;
+    }
+
+    if (error) {
+        std::lock_guard lock(signal->mutex);
+        if (not signal->error) {
+            signal->error = error;
+        }
+    }
+    signal->pending--;
+}
+
+bool JobSystem::try_run_one(size_t thread_idx)
+{
+    size_t count = this->queues.size();
+    Task   task;
+    bool   found = false;
+
+    // own deque from the back (most recent, still in cache), others from the front
+    for (size_t i = 0; i < count && not found; i++) {
+        Queue &queue = *this->queues.at((thread_idx + i) % count);
+
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        found = true;
+    }
+
+    if (not found) {
+        return false;
+    }
+
+    this->queued--;
+    execute(task);
+    return true;
+}
+
+void JobSystem::worker_loop(std::stop_token token, size_t thread_idx)
+{
+    g_owner = this;
+    g_thread_idx = thread_idx;
+
+    while (not token.stop_requested()) {
+        if (try_run_one(thread_idx)) {
+            continue;
+        }
+
+        std::unique_lock lock(this->sleep_mutex);
+        this->sleep_cv.wait(lock, token, [this] { return this->queued.load() > 0; });
+    }
+}
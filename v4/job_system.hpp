@@ -0,0 +1,89 @@
+
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler. Every thread owns a deque - it pushes and pops its own jobs at the back
+// and idle threads steal from the front of the others. The thread that called start() is thread 0,
+// it only runs jobs while it waits on a counter.
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+
+    // counts unfinished jobs signalling it, must outlive every job referring to it
+    class Counter {
+    public:
+        [[nodiscard]]
+        bool done(void) const;
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<size_t> pending = 0;
+        std::mutex          mutex;
+        std::exception_ptr  error;
+    };
+
+    JobSystem() = default;
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator =(const JobSystem &) = delete;
+
+    // spawns the workers, threads counts the calling thread too, 0 means one per hardware thread
+    void start(size_t threads);
+    void stop(void);
+
+    [[nodiscard]]
+    size_t thread_count(void) const;
+
+    // signal is raised now and lowered when the job finishes, an exception thrown by the job is kept
+    // in signal and rethrown by wait()
+    void run(Job job, Counter *signal = nullptr);
+
+    // runs other jobs until counter is done, so it can be called from inside a job too
+    void wait(Counter &counter);
+
+    // calls fn(i) for every i in [0, count) as separate jobs and waits for them
+    void parallel_for(size_t count, const std::function<void(size_t)> &fn);
+
+private:
+    struct Task {
+        Job     job;
+        Counter *signal;
+    };
+
+    struct Queue {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    void push(Task task);
+    void execute(Task &task);
+    void finish(Counter *signal, std::exception_ptr error);
+
+    [[nodiscard]]
+    bool try_run_one(size_t thread_idx);
+
+    void worker_loop(std::stop_token token, size_t thread_idx);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::jthread>           workers;
+
+    // number of queued tasks, lets idle workers sleep instead of spinning on the deques
+    std::atomic<size_t>                 queued = 0;
+    std::mutex                          sleep_mutex;
+    std::condition_variable_any         sleep_cv;
+};
+
+#endif /* JOB_SYSTEM_HPP */
@@ -0,0 +1,310 @@
+
+#include "ktx2_file.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+static constexpr uint8_t IDENTIFIER[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+// key/value entries, sorted by key as the format requires
+static constexpr char WRITER_KEY[] = "KTXwriter";
+static constexpr char WRITER[]     = "v4 bake.elf";
+static constexpr char SOURCE_KEY[] = "v4source";
+
+// Khronos Data Format values for the descriptor every KTX2 file starts with
+static constexpr uint32_t KHR_DF_MODEL_RGBSDA           = 1;
+static constexpr uint32_t KHR_DF_MODEL_BC7              = 134;
+static constexpr uint32_t KHR_DF_MODEL_ASTC             = 162;
+static constexpr uint32_t KHR_DF_PRIMARIES_BT709        = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_LINEAR        = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_SRGB          = 2;
+static constexpr uint32_t KHR_DF_CHANNEL_RGBSDA_ALPHA   = 15;
+static constexpr uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool is_srgb(vk::Format format)
+{
+    return format == vk::Format::eBc7SrgbBlock ||
+           format == vk::Format::eAstc4x4SrgbBlock ||
+           format == vk::Format::eR8G8B8A8Srgb;
+}
+
+// entry of the key/value data, its length is followed by the key and the value, the key 0 terminated
+static void append_key_value(std::vector<uint8_t> &kvd, std::string_view key, std::span<const uint8_t> value)
+{
+    uint32_t length = key.size() + 1 + value.size();
+    size_t   offset = kvd.size();
+
+    kvd.resize(align_up(offset + sizeof(length) + length, 4), 0);
+    memcpy(kvd.data() + offset, &length, sizeof(length));
+    memcpy(kvd.data() + offset + sizeof(length), key.data(), key.size());
+    memcpy(kvd.data() + offset + sizeof(length) + key.size() + 1, value.data(), value.size());
+}
+
+// value of the entry with key, none if there is no such entry or the data is malformed
+static std::optional<std::string_view> find_key_value(std::string_view kvd, std::string_view key)
+{
+    size_t offset = 0;
+    while (offset + sizeof(uint32_t) <= kvd.size()) {
+        uint32_t length;
+        memcpy(&length, kvd.data() + offset, sizeof(length));
+        offset += sizeof(length);
+        if (length > kvd.size() - offset) {
+            return std::nullopt;
+        }
+
+        std::string_view entry = kvd.substr(offset, length);
+        size_t           end = entry.find('\0');
+        if (end != std::string_view::npos && entry.substr(0, end) == key) {
+            return entry.substr(end + 1);
+        }
+        offset = align_up(offset + length, 4);
+    }
+    return std::nullopt;
+}
+
+static std::optional<std::pair<uint64_t, int64_t>> get_source(const std::string &source_fname)
+{
+    std::error_code ec;
+    uint64_t        size = std::filesystem::file_size(source_fname, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    auto mtime = std::filesystem::last_write_time(source_fname, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return std::pair(size, int64_t(mtime.time_since_epoch().count()));
+}
+
+// basic descriptor block, one sample per channel of RGBA8, a single one covering a compressed block
+static std::vector<uint32_t> get_data_format_descriptor(vk::Format format)
+{
+    Ktx2File::Block block = Ktx2File::get_block(format);
+
+    uint32_t model = KHR_DF_MODEL_RGBSDA;
+    if (format == vk::Format::eBc7SrgbBlock || format == vk::Format::eBc7UnormBlock) {
+        model = KHR_DF_MODEL_BC7;
+    } else if (format == vk::Format::eAstc4x4SrgbBlock || format == vk::Format::eAstc4x4UnormBlock) {
+        model = KHR_DF_MODEL_ASTC;
+    }
+    uint32_t samples  = model == KHR_DF_MODEL_RGBSDA ? 4 : 1;
+    uint32_t transfer = is_srgb(format) ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+
+    std::vector<uint32_t> dfd = {
+        0,
+        // Khronos vendor, basic descriptor type
+        0,
+        // version 1.3, block size
+        2 | (24 + 16 * samples) << 16,
+        model | KHR_DF_PRIMARIES_BT709 << 8 | transfer << 16,
+        (block.width - 1) | (block.height - 1) << 8,
+        block.size,
+        0,
+    };
+
+    for (uint32_t sample = 0; sample < samples; sample++) {
+        if (samples == 1) {
+            dfd.insert(dfd.end(), { (block.size * 8 - 1) << 16, 0, 0, UINT32_MAX });
+        } else {
+            // alpha is never sRGB encoded
+            uint32_t channel = sample == 3 ? KHR_DF_CHANNEL_RGBSDA_ALPHA | KHR_DF_SAMPLE_DATATYPE_LINEAR : sample;
+            dfd.insert(dfd.end(), { sample * 8 | 7 << 16 | channel << 24, 0, 0, 255 });
+        }
+    }
+
+    dfd[0] = dfd.size() * sizeof(uint32_t);
+    return dfd;
+}
+
+bool Ktx2File::open(const std::string &fname, const std::string &source_fname)
+{
+    close();
+
+    std::error_code ec;
+    if (not std::filesystem::exists(fname, ec)) {
+        return false;
+    }
+
+    auto             file = std::make_unique<MappedFile>(fname, false);
+    std::string_view data = file->get();
+    Header           header;
+
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+
+    if (memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 ||
+        get_block(vk::Format(header.vk_format)).size == 0 ||
+        header.supercompression_scheme != 0 ||
+        header.pixel_width == 0 ||
+        header.pixel_height == 0 ||
+        header.pixel_depth != 0 ||
+        header.layer_count > 1 ||
+        header.face_count != 1 ||
+        header.level_count == 0 ||
+        header.level_count > uint32_t(std::bit_width(std::max(header.pixel_width, header.pixel_height))) ||
+        sizeof(Header) + header.level_count * sizeof(Level) > data.size() ||
+        uint64_t(header.kvd_byte_offset) + header.kvd_byte_length > data.size()) {
+        return false;
+    }
+
+    // a missing entry means the file was not baked by bake.elf, there is nothing to compare with
+    std::optional<std::pair<uint64_t, int64_t>> current = get_source(source_fname);
+    std::optional<std::string_view>             stored = find_key_value(
+        data.substr(header.kvd_byte_offset, header.kvd_byte_length),
+        SOURCE_KEY
+    );
+    if (not current || not stored || stored->size() != sizeof(Source)) {
+        return false;
+    }
+    Source source;
+    memcpy(&source, stored->data(), sizeof(source));
+    if (source.size != current->first || source.mtime != current->second) {
+        return false;
+    }
+
+    const Level *levels = reinterpret_cast<const Level *>(data.data() + sizeof(Header));
+    for (uint32_t level = 0; level < header.level_count; level++) {
+        uint64_t size = get_level_size(vk::Format(header.vk_format), header.pixel_width, header.pixel_height, level);
+        if (levels[level].byte_length != size || levels[level].byte_offset + size > data.size()) {
+            return false;
+        }
+    }
+
+    // mmap returns page aligned memory, the header and level index are aligned within it
+    this->header = reinterpret_cast<const Header *>(data.data());
+    this->levels = levels;
+    this->file = std::move(file);
+    return true;
+}
+
+void Ktx2File::close(void)
+{
+    this->header = nullptr;
+    this->levels = nullptr;
+    this->file.reset();
+}
+
+bool Ktx2File::is_open(void) const
+{
+    return this->header != nullptr;
+}
+
+vk::Format Ktx2File::get_format(void) const
+{
+    return vk::Format(this->header->vk_format);
+}
+
+uint32_t Ktx2File::get_width(void) const
+{
+    return this->header->pixel_width;
+}
+
+uint32_t Ktx2File::get_height(void) const
+{
+    return this->header->pixel_height;
+}
+
+uint32_t Ktx2File::get_level_count(void) const
+{
+    return this->header->level_count;
+}
+
+std::span<const uint8_t> Ktx2File::get_level(uint32_t level) const
+{
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(this->header);
+    return { base + this->levels[level].byte_offset, this->levels[level].byte_length };
+}
+
+std::vector<uint8_t> Ktx2File::serialize(
+        const std::string &source_fname,
+        vk::Format format,
+        uint32_t width,
+        uint32_t height,
+        const std::vector<std::vector<uint8_t>> &levels
+    )
+{
+    Block block = get_block(format);
+
+    std::vector<uint32_t> dfd = get_data_format_descriptor(format);
+
+    std::optional<std::pair<uint64_t, int64_t>> current = get_source(source_fname);
+    if (not current) {
+        throw std::runtime_error("failed to stat file: " + source_fname);
+    }
+    Source source = { current->first, current->second };
+
+    // the writer is a string, so its value is 0 terminated too
+    std::vector<uint8_t> kvd;
+    append_key_value(kvd, WRITER_KEY, std::span(reinterpret_cast<const uint8_t *>(WRITER), sizeof(WRITER)));
+    append_key_value(kvd, SOURCE_KEY, std::span(reinterpret_cast<const uint8_t *>(&source), sizeof(source)));
+
+    Header header = {};
+    memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.vk_format       = uint32_t(format);
+    header.type_size       = 1;
+    header.pixel_width     = width;
+    header.pixel_height    = height;
+    header.face_count      = 1;
+    header.level_count     = levels.size();
+    header.dfd_byte_offset = sizeof(Header) + levels.size() * sizeof(Level);
+    header.dfd_byte_length = dfd.size() * sizeof(uint32_t);
+    header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+    header.kvd_byte_length = kvd.size();
+
+    // the smallest level comes first in the file, each at a multiple of the block size
+    std::vector<Level> index(levels.size());
+    uint64_t           offset = header.kvd_byte_offset + header.kvd_byte_length;
+    for (size_t level = levels.size(); level-- > 0;) {
+        offset = align_up(offset, std::lcm(block.size, 4u));
+        index[level] = { offset, levels[level].size(), levels[level].size() };
+        offset += levels[level].size();
+    }
+
+    std::vector<uint8_t> data(offset, 0);
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(header), index.data(), index.size() * sizeof(Level));
+    memcpy(data.data() + header.dfd_byte_offset, dfd.data(), header.dfd_byte_length);
+    memcpy(data.data() + header.kvd_byte_offset, kvd.data(), kvd.size());
+    for (size_t level = 0; level < levels.size(); level++) {
+        memcpy(data.data() + index[level].byte_offset, levels[level].data(), levels[level].size());
+    }
+    return data;
+}
+
+Ktx2File::Block Ktx2File::get_block(vk::Format format)
+{
+    switch (format) {
+    case vk::Format::eBc7SrgbBlock:
+    case vk::Format::eBc7UnormBlock:
+    case vk::Format::eAstc4x4SrgbBlock:
+    case vk::Format::eAstc4x4UnormBlock:
+        return { 4, 4, 16 };
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eR8G8B8A8Unorm:
+        return { 1, 1, 4 };
+    default:
+        return { 1, 1, 0 };
+    }
+}
+
+uint64_t Ktx2File::get_level_size(vk::Format format, uint32_t width, uint32_t height, uint32_t level)
+{
+    Block    block = get_block(format);
+    uint64_t level_width = std::max(width >> level, 1u);
+    uint64_t level_height = std::max(height >> level, 1u);
+
+    return (level_width + block.width - 1) / block.width * ((level_height + block.height - 1) / block.height) * block.size;
+}
@@ -0,0 +1,108 @@
+
+#ifndef KTX2_FILE_HPP
+#define KTX2_FILE_HPP
+
+#include "mapped_file.hpp"
+
+#include "vulkan/vulkan.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// Mapped KTX2 texture (Khronos KTX 2.0), the subset bake.elf writes: a single 2D image without
+// supercompression, with every mip level stored. Levels are handed out as they are in the mapping,
+// ready for a buffer to image copy. The size and modification time of the image it was baked from
+// are kept in a key/value entry, the file is stale once they change
+class Ktx2File {
+public:
+    // texel block of a format, 1x1 for uncompressed ones
+    struct Block {
+        uint32_t width;
+        uint32_t height;
+        uint32_t size;
+    };
+
+    // maps fname if it is such a KTX2 file of a format get_block knows, baked from source_fname as it
+    // is now
+    [[nodiscard]]
+    bool open(const std::string &fname, const std::string &source_fname);
+    void close(void);
+
+    [[nodiscard]]
+    bool is_open(void) const;
+
+    [[nodiscard]]
+    vk::Format get_format(void) const;
+
+    [[nodiscard]]
+    uint32_t get_width(void) const;
+
+    [[nodiscard]]
+    uint32_t get_height(void) const;
+
+    [[nodiscard]]
+    uint32_t get_level_count(void) const;
+
+    // level 0 is the full size image
+    [[nodiscard]]
+    std::span<const uint8_t> get_level(uint32_t level) const;
+
+    // contents of a KTX2 file of levels baked from source_fname, level 0 first, each sized as
+    // get_level_size says
+    [[nodiscard]]
+    static std::vector<uint8_t> serialize(
+        const std::string &source_fname,
+        vk::Format format,
+        uint32_t width,
+        uint32_t height,
+        const std::vector<std::vector<uint8_t>> &levels
+    );
+
+    // BC7, ASTC 4x4 and RGBA8, sRGB or not, a size of 0 for any other format
+    [[nodiscard]]
+    static Block get_block(vk::Format format);
+
+    [[nodiscard]]
+    static uint64_t get_level_size(vk::Format format, uint32_t width, uint32_t height, uint32_t level);
+
+private:
+    struct Header {
+        uint8_t  identifier[12];
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+        uint32_t dfd_byte_offset;
+        uint32_t dfd_byte_length;
+        uint32_t kvd_byte_offset;
+        uint32_t kvd_byte_length;
+        uint64_t sgd_byte_offset;
+        uint64_t sgd_byte_length;
+    };
+
+    // value of the SOURCE_KEY entry
+    struct Source {
+        uint64_t size;
+        int64_t  mtime;
+    };
+
+    struct Level {
+        uint64_t byte_offset;
+        uint64_t byte_length;
+        uint64_t uncompressed_byte_length;
+    };
+
+    std::unique_ptr<MappedFile> file;
+    const Header                *header = nullptr;
+    const Level                 *levels = nullptr;
+};
+
+#endif /* KTX2_FILE_HPP */
@@ -0,0 +1,50 @@
+
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &fname, bool advice_sequential)
+{
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file: " + fname);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("failed to stat file: " + fname);
+    }
+    this->size = st.st_size;
+
+    if (this->size != 0) {
+        this->data = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (this->data == MAP_FAILED) {
+        this->size = 0;
+        throw std::runtime_error("failed to map file: " + fname);
+    }
+    if (this->size != 0 && advice_sequential) {
+        madvise(this->data, this->size, MADV_SEQUENTIAL);
+        madvise(this->data, this->size, MADV_WILLNEED);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (this->size != 0) {
+        munmap(this->data, this->size);
+    }
+}
+
+std::string_view MappedFile::get(void) const
+{
+    return { static_cast<const char *>(this->data), this->size };
+}
@@ -0,0 +1,26 @@
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <string_view>
+
+// read-only mapping of a whole file, an empty file maps to an empty view
+class MappedFile {
+public:
+    // advice_sequential hints the kernel to read ahead, for files that are read front to back once
+    MappedFile(const std::string &fname, bool advice_sequential);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator =(const MappedFile &) = delete;
+
+    [[nodiscard]]
+    std::string_view get(void) const;
+
+private:
+    void   *data = nullptr;
+    size_t size  = 0;
+};
+
+#endif /* MAPPED_FILE_HPP */
@@ -0,0 +1,236 @@
+
+#include "memory_tracker.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+static constexpr double MIB = 1024.0 * 1024.0;
+
+void MemoryTracker::init(const vk::raii::PhysicalDevice &pd, bool memory_budget, double warn_pct)
+{
+    vk::PhysicalDeviceMemoryProperties mem_props = pd.getMemoryProperties();
+
+    this->memory_budget = memory_budget;
+    this->warn_pct = warn_pct;
+
+    this->type_heaps.clear();
+    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+        this->type_heaps.push_back(mem_props.memoryTypes[i].heapIndex);
+    }
+
+    this->heaps.assign(mem_props.memoryHeapCount, Heap());
+    for (uint32_t i = 0; i < mem_props.memoryHeapCount; i++) {
+        this->heaps.at(i).size = mem_props.memoryHeaps[i].size;
+        this->heaps.at(i).device_local = static_cast<bool>(mem_props.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        this->heaps.at(i).budget = mem_props.memoryHeaps[i].size;
+    }
+
+    update_budget(pd);
+}
+
+void MemoryTracker::check_budget(uint32_t type_index, vk::DeviceSize size)
+{
+    uint32_t       heap_idx = this->type_heaps.at(type_index);
+    const Heap     &heap    = this->heaps.at(heap_idx);
+    vk::DeviceSize usage    = get_heap_usage(heap_idx) + size;
+
+    // going over the budget is not an error yet, the driver starts to page or the allocation fails
+    if (usage > heap.budget) {
+        warn(heap_idx, usage, "allocation exceeds the budget");
+    } else if (usage > heap.budget * this->warn_pct / 100.0 && not heap.warned) {
+        warn(heap_idx, usage, "allocation gets close to the budget");
+    }
+}
+
+void MemoryTracker::add(MemoryCategory category, uint32_t type_index, vk::DeviceSize size)
+{
+    grow(this->categories.at(static_cast<size_t>(category)), size);
+    grow(this->heaps.at(this->type_heaps.at(type_index)).usage, size);
+}
+
+void MemoryTracker::remove(MemoryCategory category, uint32_t type_index, vk::DeviceSize size)
+{
+    Heap &heap = this->heaps.at(this->type_heaps.at(type_index));
+
+    this->categories.at(static_cast<size_t>(category)).current -= size;
+    heap.usage.current -= size;
+
+    if (heap.warned && get_heap_usage(this->type_heaps.at(type_index)) <= heap.budget * this->warn_pct / 100.0) {
+        heap.warned = false;
+    }
+}
+
+void MemoryTracker::update_budget(const vk::raii::PhysicalDevice &pd)
+{
+    if (this->memory_budget) {
+        auto props = pd.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2,
+                                             vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        const auto &budget = props.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+        for (size_t i = 0; i < this->heaps.size(); i++) {
+            this->heaps.at(i).budget = budget.heapBudget[i];
+            this->heaps.at(i).driver_usage = budget.heapUsage[i];
+            this->heaps.at(i).usage_at_query = this->heaps.at(i).usage.current;
+        }
+    }
+
+    for (uint32_t i = 0; i < this->heaps.size(); i++) {
+        Heap           &heap = this->heaps.at(i);
+        vk::DeviceSize usage = get_heap_usage(i);
+
+        if (usage > heap.budget * this->warn_pct / 100.0) {
+            if (not heap.warned) {
+                warn(i, usage, "heap usage is close to the budget");
+            }
+        } else {
+            heap.warned = false;
+        }
+    }
+}
+
+vk::DeviceSize MemoryTracker::get_heap_usage(uint32_t heap_idx) const
+{
+    const Heap &heap = this->heaps.at(heap_idx);
+
+    if (not this->memory_budget) {
+        return heap.usage.current;
+    }
+    // the driver has not seen what was allocated or freed since the query
+    int64_t delta = static_cast<int64_t>(heap.usage.current) - static_cast<int64_t>(heap.usage_at_query);
+    return std::max<int64_t>(static_cast<int64_t>(heap.driver_usage) + delta, 0);
+}
+
+const MemoryTracker::Usage &MemoryTracker::get_usage(MemoryCategory category) const
+{
+    return this->categories.at(static_cast<size_t>(category));
+}
+
+const std::vector<MemoryTracker::Heap> &MemoryTracker::get_heaps(void) const
+{
+    return this->heaps;
+}
+
+const char *MemoryTracker::get_category_name(MemoryCategory category)
+{
+    switch (category) {
+    case MemoryCategory::Vertex:
+        return "vertex";
+    case MemoryCategory::Index:
+        return "index";
+    case MemoryCategory::Texture:
+        return "texture";
+    case MemoryCategory::Attachment:
+        return "attachment";
+    case MemoryCategory::Staging:
+        return "staging";
+    case MemoryCategory::Uniform:
+        return "uniform";
+    case MemoryCategory::Storage:
+        return "storage";
+    }
+    return "unknown";
+}
+
+void MemoryTracker::print(std::ostream &os) const
+{
+    os << "device memory (MiB):\n"
+       << std::left << std::setw(14) << "    category"
+       << std::right << std::setw(12) << "current" << std::setw(12) << "peak" << std::setw(14) << "allocations\n"
+       << std::fixed << std::setprecision(2);
+
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        const Usage &usage = this->categories.at(i);
+        os << "    " << std::left << std::setw(10) << get_category_name(static_cast<MemoryCategory>(i))
+           << std::right << std::setw(12) << usage.current / MIB
+           << std::setw(12) << usage.peak / MIB
+           << std::setw(13) << usage.allocations << '\n';
+    }
+
+    for (uint32_t i = 0; i < this->heaps.size(); i++) {
+        const Heap &heap = this->heaps.at(i);
+        os << "    heap " << i << (heap.device_local ? " (device local)" : " (host)")
+           << ": engine " << heap.usage.current / MIB << ", peak " << heap.usage.peak / MIB;
+        if (this->memory_budget) {
+            os << ", process " << get_heap_usage(i) / MIB;
+        }
+        os << " of budget " << heap.budget / MIB
+           << " (" << std::setprecision(1) << get_heap_usage(i) * 100.0 / std::max<vk::DeviceSize>(heap.budget, 1)
+           << "%)" << std::setprecision(2) << '\n';
+    }
+
+    os << std::defaultfloat;
+}
+
+void MemoryTracker::warn(uint32_t heap_idx, vk::DeviceSize usage, const char *reason)
+{
+    Heap &heap = this->heaps.at(heap_idx);
+
+    heap.warned = true;
+    std::cerr << "memory warning: " << reason << " (heap " << heap_idx << ", "
+              << usage / MIB << " of " << heap.budget / MIB << " MiB)\n";
+}
+
+void MemoryTracker::grow(Usage &usage, vk::DeviceSize size)
+{
+    usage.current += size;
+    usage.peak = std::max(usage.peak, usage.current);
+    usage.allocations++;
+}
+
+TrackedMemory::TrackedMemory(std::nullptr_t)
+    : vk::raii::DeviceMemory(nullptr)
+{
+}
+
+TrackedMemory::TrackedMemory(
+        vk::raii::DeviceMemory &&memory,
+        MemoryTracker &tracker,
+        MemoryCategory category,
+        uint32_t type_index,
+        vk::DeviceSize size
+    )
+    : vk::raii::DeviceMemory(std::move(memory)),
+      tracker(&tracker),
+      category(category),
+      type_index(type_index),
+      size(size)
+{
+    tracker.add(category, type_index, size);
+}
+
+TrackedMemory::~TrackedMemory()
+{
+    release();
+}
+
+TrackedMemory::TrackedMemory(TrackedMemory &&other) noexcept
+    : vk::raii::DeviceMemory(std::move(other)),
+      tracker(std::exchange(other.tracker, nullptr)),
+      category(other.category),
+      type_index(other.type_index),
+      size(other.size)
+{
+}
+
+TrackedMemory &TrackedMemory::operator =(TrackedMemory &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        vk::raii::DeviceMemory::operator =(std::move(other));
+        this->tracker = std::exchange(other.tracker, nullptr);
+        this->category = other.category;
+        this->type_index = other.type_index;
+        this->size = other.size;
+    }
+    return *this;
+}
+
+void TrackedMemory::release(void)
+{
+    if (this->tracker != nullptr) {
+        this->tracker->remove(this->category, this->type_index, this->size);
+        this->tracker = nullptr;
+    }
+}
@@ -0,0 +1,112 @@
+
+#ifndef MEMORY_TRACKER_HPP
+#define MEMORY_TRACKER_HPP
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+#include <array>
+#include <ostream>
+#include <vector>
+
+enum class MemoryCategory {
+    Vertex,
+    Index,
+    Texture,
+    Attachment,
+    Staging,
+    Uniform,
+    Storage,
+};
+
+// Counts device memory by category and by heap and compares the heaps against their budget. With
+// VK_EXT_memory_budget the budget and the usage of the whole process come from the driver (re-read by
+// update_budget(), allocations made since are added on top), otherwise the budget is the heap size.
+// Not thread safe, device memory is only allocated from the main thread.
+class MemoryTracker {
+public:
+    static constexpr size_t CATEGORY_COUNT = 7;
+
+    struct Usage {
+        vk::DeviceSize current     = 0;
+        vk::DeviceSize peak        = 0;
+        uint64_t       allocations = 0;
+    };
+
+    struct Heap {
+        vk::DeviceSize size           = 0;
+        bool           device_local   = false;
+        // allocations of the engine
+        Usage          usage;
+        // read by update_budget(), budget is the heap size without VK_EXT_memory_budget
+        vk::DeviceSize budget         = 0;
+        vk::DeviceSize driver_usage   = 0;
+        // usage.current at the time driver_usage was read
+        vk::DeviceSize usage_at_query = 0;
+        bool           warned         = false;
+    };
+
+    void init(const vk::raii::PhysicalDevice &pd, bool memory_budget, double warn_pct);
+
+    // warns when an allocation of size would take its heap past warn_pct of the budget, call before allocating
+    void check_budget(uint32_t type_index, vk::DeviceSize size);
+
+    void add(MemoryCategory category, uint32_t type_index, vk::DeviceSize size);
+    void remove(MemoryCategory category, uint32_t type_index, vk::DeviceSize size);
+
+    // re-reads budgets and usage of the process, they change with allocations of other processes too
+    void update_budget(const vk::raii::PhysicalDevice &pd);
+
+    // usage of the heap including memory of other processes and drivers internals when it is known
+    [[nodiscard]]
+    vk::DeviceSize get_heap_usage(uint32_t heap) const;
+
+    [[nodiscard]]
+    const Usage &get_usage(MemoryCategory category) const;
+
+    [[nodiscard]]
+    const std::vector<Heap> &get_heaps(void) const;
+
+    [[nodiscard]]
+    static const char *get_category_name(MemoryCategory category);
+
+    void print(std::ostream &os) const;
+
+private:
+    void warn(uint32_t heap, vk::DeviceSize usage, const char *reason);
+
+    static void grow(Usage &usage, vk::DeviceSize size);
+
+    bool                                memory_budget = false;
+    double                              warn_pct      = 100;
+    std::vector<uint32_t>               type_heaps;
+    std::vector<Heap>                   heaps;
+    std::array<Usage, CATEGORY_COUNT>   categories    = {};
+};
+
+// device memory that is counted by a MemoryTracker until it is freed
+class TrackedMemory : public vk::raii::DeviceMemory {
+public:
+    TrackedMemory(std::nullptr_t);
+    TrackedMemory(
+        vk::raii::DeviceMemory &&memory,
+        MemoryTracker &tracker,
+        MemoryCategory category,
+        uint32_t type_index,
+        vk::DeviceSize size
+    );
+    ~TrackedMemory();
+
+    TrackedMemory(TrackedMemory &&other) noexcept;
+    TrackedMemory &operator =(TrackedMemory &&other) noexcept;
+
+private:
+    void release(void);
+
+    MemoryTracker  *tracker   = nullptr;
+    MemoryCategory category   = MemoryCategory::Staging;
+    uint32_t       type_index = 0;
+    vk::DeviceSize size       = 0;
+};
+
+#endif /* MEMORY_TRACKER_HPP */
@@ -0,0 +1,171 @@
+
+#include "mesh_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+
+static constexpr char MAGIC[8] = { 'V', '4', 'M', 'E', 'S', 'H', 0, 0 };
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool MeshCache::open(const std::string &fname, const std::string &source_fname, const Settings &settings, bool verify)
+{
+    close();
+
+    std::error_code ec;
+    if (not std::filesystem::exists(fname, ec)) {
+        return false;
+    }
+
+    uint64_t source_size = std::filesystem::file_size(source_fname);
+    int64_t  source_mtime = std::filesystem::last_write_time(source_fname).time_since_epoch().count();
+
+    auto             file = std::make_unique<MappedFile>(fname, false);
+    std::string_view data = file->get();
+    Header           header;
+
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+
+    uint64_t vertex_bytes = header.vertex_count * sizeof(Vertex);
+    uint64_t index_bytes  = header.index_count * sizeof(uint32_t);
+
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION ||
+        header.vertex_size != sizeof(Vertex) ||
+        header.source_size != source_size ||
+        header.source_mtime != source_mtime ||
+        header.settings != settings ||
+        header.vertex_offset % BLOB_ALIGNMENT != 0 ||
+        header.index_offset % BLOB_ALIGNMENT != 0 ||
+        header.vertex_offset + vertex_bytes > data.size() ||
+        header.index_offset + index_bytes > data.size() ||
+        header.lod_count > MAX_LODS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.lod_count; i++) {
+        if (uint64_t(header.lods[i].first_index) + header.lods[i].index_count > header.index_count) {
+            return false;
+        }
+    }
+
+    if (verify) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data.data());
+        uint64_t content_hash = hash(bytes + header.vertex_offset, vertex_bytes, 0);
+        content_hash = hash(bytes + header.index_offset, index_bytes, content_hash);
+        if (content_hash != header.content_hash) {
+            return false;
+        }
+    }
+
+    // mmap returns page aligned memory, the header and blobs are aligned within it
+    this->header = reinterpret_cast<const Header *>(data.data());
+    this->file = std::move(file);
+    return true;
+}
+
+void MeshCache::close(void)
+{
+    this->header = nullptr;
+    this->file.reset();
+}
+
+std::vector<uint8_t> MeshCache::serialize(
+        const std::string &source_fname,
+        const Settings &settings,
+        std::span<const Vertex> vertices,
+        std::span<const uint32_t> indices,
+        std::span<const MeshLod> lods
+    )
+{
+    Header header = {};
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version       = VERSION;
+    header.vertex_size   = sizeof(Vertex);
+    header.source_size   = std::filesystem::file_size(source_fname);
+    header.source_mtime  = std::filesystem::last_write_time(source_fname).time_since_epoch().count();
+    header.settings      = settings;
+    header.vertex_count  = vertices.size();
+    header.vertex_offset = align_up(sizeof(Header), BLOB_ALIGNMENT);
+    header.index_count   = indices.size();
+    header.index_offset  = align_up(header.vertex_offset + vertices.size_bytes(), BLOB_ALIGNMENT);
+
+    Bounds bounds = compute_bounds(vertices);
+    std::ranges::copy(std::span<const float>(&bounds.min.x, 3), header.bounds_min);
+    std::ranges::copy(std::span<const float>(&bounds.max.x, 3), header.bounds_max);
+
+    header.lod_count = std::min<size_t>(lods.size(), MAX_LODS);
+    std::ranges::copy(lods.first(header.lod_count), header.lods);
+
+    std::vector<uint8_t> data(header.index_offset + indices.size_bytes(), 0);
+    memcpy(data.data() + header.vertex_offset, vertices.data(), vertices.size_bytes());
+    memcpy(data.data() + header.index_offset, indices.data(), indices.size_bytes());
+
+    header.content_hash = hash(data.data() + header.vertex_offset, vertices.size_bytes(), 0);
+    header.content_hash = hash(data.data() + header.index_offset, indices.size_bytes(), header.content_hash);
+
+    memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+std::span<const Vertex> MeshCache::get_vertices(void) const
+{
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(this->header);
+    return { reinterpret_cast<const Vertex *>(base + this->header->vertex_offset), this->header->vertex_count };
+}
+
+std::span<const uint32_t> MeshCache::get_indices(void) const
+{
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(this->header);
+    return { reinterpret_cast<const uint32_t *>(base + this->header->index_offset), this->header->index_count };
+}
+
+std::span<const MeshLod> MeshCache::get_lods(void) const
+{
+    return { this->header->lods, this->header->lod_count };
+}
+
+MeshCache::Bounds MeshCache::get_bounds(void) const
+{
+    return {
+        { this->header->bounds_min[0], this->header->bounds_min[1], this->header->bounds_min[2] },
+        { this->header->bounds_max[0], this->header->bounds_max[1], this->header->bounds_max[2] },
+    };
+}
+
+MeshCache::Bounds MeshCache::compute_bounds(std::span<const Vertex> vertices)
+{
+    glm::vec3 min(vertices.empty() ? 0.0f : INFINITY);
+    glm::vec3 max(vertices.empty() ? 0.0f : -INFINITY);
+    for (const Vertex &vertex : vertices) {
+        min = glm::min(min, vertex.pos);
+        max = glm::max(max, vertex.pos);
+    }
+    return { min, max };
+}
+
+// word at a time multiply-xorshift, verifies hundreds of MB in tens of milliseconds
+uint64_t MeshCache::hash(const uint8_t *data, size_t size, uint64_t seed)
+{
+    uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    for (size_t i = size & ~size_t(7); i < size; i++) {
+        h = (h ^ data[i]) * 0xc4ceb9fe1a85ec53ull;
+    }
+
+    return h ^ (h >> 29);
+}
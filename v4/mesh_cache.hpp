@@ -0,0 +1,103 @@
+
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include "mapped_file.hpp"
+#include "mesh_simplifier.hpp"
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// Binary copy of a deduplicated mesh, mapped instead of parsing the source model again. The vertex
+// and index blobs are stored as Vertex and uint32_t, so loading is a mapping and one pass into the
+// staging buffer. The index blob holds every LOD of the chain, the ranges are in the header. The
+// cache is stale once the size or modification time of the source changes, the format version or
+// the Vertex layout does, or it was built with other Settings.
+class MeshCache {
+public:
+    static constexpr uint32_t VERSION = 5;
+    // matches MAX_LODS in shader.slang
+    static constexpr uint32_t MAX_LODS = 8;
+
+    struct Bounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // build settings baked into the contents
+    struct Settings {
+        uint32_t optimize;
+        uint32_t optimize_cache_size;
+        float    optimize_overdraw_threshold;
+        uint32_t lod_count;
+        float    lod_ratio;
+
+        bool operator ==(const Settings &) const = default;
+    };
+
+    // maps fname if it is a valid cache of source_fname built with settings, verify also checks the
+    // content hash
+    [[nodiscard]]
+    bool open(const std::string &fname, const std::string &source_fname, const Settings &settings, bool verify);
+    void close(void);
+
+    // contents of the cache file for a mesh loaded from source_fname
+    [[nodiscard]]
+    static std::vector<uint8_t> serialize(
+        const std::string &source_fname,
+        const Settings &settings,
+        std::span<const Vertex> vertices,
+        std::span<const uint32_t> indices,
+        std::span<const MeshLod> lods
+    );
+
+    [[nodiscard]]
+    std::span<const Vertex> get_vertices(void) const;
+
+    [[nodiscard]]
+    std::span<const uint32_t> get_indices(void) const;
+
+    [[nodiscard]]
+    std::span<const MeshLod> get_lods(void) const;
+
+    [[nodiscard]]
+    Bounds get_bounds(void) const;
+
+    [[nodiscard]]
+    static Bounds compute_bounds(std::span<const Vertex> vertices);
+
+private:
+    // blobs start at multiples of BLOB_ALIGNMENT from the start of the file
+    static constexpr uint64_t BLOB_ALIGNMENT = 64;
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t vertex_size;
+        uint64_t source_size;
+        int64_t  source_mtime;
+        Settings settings;
+        uint64_t vertex_count;
+        uint64_t vertex_offset;
+        uint64_t index_count;
+        uint64_t index_offset;
+        float    bounds_min[3];
+        float    bounds_max[3];
+        uint32_t lod_count;
+        MeshLod  lods[MAX_LODS];
+        // of the vertex and index blobs
+        uint64_t content_hash;
+    };
+
+    [[nodiscard]]
+    static uint64_t hash(const uint8_t *data, size_t size, uint64_t seed);
+
+    std::unique_ptr<MappedFile> file;
+    const Header                *header = nullptr;
+};
+
+#endif /* MESH_CACHE_HPP */
@@ -0,0 +1,303 @@
+
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// FIFO cache emulated with insertion timestamps, a vertex is cached while fewer than cache_size
+// vertices were inserted after it. Returns the number of misses of the triangle
+static uint32_t update_cache(
+        const uint32_t *triangle,
+        uint32_t cache_size,
+        std::vector<uint32_t> &timestamps,
+        uint32_t &time
+    )
+{
+    uint32_t misses = 0;
+
+    for (size_t i = 0; i < 3; i++) {
+        uint32_t &timestamp = timestamps[triangle[i]];
+        if (time - timestamp > cache_size) {
+            timestamp = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count, uint32_t cache_size)
+{
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    std::vector<bool>     used(vertex_count, false);
+    uint32_t              time   = cache_size + 1;
+    size_t                misses = 0;
+
+    for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+        misses += update_cache(&indices[i], cache_size, timestamps, time);
+    }
+
+    size_t used_count = 0;
+    for (uint32_t index : indices) {
+        if (not used[index]) {
+            used[index] = true;
+            used_count++;
+        }
+    }
+
+    return {
+        indices.empty() ? 0.0 : static_cast<double>(misses) / (indices.size() / 3),
+        used_count == 0 ? 0.0 : static_cast<double>(misses) / used_count,
+    };
+}
+
+void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count, uint32_t cache_size)
+{
+    size_t triangle_count = indices.size() / 3;
+
+    // triangles of every vertex as one flat array, offsets[v] is the start of vertex v
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (uint32_t index : indices.first(triangle_count * 3)) {
+        live[index]++;
+    }
+
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    std::inclusive_scan(live.begin(), live.end(), offsets.begin() + 1);
+
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t t = 0; t < triangle_count; t++) {
+        for (size_t k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    std::vector<bool>     emitted(triangle_count, false);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    uint32_t              time   = cache_size + 1;
+    size_t                cursor = 0;
+
+    result.reserve(triangle_count * 3);
+
+    for (int64_t fan = vertex_count > 0 ? 0 : -1; fan >= 0;) {
+        candidates.clear();
+
+        for (uint32_t i = offsets[fan]; i < offsets[fan + 1]; i++) {
+            uint32_t t = adjacency[i];
+            if (emitted[t]) {
+                continue;
+            }
+
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+
+                result.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if (time - timestamps[v] > cache_size) {
+                    timestamps[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // next fan is the candidate that has been in the cache longest and still stays there
+        // while its remaining triangles are emitted
+        int64_t best_priority = -1;
+        fan = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+
+            int64_t priority = 0;
+            if (time - timestamps[v] + 2 * live[v] <= cache_size) {
+                priority = time - timestamps[v];
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                fan = v;
+            }
+        }
+
+        while (fan < 0 && not dead_end.empty()) {
+            uint32_t v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v] > 0) {
+                fan = v;
+            }
+        }
+        for (; fan < 0 && cursor < vertex_count; cursor++) {
+            if (live[cursor] > 0) {
+                fan = cursor;
+            }
+        }
+    }
+
+    std::ranges::copy(result, indices.begin());
+}
+
+// cluster starts where all three vertices of a triangle miss, that is usually a disjoint patch
+static std::vector<uint32_t> get_hard_boundaries(
+        std::span<const uint32_t> indices,
+        size_t vertex_count,
+        uint32_t cache_size
+    )
+{
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    std::vector<uint32_t> boundaries;
+    uint32_t              time = cache_size + 1;
+
+    for (uint32_t t = 0; t < indices.size() / 3; t++) {
+        if (update_cache(&indices[t * 3], cache_size, timestamps, time) == 3 || t == 0) {
+            boundaries.push_back(t);
+        }
+    }
+    return boundaries;
+}
+
+// splits hard clusters further wherever the ACMR of the part so far is within threshold of the cluster
+static std::vector<uint32_t> get_soft_boundaries(
+        std::span<const uint32_t> indices,
+        size_t vertex_count,
+        const std::vector<uint32_t> &hard_boundaries,
+        uint32_t cache_size,
+        float threshold
+    )
+{
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    std::vector<uint32_t> boundaries;
+    uint32_t              time = 0;
+    uint32_t              triangle_count = indices.size() / 3;
+
+    for (size_t c = 0; c < hard_boundaries.size(); c++) {
+        uint32_t begin = hard_boundaries[c];
+        uint32_t end   = c + 1 < hard_boundaries.size() ? hard_boundaries[c + 1] : triangle_count;
+
+        // every measurement starts with an empty cache
+        time += cache_size + 1;
+        uint32_t cluster_misses = 0;
+        for (uint32_t t = begin; t < end; t++) {
+            cluster_misses += update_cache(&indices[t * 3], cache_size, timestamps, time);
+        }
+        float cluster_acmr = static_cast<float>(cluster_misses) / (end - begin) * threshold;
+
+        time += cache_size + 1;
+        uint32_t misses = 0;
+        uint32_t start  = begin;
+        for (uint32_t t = begin; t < end; t++) {
+            misses += update_cache(&indices[t * 3], cache_size, timestamps, time);
+
+            if (static_cast<float>(misses) / (t - start + 1) <= cluster_acmr) {
+                boundaries.push_back(start);
+                start = t + 1;
+                misses = 0;
+                time += cache_size + 1;
+            }
+        }
+        if (start < end) {
+            boundaries.push_back(start);
+        }
+    }
+    return boundaries;
+}
+
+void optimize_overdraw(
+        std::span<uint32_t> indices,
+        std::span<const Vertex> vertices,
+        uint32_t cache_size,
+        float threshold
+    )
+{
+    uint32_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    std::vector<uint32_t> hard = get_hard_boundaries(indices, vertices.size(), cache_size);
+    std::vector<uint32_t> soft = get_soft_boundaries(indices, vertices.size(), hard, cache_size, threshold);
+
+    glm::vec3 mesh_centroid(0.0f);
+    for (uint32_t index : indices.first(triangle_count * 3)) {
+        mesh_centroid += vertices[index].pos;
+    }
+    mesh_centroid /= static_cast<float>(triangle_count * 3);
+
+    // how far the cluster faces away from the center, area weighted
+    std::vector<float> keys(soft.size());
+    for (size_t c = 0; c < soft.size(); c++) {
+        uint32_t  end = c + 1 < soft.size() ? soft[c + 1] : triangle_count;
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float     area = 0.0f;
+
+        for (uint32_t t = soft[c]; t < end; t++) {
+            const glm::vec3 &a = vertices[indices[t * 3 + 0]].pos;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3 &d = vertices[indices[t * 3 + 2]].pos;
+
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float     w = glm::length(n);
+
+            centroid += (a + b + d) * (w / 3.0f);
+            normal += n;
+            area += w;
+        }
+
+        float length = glm::length(normal);
+        if (area > 0.0f && length > 0.0f) {
+            keys[c] = glm::dot(centroid / area - mesh_centroid, normal / length);
+        }
+    }
+
+    std::vector<uint32_t> order(soft.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, [&keys](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t c : order) {
+        uint32_t end = c + 1 < soft.size() ? soft[c + 1] : triangle_count;
+        result.insert(result.end(), indices.begin() + soft[c] * 3, indices.begin() + end * 3);
+    }
+
+    std::ranges::copy(result, indices.begin());
+}
+
+void optimize_vertex_fetch(std::vector<Vertex> &vertices, std::span<uint32_t> indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex>   result;
+
+    result.reserve(vertices.size());
+    for (uint32_t &index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+}
+
+std::pair<VertexCacheStats, VertexCacheStats> optimize_mesh(
+        std::vector<Vertex> &vertices,
+        std::vector<uint32_t> &indices,
+        uint32_t cache_size,
+        float overdraw_threshold
+    )
+{
+    VertexCacheStats before = analyze_vertex_cache(indices, vertices.size(), cache_size);
+
+    optimize_vertex_cache(indices, vertices.size(), cache_size);
+    optimize_overdraw(indices, vertices, cache_size, overdraw_threshold);
+    optimize_vertex_fetch(vertices, indices);
+
+    return { before, analyze_vertex_cache(indices, vertices.size(), cache_size) };
+}
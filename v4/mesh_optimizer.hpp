@@ -0,0 +1,47 @@
+
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// efficiency of a triangle list on a FIFO post-transform cache
+struct VertexCacheStats {
+    // transformed vertices per triangle, 0.5 at best for a regular grid, 3 at worst
+    double acmr;
+    // transformed vertices per referenced vertex, 1 at best
+    double atvr;
+};
+
+[[nodiscard]]
+VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count, uint32_t cache_size);
+
+// Tipsify (Sander et al. 2007): fans around the most recently used vertex that stays in the cache,
+// dead ends resume from recently emitted vertices before falling back to input order
+void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count, uint32_t cache_size);
+
+// Splits the cache-ordered triangles into clusters wherever that costs less than threshold times the
+// ACMR of the clusters, then draws the clusters that face outwards first so they occlude the inner ones
+void optimize_overdraw(
+    std::span<uint32_t> indices,
+    std::span<const Vertex> vertices,
+    uint32_t cache_size,
+    float threshold
+);
+
+// renumbers vertices in order of first use and drops unreferenced ones
+void optimize_vertex_fetch(std::vector<Vertex> &vertices, std::span<uint32_t> indices);
+
+// all three stages above, in order, returns the vertex cache efficiency before and after
+std::pair<VertexCacheStats, VertexCacheStats> optimize_mesh(
+    std::vector<Vertex> &vertices,
+    std::vector<uint32_t> &indices,
+    uint32_t cache_size,
+    float overdraw_threshold
+);
+
+#endif /* MESH_OPTIMIZER_HPP */
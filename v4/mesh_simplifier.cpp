@@ -0,0 +1,316 @@
+
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// symmetric 4x4 matrix of the sum of squared distances to a set of planes, weighted by the area of
+// the triangles they came from
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double   cost;
+};
+
+static Quadric get_plane_quadric(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float     length = glm::length(normal);
+    if (length == 0.0f) {
+        return {};
+    }
+    normal /= length;
+
+    double x = normal.x;
+    double y = normal.y;
+    double z = normal.z;
+    double d = -glm::dot(normal, a);
+    double w = length * 0.5;
+
+    return {
+        w * x * x, w * x * y, w * x * z, w * y * y, w * y * z, w * z * z,
+        w * x * d, w * y * d, w * z * d,
+        w * d * d,
+        w,
+    };
+}
+
+static void add_quadric(Quadric &q, const Quadric &r)
+{
+    q.a00    += r.a00;
+    q.a01    += r.a01;
+    q.a02    += r.a02;
+    q.a11    += r.a11;
+    q.a12    += r.a12;
+    q.a22    += r.a22;
+    q.b0     += r.b0;
+    q.b1     += r.b1;
+    q.b2     += r.b2;
+    q.c      += r.c;
+    q.weight += r.weight;
+}
+
+// mean squared distance of p to the planes of q
+static double get_quadric_error(const Quadric &q, const glm::vec3 &p)
+{
+    double x = p.x;
+    double y = p.y;
+    double z = p.z;
+    double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+             + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+             + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z)
+             + q.c;
+
+    return q.weight > 0.0 ? std::abs(r) / q.weight : std::abs(r);
+}
+
+// vertices on an edge that is not shared by exactly two triangles
+static std::vector<bool> get_locked_vertices(std::span<const uint32_t> indices, size_t vertex_count)
+{
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+        for (size_t e = 0; e < 3; e++) {
+            uint32_t a = indices[i + e];
+            uint32_t b = indices[i + (e + 1) % 3];
+            edges.push_back(uint64_t(std::min(a, b)) << 32 | std::max(a, b));
+        }
+    }
+    std::ranges::sort(edges);
+
+    std::vector<bool> locked(vertex_count, false);
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i]) {
+            j++;
+        }
+        if (j - i != 2) {
+            locked[edges[i] >> 32]        = true;
+            locked[edges[i] & 0xffffffff] = true;
+        }
+        i = j;
+    }
+    return locked;
+}
+
+// whether moving from onto to turns a triangle around from over, triangles with both collapse away
+static bool has_triangle_flip(
+        std::span<const uint32_t> indices,
+        std::span<const uint32_t> triangles,
+        std::span<const glm::vec3> positions,
+        uint32_t from,
+        uint32_t to
+    )
+{
+    for (uint32_t triangle : triangles) {
+        const uint32_t *corners = &indices[triangle * 3];
+        if (corners[0] == to || corners[1] == to || corners[2] == to) {
+            continue;
+        }
+
+        size_t           k = corners[0] == from ? 0 : corners[1] == from ? 1 : 2;
+        const glm::vec3 &a = positions[corners[(k + 1) % 3]];
+        const glm::vec3 &b = positions[corners[(k + 2) % 3]];
+
+        glm::vec3 before = glm::cross(a - positions[from], b - positions[from]);
+        glm::vec3 after  = glm::cross(a - positions[to], b - positions[to]);
+        if (glm::dot(before, after) <= 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint32_t> simplify_mesh(
+        std::span<const uint32_t> indices,
+        std::span<const Vertex> vertices,
+        size_t target_index_count,
+        float &error
+    )
+{
+    size_t vertex_count = vertices.size();
+
+    // positions within the unit cube, quadrics of large coordinates lose their precision
+    glm::vec3 min(INFINITY);
+    glm::vec3 max(-INFINITY);
+    for (const Vertex &vertex : vertices) {
+        min = glm::min(min, vertex.pos);
+        max = glm::max(max, vertex.pos);
+    }
+    float extent = std::max({ max.x - min.x, max.y - min.y, max.z - min.z, 0.0f });
+    if (extent == 0.0f) {
+        extent = 1.0f;
+    }
+
+    std::vector<glm::vec3> positions(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++) {
+        positions[i] = (vertices[i].pos - min) / extent;
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+        if (indices[i] != indices[i + 1] && indices[i + 1] != indices[i + 2] && indices[i + 2] != indices[i]) {
+            result.insert(result.end(), indices.begin() + i, indices.begin() + i + 3);
+        }
+    }
+
+    std::vector<bool>    locked = get_locked_vertices(result, vertex_count);
+    std::vector<Quadric> quadrics(vertex_count, Quadric {});
+    for (size_t i = 0; i < result.size(); i += 3) {
+        Quadric plane = get_plane_quadric(positions[result[i]], positions[result[i + 1]], positions[result[i + 2]]);
+        for (size_t k = 0; k < 3; k++) {
+            add_quadric(quadrics[result[i + k]], plane);
+        }
+    }
+
+    std::vector<uint32_t> remap(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++) {
+        remap[i] = i;
+    }
+
+    std::vector<uint32_t> offsets(vertex_count + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> best(vertex_count);
+    std::vector<Collapse> collapses;
+    std::vector<bool>     touched(vertex_count);
+    double                max_cost = 0.0;
+
+    // every pass takes the cheapest collapses whose neighbourhoods do not overlap, so each one is
+    // checked against the triangles as they are at the start of the pass
+    while (result.size() > target_index_count) {
+        size_t triangle_count = result.size() / 3;
+
+        std::ranges::fill(offsets, 0);
+        for (uint32_t index : result) {
+            offsets[index + 1]++;
+        }
+        for (size_t i = 0; i < vertex_count; i++) {
+            offsets[i + 1] += offsets[i];
+        }
+        adjacency.resize(result.size());
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++) {
+            adjacency[cursor[result[i]]++] = i / 3;
+        }
+
+        std::ranges::fill(best, Collapse { 0, 0, INFINITY });
+        for (size_t i = 0; i < result.size(); i++) {
+            uint32_t from = result[i];
+            uint32_t to   = result[i - i % 3 + (i + 1) % 3];
+            for (size_t direction = 0; direction < 2; direction++) {
+                if (not locked[from]) {
+                    Quadric q = quadrics[from];
+                    add_quadric(q, quadrics[to]);
+                    double cost = get_quadric_error(q, positions[to]);
+                    if (cost < best[from].cost) {
+                        best[from] = { from, to, cost };
+                    }
+                }
+                std::swap(from, to);
+            }
+        }
+
+        collapses.clear();
+        for (const Collapse &collapse : best) {
+            if (collapse.cost != INFINITY) {
+                collapses.push_back(collapse);
+            }
+        }
+        std::ranges::sort(collapses, {}, &Collapse::cost);
+        // the expensive half waits for a pass where the cheap ones around it are done
+        collapses.resize(std::min(collapses.size(), collapses.size() / 2 + 1));
+
+        touched.assign(vertex_count, false);
+        size_t removed = 0;
+        size_t applied = 0;
+        for (const Collapse &collapse : collapses) {
+            if ((triangle_count - removed) * 3 <= target_index_count) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            std::span<const uint32_t> triangles(&adjacency[offsets[collapse.from]], &adjacency[offsets[collapse.from + 1]]);
+            if (has_triangle_flip(result, triangles, positions, collapse.from, collapse.to)) {
+                continue;
+            }
+
+            for (uint32_t triangle : triangles) {
+                const uint32_t *corners = &result[triangle * 3];
+                if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+                    removed++;
+                }
+                touched[corners[0]] = true;
+                touched[corners[1]] = true;
+                touched[corners[2]] = true;
+            }
+            touched[collapse.to] = true;
+
+            remap[collapse.from] = collapse.to;
+            add_quadric(quadrics[collapse.to], quadrics[collapse.from]);
+            max_cost = std::max(max_cost, collapse.cost);
+            applied++;
+        }
+        if (applied == 0) {
+            break;
+        }
+
+        size_t count = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i + 0]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+            if (a != b && b != c && c != a) {
+                result[count++] = a;
+                result[count++] = b;
+                result[count++] = c;
+            }
+        }
+        result.resize(count);
+    }
+
+    error = std::sqrt(max_cost) * extent;
+    return result;
+}
+
+std::vector<MeshLod> build_lod_chain(
+        std::vector<uint32_t> &indices,
+        std::span<const Vertex> vertices,
+        uint32_t max_lods,
+        float ratio
+    )
+{
+    std::vector<MeshLod> lods;
+    if (max_lods == 0) {
+        return lods;
+    }
+
+    size_t source_count = indices.size();
+    lods.push_back({ 0, uint32_t(source_count), 0.0f });
+
+    // every level starts over from LOD 0, so its error is measured against the original surface
+    float scale = 1.0f;
+    while (lods.size() < max_lods) {
+        scale *= ratio;
+
+        float                 error;
+        size_t                target = size_t(double(source_count / 3) * scale) * 3;
+        std::vector<uint32_t> lod    = simplify_mesh(std::span(indices).first(source_count), vertices, target, error);
+        if (lod.empty() || lod.size() * 10 > size_t(lods.back().index_count) * 9) {
+            break;
+        }
+
+        lods.push_back({ uint32_t(indices.size()), uint32_t(lod.size()), std::max(error, lods.back().error) });
+        indices.insert(indices.end(), lod.begin(), lod.end());
+    }
+    return lods;
+}
@@ -0,0 +1,44 @@
+
+#ifndef MESH_SIMPLIFIER_HPP
+#define MESH_SIMPLIFIER_HPP
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// range of one level of detail in an index buffer holding the whole chain, every LOD indexes the same
+// vertices
+struct MeshLod {
+    uint32_t first_index;
+    uint32_t index_count;
+    // in model units, root of the mean squared distance of the worst collapsed vertex to the planes of
+    // the LOD 0 triangles around it, 0 for LOD 0
+    float    error;
+};
+
+// Quadric error metric edge collapse (Garland & Heckbert 1997) restricted to collapsing a vertex onto
+// one of its neighbours, so the result indexes the vertices of the input and needs no vertex buffer of
+// its own. Vertices on a border of the indexed topology never move, which also keeps UV seams intact
+// as the welder splits vertices along them. Stops at target_index_count or when no collapse is left
+// that keeps every triangle facing the same way, error is set as in MeshLod
+[[nodiscard]]
+std::vector<uint32_t> simplify_mesh(
+    std::span<const uint32_t> indices,
+    std::span<const Vertex> vertices,
+    size_t target_index_count,
+    float &error
+);
+
+// Simplifies indices to ratio, ratio^2, ... of its triangles and appends every level to it. Returns
+// max_lods ranges at most, LOD 0 being the original indices, and stops early once a level keeps more
+// than 90% of the triangles of the one before
+std::vector<MeshLod> build_lod_chain(
+    std::vector<uint32_t> &indices,
+    std::span<const Vertex> vertices,
+    uint32_t max_lods,
+    float ratio
+);
+
+#endif /* MESH_SIMPLIFIER_HPP */
@@ -0,0 +1,124 @@
+
+#include "meshlet_builder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static Meshlet get_meshlet(
+        std::span<const uint32_t> indices,
+        std::span<const Vertex> vertices,
+        uint32_t first_index,
+        uint32_t index_count
+    )
+{
+    Meshlet meshlet = {};
+    meshlet.first_index = first_index;
+    meshlet.index_count = index_count;
+
+    std::span<const uint32_t> triangles = indices.subspan(first_index, index_count);
+
+    // sphere around the center of the box, cheap and within a few percent of the minimal one
+    glm::vec3 min(INFINITY);
+    glm::vec3 max(-INFINITY);
+    for (uint32_t index : triangles) {
+        min = glm::min(min, vertices[index].pos);
+        max = glm::max(max, vertices[index].pos);
+    }
+    glm::vec3 center = (min + max) * 0.5f;
+    float     radius = 0.0f;
+    for (uint32_t index : triangles) {
+        radius = std::max(radius, glm::length(vertices[index].pos - center));
+    }
+
+    // cone around the mean of the unit normals, degenerate triangles have no say in it
+    std::vector<glm::vec3> normals;
+    glm::vec3              axis(0.0f);
+    for (size_t i = 0; i + 3 <= triangles.size(); i += 3) {
+        const glm::vec3 &a = vertices[triangles[i + 0]].pos;
+        const glm::vec3 &b = vertices[triangles[i + 1]].pos;
+        const glm::vec3 &c = vertices[triangles[i + 2]].pos;
+
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float     length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+
+    float axis_length = glm::length(axis);
+    float min_dot = -1.0f;
+    if (axis_length > 0.0f) {
+        axis /= axis_length;
+        min_dot = 1.0f;
+        for (const glm::vec3 &normal : normals) {
+            min_dot = std::min(min_dot, glm::dot(axis, normal));
+        }
+    }
+
+    std::ranges::copy(std::span<const float>(&center.x, 3), meshlet.center);
+    meshlet.radius = radius;
+
+    // a cone wider than ~84 degrees from the axis would almost never be culled
+    if (min_dot <= 0.1f) {
+        meshlet.cone_cutoff = 1.0f;
+    } else {
+        std::ranges::copy(std::span<const float>(&axis.x, 3), meshlet.cone_axis);
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+
+    return meshlet;
+}
+
+std::vector<Meshlet> build_meshlets(
+        std::span<const uint32_t> indices,
+        std::span<const Vertex> vertices,
+        uint32_t max_vertices,
+        uint32_t max_triangles
+    )
+{
+    if (max_vertices < 3 || max_triangles < 1) {
+        throw std::runtime_error("meshlet needs room for at least one triangle");
+    }
+
+    // meshlet a vertex was last counted for, plus one so zero means never
+    std::vector<uint32_t> owner(vertices.size(), 0);
+    std::vector<Meshlet>  meshlets;
+    uint32_t              first = 0;
+    uint32_t              vertex_count = 0;
+    uint32_t              triangle_count = 0;
+    size_t                index_count = indices.size() / 3 * 3;
+
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        uint32_t id = meshlets.size() + 1;
+        uint32_t a  = indices[i + 0];
+        uint32_t b  = indices[i + 1];
+        uint32_t c  = indices[i + 2];
+
+        // a repeated vertex of a degenerate triangle counts once
+        uint32_t added = (owner[a] != id) + (owner[b] != id && b != a) + (owner[c] != id && c != a && c != b);
+
+        if (vertex_count + added > max_vertices || triangle_count == max_triangles) {
+            meshlets.push_back(get_meshlet(indices, vertices, first, i - first));
+            first = i;
+            vertex_count = 0;
+            triangle_count = 0;
+            id++;
+        }
+
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t index = indices[i + k];
+            if (owner[index] != id) {
+                owner[index] = id;
+                vertex_count++;
+            }
+        }
+        triangle_count++;
+    }
+
+    if (triangle_count > 0) {
+        meshlets.push_back(get_meshlet(indices, vertices, first, index_count - first));
+    }
+    return meshlets;
+}
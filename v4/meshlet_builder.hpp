@@ -0,0 +1,37 @@
+
+#ifndef MESHLET_BUILDER_HPP
+#define MESHLET_BUILDER_HPP
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Run of consecutive triangles in the index buffer with the bounds cull_main tests it by, layout matches
+// the MESHLET_SIZE records read in shader.slang
+struct Meshlet {
+    // bounding sphere
+    float    center[3];
+    float    radius;
+    // every triangle faces away from the camera when dot(center - camera, cone_axis) is at least
+    // cone_cutoff * |center - camera| + radius, cone_cutoff 1 never passes
+    float    cone_axis[3];
+    float    cone_cutoff;
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t padding[2];
+};
+
+// Greedy scan of the triangle list, a meshlet ends when the next triangle would take it past
+// max_vertices unique vertices or max_triangles triangles. Triangle order is kept, so an index buffer
+// already optimized for the vertex cache gives compact meshlets and needs no reordering
+[[nodiscard]]
+std::vector<Meshlet> build_meshlets(
+    std::span<const uint32_t> indices,
+    std::span<const Vertex> vertices,
+    uint32_t max_vertices,
+    uint32_t max_triangles
+);
+
+#endif /* MESHLET_BUILDER_HPP */
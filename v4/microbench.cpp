@@ -0,0 +1,650 @@
+
+#include "bc7_encoder.hpp"
+#include "config.h"
+#include "engine.hpp"
+#include "image_decoder.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "microbench.hpp"
+#include "mip_generator.hpp"
+#include "obj_parser.hpp"
+#include "scene.hpp"
+#include "vertex_welder.hpp"
+
+#include <stb_image.h>
+
+// only the benchmarks use tinyobj now, as the reference for parse_obj
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+// Synthetic assets of scalable size, written to the temp directory on first use and reused after.
+// A grid OBJ shares every inner vertex between six triangles like a real mesh, a PNG is stored
+// (uncompressed deflate) so its size is predictable and decoding still goes through all of stb_image.
+static std::string get_asset_path(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("microbench_" + name)).string();
+}
+
+static void write_synthetic_obj(const std::string &fname, uint32_t grid)
+{
+    std::ofstream f(fname);
+
+    for (uint32_t y = 0; y <= grid; y++) {
+        for (uint32_t x = 0; x <= grid; x++) {
+            float u = static_cast<float>(x) / grid;
+            float v = static_cast<float>(y) / grid;
+            f << "v " << u << ' ' << v << ' ' << u * v << '\n'
+              << "vt " << u << ' ' << v << '\n';
+        }
+    }
+
+    // OBJ indices are 1-based
+    for (uint32_t y = 0; y < grid; y++) {
+        for (uint32_t x = 0; x < grid; x++) {
+            uint32_t a = y * (grid + 1) + x + 1;
+            uint32_t b = a + 1;
+            uint32_t c = a + grid + 1;
+            uint32_t d = c + 1;
+            f << "f " << a << '/' << a << ' ' << b << '/' << b << ' ' << d << '/' << d << '\n'
+              << "f " << a << '/' << a << ' ' << d << '/' << d << ' ' << c << '/' << c << '\n';
+        }
+    }
+
+    if (f.fail()) {
+        throw std::runtime_error("failed to write file: " + fname);
+    }
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t.at(i) = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.at((crc ^ data[i]) & 0xff) ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_u32(std::vector<uint8_t> &out, uint32_t value)
+{
+    out.insert(out.end(), {
+        static_cast<uint8_t>(value >> 24),
+        static_cast<uint8_t>(value >> 16),
+        static_cast<uint8_t>(value >> 8),
+        static_cast<uint8_t>(value),
+    });
+}
+
+static void put_chunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+{
+    put_u32(out, data.size());
+
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+
+    put_u32(out, crc32(out.data() + start, out.size() - start));
+}
+
+static void write_synthetic_png(const std::string &fname, uint32_t size)
+{
+    // RGBA scanlines, each prefixed with filter type 0
+    std::vector<uint8_t> raw;
+    raw.reserve((size * 4 + 1) * size);
+    for (uint32_t y = 0; y < size; y++) {
+        raw.push_back(0);
+        for (uint32_t x = 0; x < size; x++) {
+            raw.insert(raw.end(), {
+                static_cast<uint8_t>(x),
+                static_cast<uint8_t>(y),
+                static_cast<uint8_t>(x ^ y),
+                255,
+            });
+        }
+    }
+
+    // zlib stream of stored deflate blocks
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    for (size_t pos = 0; pos < raw.size(); pos += 65535) {
+        uint16_t len  = std::min<size_t>(65535, raw.size() - pos);
+        bool     last = pos + len == raw.size();
+
+        zlib.insert(zlib.end(), {
+            static_cast<uint8_t>(last),
+            static_cast<uint8_t>(len),
+            static_cast<uint8_t>(len >> 8),
+            static_cast<uint8_t>(~len),
+            static_cast<uint8_t>(~len >> 8),
+        });
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+    }
+    for (uint8_t byte : raw) {
+        adler_a = (adler_a + byte) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+    put_u32(zlib, adler_b << 16 | adler_a);
+
+    std::vector<uint8_t> header;
+    put_u32(header, size);
+    put_u32(header, size);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib);
+    put_chunk(png, "IEND", {});
+
+    std::ofstream f(fname, std::ios::binary);
+    f.write(reinterpret_cast<const char *>(png.data()), png.size());
+    if (f.fail()) {
+        throw std::runtime_error("failed to write file: " + fname);
+    }
+}
+
+static std::string get_synthetic_obj(uint32_t grid)
+{
+    std::string fname = get_asset_path("grid_" + std::to_string(grid) + ".obj");
+    if (not std::filesystem::exists(fname)) {
+        write_synthetic_obj(fname, grid);
+    }
+    return fname;
+}
+
+// arg 0 is the model the engine loads, so the parsers are compared on real data too
+static std::optional<std::string> get_obj_path(State &state)
+{
+    if (state.arg() != 0) {
+        return get_synthetic_obj(state.arg());
+    }
+    if (not std::filesystem::exists(CONFIG_MODEL_PATH)) {
+        state.skip("no model at " CONFIG_MODEL_PATH);
+        return std::nullopt;
+    }
+    return CONFIG_MODEL_PATH;
+}
+
+static std::string get_synthetic_png(uint32_t size)
+{
+    std::string fname = get_asset_path("texture_" + std::to_string(size) + ".png");
+    if (not std::filesystem::exists(fname)) {
+        write_synthetic_png(fname, size);
+    }
+    return fname;
+}
+
+// instance and physical devices shared by the Vulkan benchmarks, none when there is no driver
+struct VulkanFixture {
+    vk::raii::Context                     context;
+    vk::raii::Instance                    instance = nullptr;
+    std::vector<vk::raii::PhysicalDevice> physical_devices;
+
+    static VulkanFixture *get(void)
+    {
+        static std::optional<VulkanFixture> fixture;
+        static bool                         tried = false;
+
+        if (not tried) {
+            tried = true;
+            try {
+                fixture.emplace();
+                vk::ApplicationInfo    app_info("microbench", 1, "No engine", 1, vk::ApiVersion13);
+                vk::InstanceCreateInfo create_info({}, &app_info);
+                fixture->instance = vk::raii::Instance(fixture->context, create_info);
+                fixture->physical_devices = fixture->instance.enumeratePhysicalDevices();
+            } catch (const std::exception &e) {
+                std::cout << "no Vulkan instance: " << e.what() << '\n';
+                fixture.reset();
+            }
+        }
+
+        if (not fixture || fixture->physical_devices.empty()) {
+            return nullptr;
+        }
+        return &*fixture;
+    }
+};
+
+struct MicroBench {
+    // started on first use, the thread running the benchmarks is its main thread
+    static JobSystem &get_jobs(void)
+    {
+        static JobSystem jobs;
+        static bool      started = false;
+
+        if (not started) {
+            jobs.start(CONFIG_WORKER_THREADS);
+            started = true;
+        }
+        return jobs;
+    }
+
+    static void vertex_hash(State &state)
+    {
+        std::vector<Vertex> vertices(state.arg());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            float f = static_cast<float>(i);
+            vertices.at(i) = { { f, f * 0.5f, f * 0.25f }, { f / vertices.size(), 1.0f - f / vertices.size() } };
+        }
+
+        std::hash<Vertex> hash;
+        while (state.keep_running()) {
+            size_t acc = 0;
+            for (const Vertex &vertex : vertices) {
+                acc += hash(vertex);
+            }
+            do_not_optimize(acc);
+        }
+        state.set_items_processed(vertices.size());
+    }
+
+    // corners of a grid's triangles, every inner vertex is shared by six of them
+    static std::vector<Vertex> get_grid_corners(uint32_t grid)
+    {
+        static constexpr std::array<std::pair<uint32_t, uint32_t>, 6> quad = {{
+            { 0, 0 }, { 1, 0 }, { 1, 1 },
+            { 0, 0 }, { 1, 1 }, { 0, 1 },
+        }};
+
+        std::vector<Vertex> corners;
+        for (uint32_t y = 0; y < grid; y++) {
+            for (uint32_t x = 0; x < grid; x++) {
+                for (auto [dx, dy] : quad) {
+                    float u = static_cast<float>(x + dx) / grid;
+                    float v = static_cast<float>(y + dy) / grid;
+                    corners.push_back({ { u, v, u * v }, { u, v } });
+                }
+            }
+        }
+        return corners;
+    }
+
+    // the deduplication load_obj used before VertexWelder, node map with the XOR of the field bits
+    static void vertex_dedup(State &state)
+    {
+        struct XorHash {
+            size_t operator()(const Vertex &vertex) const
+            {
+                return std::bit_cast<uint32_t>(vertex.pos.x) ^
+                       std::bit_cast<uint32_t>(vertex.pos.y) ^
+                       std::bit_cast<uint32_t>(vertex.pos.z) ^
+                       std::bit_cast<uint32_t>(vertex.tex_coord.x) ^
+                       std::bit_cast<uint32_t>(vertex.tex_coord.y);
+            }
+        };
+
+        std::vector<Vertex> corners = get_grid_corners(state.arg());
+
+        while (state.keep_running()) {
+            std::unordered_map<Vertex, uint32_t, XorHash> uniq_vertices;
+            std::vector<Vertex>                           vertices;
+            std::vector<uint32_t>                         indices;
+            for (const Vertex &vertex : corners) {
+                auto [it, inserted] = uniq_vertices.insert({ vertex, vertices.size() });
+                if (inserted) {
+                    vertices.push_back(vertex);
+                }
+                indices.push_back(it->second);
+            }
+            do_not_optimize(indices.data());
+        }
+        state.set_items_processed(corners.size());
+    }
+
+    static void vertex_weld(State &state)
+    {
+        std::vector<Vertex> corners = get_grid_corners(state.arg());
+
+        while (state.keep_running()) {
+            std::vector<Vertex>   vertices;
+            std::vector<uint32_t> indices;
+            VertexWelder::weld(corners, nullptr, vertices, indices);
+            do_not_optimize(indices.data());
+        }
+        state.set_items_processed(corners.size());
+    }
+
+    static void vertex_weld_parallel(State &state)
+    {
+        std::vector<Vertex> corners = get_grid_corners(state.arg());
+
+        while (state.keep_running()) {
+            std::vector<Vertex>   vertices;
+            std::vector<uint32_t> indices;
+            VertexWelder::weld(corners, &get_jobs(), vertices, indices);
+            do_not_optimize(indices.data());
+        }
+        state.set_items_processed(corners.size());
+    }
+
+    // what create_vertex_buffer does per vertex with CONFIG_VERTEX_QUANTIZE
+    static void vertex_pack(State &state)
+    {
+        std::vector<Vertex>       vertices = get_grid_corners(state.arg());
+        std::vector<PackedVertex> packed(vertices.size());
+        MeshCache::Bounds         bounds = MeshCache::compute_bounds(vertices);
+        glm::vec3                 inv_extent = 1.0f / (bounds.max - bounds.min);
+
+        while (state.keep_running()) {
+            for (size_t i = 0; i < vertices.size(); i++) {
+                packed[i] = pack_vertex(vertices[i], bounds.min, inv_extent);
+            }
+            do_not_optimize(packed.data());
+        }
+        state.set_items_processed(vertices.size());
+        state.set_bytes_processed(vertices.size() * sizeof(Vertex));
+    }
+
+    // all optimize_mesh stages on a welded grid, the copies it works on are not timed
+    static void mesh_optimize(State &state)
+    {
+        std::vector<Vertex>   grid_vertices;
+        std::vector<uint32_t> grid_indices;
+        VertexWelder::weld(get_grid_corners(state.arg()), nullptr, grid_vertices, grid_indices);
+
+        while (state.keep_running()) {
+            state.pause_timing();
+            std::vector<Vertex>   vertices = grid_vertices;
+            std::vector<uint32_t> indices  = grid_indices;
+            state.resume_timing();
+
+            auto stats = optimize_mesh(
+                vertices,
+                indices,
+                CONFIG_MESH_OPTIMIZE_CACHE_SIZE,
+                CONFIG_MESH_OPTIMIZE_OVERDRAW_THRESHOLD
+            );
+            do_not_optimize(stats);
+        }
+        state.set_items_processed(grid_indices.size() / 3);
+    }
+
+    // what load_model adds for CONFIG_GPU_CULLING, on the welded grid
+    static void meshlet_build(State &state)
+    {
+        std::vector<Vertex>   vertices;
+        std::vector<uint32_t> indices;
+        VertexWelder::weld(get_grid_corners(state.arg()), nullptr, vertices, indices);
+
+        while (state.keep_running()) {
+            std::vector<Meshlet> meshlets = build_meshlets(
+                indices,
+                vertices,
+                CONFIG_MESHLET_MAX_VERTICES,
+                CONFIG_MESHLET_MAX_TRIANGLES
+            );
+            do_not_optimize(meshlets.data());
+        }
+        state.set_items_processed(indices.size() / 3);
+    }
+
+    // LOD chain load_model builds before saving the mesh cache, the copy it appends to is not timed
+    static void lod_chain(State &state)
+    {
+        std::vector<Vertex>   vertices;
+        std::vector<uint32_t> grid_indices;
+        VertexWelder::weld(get_grid_corners(state.arg()), nullptr, vertices, grid_indices);
+
+        while (state.keep_running()) {
+            state.pause_timing();
+            std::vector<uint32_t> indices = grid_indices;
+            state.resume_timing();
+
+            std::vector<MeshLod> lods = build_lod_chain(indices, vertices, CONFIG_LOD_COUNT, CONFIG_LOD_RATIO);
+            do_not_optimize(lods.data());
+        }
+        state.set_items_processed(grid_indices.size() / 3);
+    }
+
+    // instance transforms of bench.elf --instances, uploaded once so it is only startup cost
+    static void scene_generate(State &state)
+    {
+        while (state.keep_running()) {
+            std::vector<glm::mat4> instances = generate_scene(state.arg(), 1.0f, CONFIG_SCENE_SEED);
+            do_not_optimize(instances.data());
+        }
+        state.set_items_processed(state.arg());
+    }
+
+    // parse and deduplication, what load_model spends its time on
+    static void load_obj(State &state)
+    {
+        std::optional<std::string> fname = get_obj_path(state);
+        if (not fname) {
+            return;
+        }
+
+        while (state.keep_running()) {
+            std::vector<Vertex>   vertices;
+            std::vector<uint32_t> indices;
+            Engine::load_obj(*fname, get_jobs(), vertices, indices);
+            do_not_optimize(indices.data());
+        }
+        state.set_bytes_processed(std::filesystem::file_size(*fname));
+    }
+
+    static void parse_obj(State &state)
+    {
+        std::optional<std::string> fname = get_obj_path(state);
+        if (not fname) {
+            return;
+        }
+
+        while (state.keep_running()) {
+            ObjMesh mesh = ::parse_obj(*fname, get_jobs());
+            do_not_optimize(mesh.corners.data());
+        }
+        state.set_bytes_processed(std::filesystem::file_size(*fname));
+    }
+
+    static void parse_obj_tinyobj(State &state)
+    {
+        std::optional<std::string> fname = get_obj_path(state);
+        if (not fname) {
+            return;
+        }
+
+        while (state.keep_running()) {
+            tinyobj::attrib_t                attrib;
+            std::vector<tinyobj::shape_t>    shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string                      warn, err;
+
+            if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, fname->c_str())) {
+                throw std::runtime_error(warn + err);
+            }
+            do_not_optimize(shapes.data());
+        }
+        state.set_bytes_processed(std::filesystem::file_size(*fname));
+    }
+
+    static void read_file(State &state)
+    {
+        std::string fname = get_synthetic_png(state.arg());
+
+        while (state.keep_running()) {
+            std::vector<char> data = Engine::read_file(fname);
+            do_not_optimize(data.data());
+        }
+        state.set_bytes_processed(std::filesystem::file_size(fname));
+    }
+
+    // decode path of the texture job, the raw pixels are what the decoder has to produce
+    static void decode_png(State &state)
+    {
+        std::string fname = get_synthetic_png(state.arg());
+
+        while (state.keep_running()) {
+            int width, height, channels;
+            stbi_uc *pixels = stbi_load(fname.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            if (pixels == nullptr) {
+                throw std::runtime_error("failed to decode " + fname);
+            }
+            do_not_optimize(pixels);
+            stbi_image_free(pixels);
+        }
+        state.set_bytes_processed(state.arg() * state.arg() * 4);
+    }
+
+    // arg textures at once, what a scene of many materials would load, against one at a time
+    static void decode_png_parallel(State &state)
+    {
+        std::vector<std::string> fnames(state.arg(), get_synthetic_png(1024));
+
+        while (state.keep_running()) {
+            std::vector<DecodedImage> images = decode_images(fnames, get_jobs());
+            do_not_optimize(images.data());
+        }
+        state.set_bytes_processed(state.arg() * 1024 * 1024 * 4);
+    }
+
+    static void decode_png_serial(State &state)
+    {
+        std::string fname = get_synthetic_png(1024);
+
+        while (state.keep_running()) {
+            for (int64_t i = 0; i < state.arg(); i++) {
+                int width, height, channels;
+                stbi_uc *pixels = stbi_load(fname.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+                if (pixels == nullptr) {
+                    throw std::runtime_error("failed to decode " + fname);
+                }
+                do_not_optimize(pixels);
+                stbi_image_free(pixels);
+            }
+        }
+        state.set_bytes_processed(state.arg() * 1024 * 1024 * 4);
+    }
+
+    // CPU mip chain of the synthetic texture, against the blits of generate_mipmaps
+    template <MipFilter filter>
+    static void mip_generate(State &state)
+    {
+        std::vector<DecodedImage> images = decode_images(std::array<std::string, 1>{ get_synthetic_png(state.arg()) }, get_jobs());
+
+        while (state.keep_running()) {
+            std::vector<std::vector<uint8_t>> levels = generate_mips(
+                images[0].pixels.get(),
+                images[0].width,
+                images[0].height,
+                filter,
+                get_jobs()
+            );
+            do_not_optimize(levels.data());
+        }
+        state.set_bytes_processed(state.arg() * state.arg() * 4);
+    }
+
+    // per level work of bake.elf, the synthetic texture's gradients and XOR pattern make for mixed blocks
+    static void bc7_encode(State &state)
+    {
+        std::string fname = get_synthetic_png(state.arg());
+
+        int width, height, channels;
+        stbi_uc *pixels = stbi_load(fname.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr) {
+            throw std::runtime_error("failed to decode " + fname);
+        }
+        std::vector<uint8_t> image(pixels, pixels + size_t(width) * height * 4);
+        stbi_image_free(pixels);
+
+        while (state.keep_running()) {
+            std::vector<uint8_t> blocks = encode_bc7(image.data(), width, height, get_jobs());
+            do_not_optimize(blocks.data());
+        }
+        state.set_bytes_processed(image.size());
+    }
+
+    static void find_memory_type(State &state)
+    {
+        VulkanFixture *vulkan = VulkanFixture::get();
+        if (vulkan == nullptr) {
+            state.skip("no Vulkan physical device");
+            return;
+        }
+
+        const vk::raii::PhysicalDevice &pd = vulkan->physical_devices.front();
+        while (state.keep_running()) {
+            uint32_t type = Engine::find_memory_type(
+                pd,
+                UINT32_MAX,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+            );
+            do_not_optimize(type);
+        }
+    }
+
+    static void physical_device_score(State &state)
+    {
+        VulkanFixture *vulkan = VulkanFixture::get();
+        if (vulkan == nullptr) {
+            state.skip("no Vulkan physical device");
+            return;
+        }
+
+        while (state.keep_running()) {
+            for (const vk::raii::PhysicalDevice &pd : vulkan->physical_devices) {
+                int score = Engine::get_physical_device_score(pd);
+                do_not_optimize(score);
+            }
+        }
+        state.set_items_processed(vulkan->physical_devices.size());
+    }
+};
+
+BENCHMARK(MicroBench::vertex_hash)->arg(1 << 10)->arg(1 << 16);
+BENCHMARK(MicroBench::vertex_dedup)->arg(64)->arg(512);
+BENCHMARK(MicroBench::vertex_weld)->arg(64)->arg(512);
+BENCHMARK(MicroBench::vertex_weld_parallel)->arg(64)->arg(512);
+BENCHMARK(MicroBench::vertex_pack)->arg(512);
+BENCHMARK(MicroBench::mesh_optimize)->arg(64)->arg(512);
+BENCHMARK(MicroBench::meshlet_build)->arg(512);
+BENCHMARK(MicroBench::lod_chain)->arg(256);
+BENCHMARK(MicroBench::scene_generate)->arg(100000);
+BENCHMARK(MicroBench::load_obj)->arg(0)->arg(64)->arg(512);
+BENCHMARK(MicroBench::parse_obj)->arg(0)->arg(64)->arg(512)->arg(1024);
+BENCHMARK(MicroBench::parse_obj_tinyobj)->arg(0)->arg(64)->arg(512)->arg(1024);
+BENCHMARK(MicroBench::read_file)->arg(256)->arg(2048);
+BENCHMARK(MicroBench::decode_png)->arg(256)->arg(2048);
+BENCHMARK(MicroBench::decode_png_parallel)->arg(8);
+BENCHMARK(MicroBench::decode_png_serial)->arg(8);
+BENCHMARK(MicroBench::mip_generate<MipFilter::Box>)->arg(2048);
+BENCHMARK(MicroBench::mip_generate<MipFilter::Kaiser>)->arg(2048);
+BENCHMARK(MicroBench::bc7_encode)->arg(256);
+BENCHMARK(MicroBench::find_memory_type);
+BENCHMARK(MicroBench::physical_device_score);
+
+int main(int argc, char **argv)
+{
+    // writes the synthetic assets for use outside the suite, e.g. as a bigger model for the engine
+    if (argc == 4 && std::string(argv[1]) == "--generate-obj") {
+        write_synthetic_obj(argv[3], std::stoul(argv[2]));
+        return EXIT_SUCCESS;
+    }
+    if (argc == 4 && std::string(argv[1]) == "--generate-png") {
+        write_synthetic_png(argv[3], std::stoul(argv[2]));
+        return EXIT_SUCCESS;
+    }
+
+    return run_benchmarks(argc, argv);
+}
@@ -0,0 +1,317 @@
+
+#include "mip_generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIP_GENERATOR_X86 1
+#else
+#define MIP_GENERATOR_X86 0
+#endif
+
+static constexpr float KAISER_WIDTH = 3.0f;
+static constexpr float KAISER_ALPHA = 4.0f;
+
+// smaller levels are not worth a job per band
+static constexpr size_t MIN_BAND_TEXELS = 16384;
+
+// linear to sRGB by table lookup, at this size the darkest step is 0.2 of an 8 bit value
+static constexpr uint32_t TO_SRGB_SIZE = 16384;
+
+// source texels and weights of every texel of one axis of the smaller level, the same number for
+// all of them so the kernels need no bounds. Indices past the edge are clamped to it
+struct Taps {
+    uint32_t              count = 0;
+    std::vector<uint32_t> index;
+    std::vector<float>    weight;
+};
+
+static float srgb_to_linear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static const std::array<float, 256> &get_to_linear(void)
+{
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> table;
+        for (size_t i = 0; i < table.size(); i++) {
+            table[i] = srgb_to_linear(i / 255.0f);
+        }
+        return table;
+    }();
+    return table;
+}
+
+static const std::vector<uint8_t> &get_to_srgb(void)
+{
+    static const std::vector<uint8_t> table = []() {
+        std::vector<uint8_t> table(TO_SRGB_SIZE);
+        for (size_t i = 0; i < table.size(); i++) {
+            table[i] = std::lround(linear_to_srgb(float(i) / (TO_SRGB_SIZE - 1)) * 255.0f);
+        }
+        return table;
+    }();
+    return table;
+}
+
+// modified Bessel function of the first kind, the series converges quickly for the alphas used
+static float bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (uint32_t k = 1; k < 32 && term > sum * 1e-7f; k++) {
+        term *= (x * x) / (4.0f * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// t in texels of the smaller level
+static float kaiser(float t)
+{
+    if (std::abs(t) >= KAISER_WIDTH) {
+        return 0.0f;
+    }
+
+    float x = std::numbers::pi_v<float> * t;
+    float sinc = t == 0.0f ? 1.0f : std::sin(x) / x;
+    float r = t / KAISER_WIDTH;
+    return sinc * bessel_i0(KAISER_ALPHA * std::sqrt(1.0f - r * r)) / bessel_i0(KAISER_ALPHA);
+}
+
+// An odd size has the texels of the smaller level cover a bit more than 2 source texels, the box
+// then weights the ones it covers partially by how much of them it does
+static Taps get_taps(uint32_t src_size, uint32_t dst_size, MipFilter filter)
+{
+    float scale = float(src_size) / dst_size;
+    float radius = (filter == MipFilter::Box ? 0.5f : KAISER_WIDTH) * scale;
+
+    auto get_first = [&](uint32_t i) { return int64_t(std::floor((i + 0.5f) * scale - radius)); };
+    auto get_end = [&](uint32_t i) { return int64_t(std::ceil((i + 0.5f) * scale + radius)); };
+
+    Taps taps;
+    for (uint32_t i = 0; i < dst_size; i++) {
+        taps.count = std::max<uint32_t>(taps.count, get_end(i) - get_first(i));
+    }
+    taps.index.resize(size_t(dst_size) * taps.count);
+    taps.weight.resize(size_t(dst_size) * taps.count);
+
+    for (uint32_t i = 0; i < dst_size; i++) {
+        float    center = (i + 0.5f) * scale;
+        int64_t  first = get_first(i);
+        uint32_t *index = &taps.index[size_t(i) * taps.count];
+        float    *weight = &taps.weight[size_t(i) * taps.count];
+        float    sum = 0.0f;
+
+        for (uint32_t k = 0; k < taps.count; k++) {
+            int64_t s = first + k;
+            switch (filter) {
+            case MipFilter::Box:
+                weight[k] = std::max(0.0f, std::min(s + 1.0f, center + radius) - std::max(float(s), center - radius));
+                break;
+            case MipFilter::Kaiser:
+                weight[k] = kaiser((s + 0.5f - center) / scale);
+                break;
+            }
+            index[k] = std::clamp<int64_t>(s, 0, src_size - 1);
+            sum += weight[k];
+        }
+        for (uint32_t k = 0; k < taps.count; k++) {
+            weight[k] /= sum;
+        }
+    }
+    return taps;
+}
+
+// dst = sum of weights[k] * rows[k], n floats
+static void filter_rows(const float *const *rows, const float *weights, uint32_t count, float *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        float sum = 0.0f;
+        for (uint32_t k = 0; k < count; k++) {
+            sum += weights[k] * rows[k][i];
+        }
+        dst[i] = sum;
+    }
+}
+
+// dst texel x = sum of its weights * the RGBA texels of src its indices name
+static void filter_columns(const float *src, const Taps &taps, float *dst, uint32_t dst_width)
+{
+    for (uint32_t x = 0; x < dst_width; x++) {
+        const uint32_t *index = &taps.index[size_t(x) * taps.count];
+        const float    *weight = &taps.weight[size_t(x) * taps.count];
+        float          sum[4] = {};
+
+        for (uint32_t k = 0; k < taps.count; k++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                sum[c] += weight[k] * src[index[k] * 4 + c];
+            }
+        }
+        std::copy_n(sum, 4, &dst[x * 4]);
+    }
+}
+
+#if MIP_GENERATOR_X86
+// 8 floats, two RGBA texels, at a time
+__attribute__((target("avx2,fma")))
+static void filter_rows_avx2(const float *const *rows, const float *weights, uint32_t count, float *dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (uint32_t k = 0; k < count; k++) {
+            sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i), sum);
+        }
+        _mm256_storeu_ps(dst + i, sum);
+    }
+    for (; i < n; i++) {
+        float sum = 0.0f;
+        for (uint32_t k = 0; k < count; k++) {
+            sum += weights[k] * rows[k][i];
+        }
+        dst[i] = sum;
+    }
+}
+
+// two texels of the smaller level at a time, one in each 128 bit lane
+__attribute__((target("avx2,fma")))
+static void filter_columns_avx2(const float *src, const Taps &taps, float *dst, uint32_t dst_width)
+{
+    uint32_t x = 0;
+    for (; x + 2 <= dst_width; x += 2) {
+        const uint32_t *index = &taps.index[size_t(x) * taps.count];
+        const float    *weight = &taps.weight[size_t(x) * taps.count];
+        __m256         sum = _mm256_setzero_ps();
+
+        for (uint32_t k = 0; k < taps.count; k++) {
+            __m256 texels = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(_mm_loadu_ps(&src[index[k] * 4])),
+                _mm_loadu_ps(&src[index[taps.count + k] * 4]),
+                1
+            );
+            __m256 w = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(_mm_set1_ps(weight[k])),
+                _mm_set1_ps(weight[taps.count + k]),
+                1
+            );
+            sum = _mm256_fmadd_ps(w, texels, sum);
+        }
+        _mm256_storeu_ps(&dst[x * 4], sum);
+    }
+
+    if (x < dst_width) {
+        Taps last;
+        last.count = taps.count;
+        last.index.assign(taps.index.begin() + size_t(x) * taps.count, taps.index.end());
+        last.weight.assign(taps.weight.begin() + size_t(x) * taps.count, taps.weight.end());
+        filter_columns(src, last, &dst[x * 4], 1);
+    }
+}
+
+static bool has_avx2(void)
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return avx2;
+}
+#endif
+
+// about equal bands of rows, more than threads so a slow one doesn't hold up the level
+static size_t get_band_count(uint32_t width, uint32_t height, JobSystem &jobs)
+{
+    size_t bands = std::min<size_t>(size_t(width) * height / MIN_BAND_TEXELS, jobs.thread_count() * 4);
+    return std::clamp<size_t>(bands, 1, height);
+}
+
+static void to_srgb(const float *src, uint8_t *dst, size_t texels)
+{
+    const std::vector<uint8_t> &table = get_to_srgb();
+
+    for (size_t i = 0; i < texels * 4; i += 4) {
+        for (uint32_t c = 0; c < 3; c++) {
+            dst[i + c] = table[std::lround(std::clamp(src[i + c], 0.0f, 1.0f) * (TO_SRGB_SIZE - 1))];
+        }
+        dst[i + 3] = std::lround(std::clamp(src[i + 3], 0.0f, 1.0f) * 255.0f);
+    }
+}
+
+std::vector<std::vector<uint8_t>> generate_mips(
+        const uint8_t *rgba,
+        uint32_t width,
+        uint32_t height,
+        MipFilter filter,
+        JobSystem &jobs
+    )
+{
+    const std::array<float, 256> &to_linear = get_to_linear();
+
+#if MIP_GENERATOR_X86
+    bool avx2 = has_avx2();
+    auto rows_kernel = avx2 ? filter_rows_avx2 : filter_rows;
+    auto columns_kernel = avx2 ? filter_columns_avx2 : filter_columns;
+#else
+    auto rows_kernel = filter_rows;
+    auto columns_kernel = filter_columns;
+#endif
+
+    std::vector<std::vector<uint8_t>> levels;
+    levels.emplace_back(rgba, rgba + size_t(width) * height * 4);
+
+    std::vector<float> src(size_t(width) * height * 4);
+    size_t             bands = get_band_count(width, height, jobs);
+    jobs.parallel_for(bands, [&](size_t band) {
+        size_t end = src.size() * (band + 1) / bands / 4 * 4;
+        for (size_t i = src.size() * band / bands / 4 * 4; i < end; i += 4) {
+            src[i + 0] = to_linear[rgba[i + 0]];
+            src[i + 1] = to_linear[rgba[i + 1]];
+            src[i + 2] = to_linear[rgba[i + 2]];
+            src[i + 3] = rgba[i + 3] / 255.0f;
+        }
+    });
+
+    std::vector<float> dst;
+    while (width > 1 || height > 1) {
+        uint32_t dst_width = std::max(width / 2, 1u);
+        uint32_t dst_height = std::max(height / 2, 1u);
+        Taps     x_taps = get_taps(width, dst_width, filter);
+        Taps     y_taps = get_taps(height, dst_height, filter);
+
+        dst.resize(size_t(dst_width) * dst_height * 4);
+        std::vector<uint8_t> &level = levels.emplace_back(dst.size());
+
+        // each band filters its rows vertically into a row of the source width, then horizontally
+        bands = get_band_count(dst_width, dst_height, jobs);
+        jobs.parallel_for(bands, [&](size_t band) {
+            std::vector<float>         row(size_t(width) * 4);
+            std::vector<const float *> rows(y_taps.count);
+
+            uint32_t end = dst_height * (band + 1) / bands;
+            for (uint32_t y = dst_height * band / bands; y < end; y++) {
+                for (uint32_t k = 0; k < y_taps.count; k++) {
+                    rows[k] = &src[size_t(y_taps.index[size_t(y) * y_taps.count + k]) * width * 4];
+                }
+                rows_kernel(rows.data(), &y_taps.weight[size_t(y) * y_taps.count], y_taps.count, row.data(), row.size());
+
+                size_t offset = size_t(y) * dst_width * 4;
+                columns_kernel(row.data(), x_taps, &dst[offset], dst_width);
+                to_srgb(&dst[offset], &level[offset], dst_width);
+            }
+        });
+
+        std::swap(src, dst);
+        width = dst_width;
+        height = dst_height;
+    }
+
+    return levels;
+}
@@ -0,0 +1,29 @@
+
+#ifndef MIP_GENERATOR_HPP
+#define MIP_GENERATOR_HPP
+
+#include "job_system.hpp"
+
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter {
+    // average of the texels each one covers, what a blit chain approximates
+    Box,
+    // Kaiser windowed sinc over 6 texels of the smaller level, sharper but may ring at hard edges
+    Kaiser,
+};
+
+// Full mip chain of an sRGB RGBA8 image down to 1x1, level 0 is a copy of rgba. Color is filtered in
+// linear light and every level is computed from the unquantized one before, alpha is kept linear.
+// Separable, rows of each level are split across jobs and the kernels use AVX2 when the CPU has it
+[[nodiscard]]
+std::vector<std::vector<uint8_t>> generate_mips(
+    const uint8_t *rgba,
+    uint32_t width,
+    uint32_t height,
+    MipFilter filter,
+    JobSystem &jobs
+);
+
+#endif /* MIP_GENERATOR_HPP */
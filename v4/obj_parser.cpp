@@ -0,0 +1,259 @@
+
+#include "mapped_file.hpp"
+#include "obj_parser.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+using namespace std::string_literals;
+
+// smaller chunks cost more in scheduling than they gain in parallelism
+static constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+struct FaceCorner {
+    ObjMesh::Corner corner;
+    // negative in the file, the index is still relative to the start of the chunk
+    bool            relative_position;
+    bool            relative_tex_coord;
+};
+
+struct Chunk {
+    std::string_view        text;
+    ObjMesh                 mesh;
+    // corners whose position or tex_coord index was relative, they still lack the base of the chunk
+    std::vector<size_t>     relative_positions;
+    std::vector<size_t>     relative_tex_coords;
+    // corners of the face being parsed, before triangulation
+    std::vector<FaceCorner> face;
+};
+
+[[noreturn]]
+static void parse_error(std::string_view line)
+{
+    throw std::runtime_error("malformed OBJ line: "s + std::string(line.substr(0, 80)));
+}
+
+static const char *skip_space(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static const char *parse_float(const char *p, const char *end, float &value, std::string_view line)
+{
+    p = skip_space(p, end);
+    // from_chars does not take the plus sign
+    if (p < end && *p == '+') {
+        p++;
+    }
+
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc()) {
+        parse_error(line);
+    }
+    return ptr;
+}
+
+// turns a 1-based OBJ index into a 0-based one, a negative one counts back from the end of the chunk
+static int32_t resolve_index(int64_t index, size_t count, bool &relative, std::string_view line)
+{
+    relative = index < 0;
+    if (index > 0 && index <= INT32_MAX) {
+        return index - 1;
+    }
+    if (index < 0 && index >= -INT32_MAX) {
+        return static_cast<int64_t>(count) + index;
+    }
+    parse_error(line);
+}
+
+static void parse_index(const char *&p, const char *end, int64_t &index, std::string_view line)
+{
+    auto [ptr, ec] = std::from_chars(p, end, index);
+    if (ec != std::errc()) {
+        parse_error(line);
+    }
+    p = ptr;
+}
+
+static void emit_corner(Chunk &chunk, size_t face_corner)
+{
+    const FaceCorner &corner = chunk.face.at(face_corner);
+
+    if (corner.relative_position) {
+        chunk.relative_positions.push_back(chunk.mesh.corners.size());
+    }
+    if (corner.relative_tex_coord) {
+        chunk.relative_tex_coords.push_back(chunk.mesh.corners.size());
+    }
+    chunk.mesh.corners.push_back(corner.corner);
+}
+
+static void parse_face(const char *p, const char *end, Chunk &chunk, std::string_view line)
+{
+    size_t position_count  = chunk.mesh.positions.size() / 3;
+    size_t tex_coord_count = chunk.mesh.tex_coords.size() / 2;
+
+    chunk.face.clear();
+
+    // v, v/vt, v//vn or v/vt/vn
+    for (p = skip_space(p, end); p < end; p = skip_space(p, end)) {
+        FaceCorner face_corner = { { 0, -1 }, false, false };
+        int64_t    index;
+
+        parse_index(p, end, index, line);
+        face_corner.corner.position = resolve_index(index, position_count, face_corner.relative_position, line);
+
+        if (p < end && *p == '/') {
+            p++;
+            if (p < end && *p != '/') {
+                parse_index(p, end, index, line);
+                face_corner.corner.tex_coord = resolve_index(index, tex_coord_count, face_corner.relative_tex_coord, line);
+            }
+            // normal index is not used
+            if (p < end && *p == '/') {
+                p++;
+                parse_index(p, end, index, line);
+            }
+        }
+        if (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+            parse_error(line);
+        }
+
+        chunk.face.push_back(face_corner);
+    }
+
+    if (chunk.face.size() < 3) {
+        parse_error(line);
+    }
+
+    for (size_t i = 2; i < chunk.face.size(); i++) {
+        emit_corner(chunk, 0);
+        emit_corner(chunk, i - 1);
+        emit_corner(chunk, i);
+    }
+}
+
+static void parse_line(std::string_view line, Chunk &chunk)
+{
+    const char *p   = skip_space(line.data(), line.data() + line.size());
+    const char *end = line.data() + line.size();
+
+    if (end - p < 2 || *p == '#') {
+        return;
+    }
+
+    if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+        float x, y, z;
+        p = parse_float(p + 2, end, x, line);
+        p = parse_float(p, end, y, line);
+        parse_float(p, end, z, line);
+        chunk.mesh.positions.insert(chunk.mesh.positions.end(), { x, y, z });
+    } else if (p[0] == 'v' && p[1] == 't' && end - p > 2 && (p[2] == ' ' || p[2] == '\t')) {
+        // v is optional and defaults to 0
+        float u, v = 0.0f;
+        p = parse_float(p + 3, end, u, line);
+        if (skip_space(p, end) < end) {
+            parse_float(p, end, v, line);
+        }
+        chunk.mesh.tex_coords.insert(chunk.mesh.tex_coords.end(), { u, v });
+    } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+        parse_face(p + 2, end, chunk, line);
+    }
+    // vn, o, g, s, usemtl and mtllib are not used
+}
+
+static void parse_chunk(Chunk &chunk)
+{
+    std::string_view text = chunk.text;
+
+    while (not text.empty()) {
+        size_t eol = text.find('\n');
+        if (eol == std::string_view::npos) {
+            eol = text.size();
+        }
+
+        parse_line(text.substr(0, eol), chunk);
+        text.remove_prefix(std::min(eol + 1, text.size()));
+    }
+}
+
+// offsets of the chunk in the merged arrays, counted in elements
+struct ChunkBase {
+    size_t positions;
+    size_t tex_coords;
+    size_t corners;
+};
+
+ObjMesh parse_obj(const std::string &fname, JobSystem &jobs)
+{
+    // every chunk is read front to back exactly once
+    MappedFile       file(fname, true);
+    std::string_view text = file.get();
+
+    size_t chunk_count = std::clamp<size_t>(text.size() / MIN_CHUNK_SIZE, 1, jobs.thread_count() * 4);
+    std::vector<Chunk> chunks(chunk_count);
+
+    // a chunk ends after the first newline past its share of the file
+    size_t begin = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        size_t end = text.size();
+        if (i + 1 < chunk_count) {
+            end = text.find('\n', std::max(begin, text.size() * (i + 1) / chunk_count));
+            end = end == std::string_view::npos ? text.size() : end + 1;
+        }
+        chunks.at(i).text = text.substr(begin, end - begin);
+        begin = end;
+    }
+
+    jobs.parallel_for(chunk_count, [&chunks](size_t i) { parse_chunk(chunks.at(i)); });
+
+    std::vector<ChunkBase> bases(chunk_count);
+    ChunkBase              total = { 0, 0, 0 };
+    for (size_t i = 0; i < chunk_count; i++) {
+        bases.at(i) = total;
+        total.positions  += chunks.at(i).mesh.positions.size();
+        total.tex_coords += chunks.at(i).mesh.tex_coords.size();
+        total.corners    += chunks.at(i).mesh.corners.size();
+    }
+
+    ObjMesh mesh;
+    mesh.positions.resize(total.positions);
+    mesh.tex_coords.resize(total.tex_coords);
+    mesh.corners.resize(total.corners);
+
+    int32_t position_count  = total.positions / 3;
+    int32_t tex_coord_count = total.tex_coords / 2;
+
+    // chunks are copied to their place in parallel, the copy is as big as the parsed data
+    jobs.parallel_for(chunk_count, [&](size_t i) {
+        Chunk           &chunk = chunks.at(i);
+        const ChunkBase &base  = bases.at(i);
+
+        for (size_t corner : chunk.relative_positions) {
+            chunk.mesh.corners.at(corner).position += base.positions / 3;
+        }
+        for (size_t corner : chunk.relative_tex_coords) {
+            chunk.mesh.corners.at(corner).tex_coord += base.tex_coords / 2;
+        }
+
+        for (const ObjMesh::Corner &corner : chunk.mesh.corners) {
+            if (corner.position < 0 || corner.position >= position_count ||
+                corner.tex_coord < -1 || corner.tex_coord >= tex_coord_count) {
+                throw std::runtime_error("OBJ index out of range in " + fname);
+            }
+        }
+
+        std::ranges::copy(chunk.mesh.positions, mesh.positions.begin() + base.positions);
+        std::ranges::copy(chunk.mesh.tex_coords, mesh.tex_coords.begin() + base.tex_coords);
+        std::ranges::copy(chunk.mesh.corners, mesh.corners.begin() + base.corners);
+
+        chunk.mesh = ObjMesh();
+    });
+
+    return mesh;
+}
@@ -0,0 +1,32 @@
+
+#ifndef OBJ_PARSER_HPP
+#define OBJ_PARSER_HPP
+
+#include "job_system.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Geometry of a Wavefront OBJ file. Faces are triangulated as fans into corners indexing the attribute
+// arrays, a corner without texture coordinates has tex_coord -1. Normals, groups and materials are
+// skipped, the engine uses none of them.
+struct ObjMesh {
+    struct Corner {
+        int32_t position;
+        int32_t tex_coord;
+    };
+
+    // x, y, z per position and u, v per texture coordinate
+    std::vector<float>  positions;
+    std::vector<float>  tex_coords;
+    std::vector<Corner> corners;
+};
+
+// Memory-maps the file, splits it at line boundaries and parses the chunks as jobs, then merges them
+// in file order. Relative (negative) indices are resolved during the merge, when the attribute counts
+// of the preceding chunks are known. Throws on malformed lines and out of range indices.
+[[nodiscard]]
+ObjMesh parse_obj(const std::string &fname, JobSystem &jobs);
+
+#endif /* OBJ_PARSER_HPP */
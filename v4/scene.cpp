@@ -0,0 +1,35 @@
+
+#include "scene.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <random>
+
+std::vector<glm::mat4> generate_scene(uint32_t count, float radius, uint32_t seed)
+{
+    std::mt19937                          rng(seed);
+    std::uniform_real_distribution<float> scale(0.75f, 1.25f);
+    std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+    std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+
+    // neighbours at the largest scale and offset stay apart as long as the mesh is centered on its origin
+    uint32_t side    = std::ceil(std::sqrt(static_cast<double>(count)));
+    float    spacing = radius * 2.0f * (1.25f + 0.4f);
+    float    origin  = (side - 1) * spacing * 0.5f;
+
+    std::vector<glm::mat4> instances;
+    instances.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        // one random draw per statement, argument evaluation order would make the scene compiler dependent
+        float x = i % side + jitter(rng);
+        float y = i / side + jitter(rng);
+        float a = angle(rng);
+        float s = scale(rng);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x * spacing - origin, y * spacing - origin, 0.0f));
+        model = glm::rotate(model, a, glm::vec3(0.0f, 0.0f, 1.0f));
+        instances.push_back(glm::scale(model, glm::vec3(s)));
+    }
+    return instances;
+}
@@ -0,0 +1,17 @@
+
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Benchmark scene of count copies of a mesh with the given bounding radius: a square grid in the z = 0
+// plane centered on the origin, each copy with a random scale, turn about z and offset within its cell.
+// The same seed gives the same scene on every run
+[[nodiscard]]
+std::vector<glm::mat4> generate_scene(uint32_t count, float radius, uint32_t seed);
+
+#endif /* SCENE_HPP */
@@ -0,0 +1,157 @@
+
+#include "startup_profiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+StartupProfiler::Scope::Scope(StartupProfiler &profiler, const char *name)
+    : profiler(profiler)
+    , phase_idx(profiler.phases.size())
+    , start(std::chrono::steady_clock::now())
+{
+    profiler.phases.push_back({ name, 0, 0 });
+    profiler.open_phase = this->phase_idx;
+}
+
+StartupProfiler::Scope::~Scope()
+{
+    auto end = std::chrono::steady_clock::now();
+
+    this->profiler.phases.at(this->phase_idx).cpu_ms =
+        std::chrono::duration<double, std::milli>(end - this->start).count();
+    this->profiler.open_phase = SIZE_MAX;
+}
+
+void StartupProfiler::start(void)
+{
+    this->phases.clear();
+    this->open_phase = SIZE_MAX;
+    this->start_time = std::chrono::steady_clock::now();
+}
+
+StartupProfiler::Scope StartupProfiler::scope(const char *name)
+{
+    return Scope(*this, name);
+}
+
+void StartupProfiler::add_gpu_time(double ms)
+{
+    if (this->open_phase != SIZE_MAX) {
+        this->phases.at(this->open_phase).gpu_ms += ms;
+    }
+}
+
+double StartupProfiler::total_ms(void) const
+{
+    auto now = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(now - this->start_time).count();
+}
+
+const std::vector<StartupProfiler::Phase> &StartupProfiler::get_phases(void) const
+{
+    return this->phases;
+}
+
+void StartupProfiler::print(std::ostream &os) const
+{
+    std::vector<Phase> sorted = this->phases;
+    double             sum    = 0;
+
+    std::ranges::sort(sorted, std::greater {}, &Phase::cpu_ms);
+    for (const Phase &phase : sorted) {
+        sum += phase.cpu_ms;
+    }
+
+    os << "Startup profile (" << std::fixed << std::setprecision(3) << sum << " ms in phases):\n";
+    for (const Phase &phase : sorted) {
+        os << '\t' << std::setw(10) << phase.cpu_ms << " ms"
+           << std::setw(7) << std::setprecision(1) << (sum > 0 ? phase.cpu_ms / sum * 100 : 0) << "%  "
+           << std::setprecision(3) << phase.name;
+        if (phase.gpu_ms > 0) {
+            os << " (gpu " << phase.gpu_ms << " ms)";
+        }
+        os << '\n';
+    }
+    os << std::defaultfloat;
+}
+
+void StartupProfiler::write_json(const std::string &fname) const
+{
+    std::ofstream f(fname, std::ios::trunc);
+
+    if (!f.is_open()) {
+        throw std::runtime_error("failed to open file: " + fname);
+    }
+
+    f << "{\n";
+    f << "    \"total_ms\": " << total_ms() << ",\n";
+    f << "    \"phases\": [\n";
+    for (size_t i = 0; i < this->phases.size(); i++) {
+        const Phase &phase = this->phases.at(i);
+
+        f << "        { \"name\": \"" << phase.name << "\", "
+          << "\"cpu_ms\": " << phase.cpu_ms << ", "
+          << "\"gpu_ms\": " << phase.gpu_ms << " }"
+          << (i + 1 == this->phases.size() ? "\n" : ",\n");
+    }
+    f << "    ]\n";
+    f << "}\n";
+}
+
+std::vector<StartupProfiler::Phase> StartupProfiler::read_json(const std::string &fname)
+{
+    // only needs to understand files produced by write_json()
+    static const std::regex phase_re(
+        R"re(\{\s*"name":\s*"([^"]*)",\s*"cpu_ms":\s*([-+.0-9eE]+),\s*"gpu_ms":\s*([-+.0-9eE]+)\s*\})re"
+    );
+
+    std::ifstream      f(fname);
+    std::stringstream  ss;
+    std::vector<Phase> phases;
+
+    if (!f.is_open()) {
+        return phases;
+    }
+    ss << f.rdbuf();
+
+    std::string content = ss.str();
+    for (auto it = std::sregex_iterator(content.begin(), content.end(), phase_re);
+         it != std::sregex_iterator();
+         ++it) {
+        phases.push_back({ (*it)[1], std::stod((*it)[2]), std::stod((*it)[3]) });
+    }
+
+    return phases;
+}
+
+size_t StartupProfiler::check_regressions(
+        const std::string &baseline_fname,
+        double threshold_pct,
+        double min_delta_ms,
+        std::ostream &os
+    ) const
+{
+    std::vector<Phase> baseline = read_json(baseline_fname);
+    size_t             count    = 0;
+
+    for (const Phase &phase : this->phases) {
+        auto it = std::ranges::find(baseline, phase.name, &Phase::name);
+        if (it == baseline.end()) {
+            continue;
+        }
+
+        double delta = phase.cpu_ms - it->cpu_ms;
+        if (delta > min_delta_ms && delta > it->cpu_ms * threshold_pct / 100) {
+            os << "startup regression: " << phase.name << ' ' << it->cpu_ms << " ms -> "
+               << phase.cpu_ms << " ms\n";
+            count++;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,71 @@
+
+#ifndef STARTUP_PROFILER_HPP
+#define STARTUP_PROFILER_HPP
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class StartupProfiler {
+public:
+    struct Phase {
+        std::string name;
+        double      cpu_ms = 0;
+        double      gpu_ms = 0;
+    };
+
+    // times everything between construction and destruction as one phase
+    class Scope {
+    public:
+        Scope(StartupProfiler &profiler, const char *name);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator =(const Scope &) = delete;
+
+    private:
+        StartupProfiler                       &profiler;
+        size_t                                phase_idx;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void start(void);
+
+    [[nodiscard]]
+    Scope scope(const char *name);
+
+    // attributes GPU time to the phase that is currently open (if any)
+    void add_gpu_time(double ms);
+
+    [[nodiscard]]
+    double total_ms(void) const;
+
+    [[nodiscard]]
+    const std::vector<Phase> &get_phases(void) const;
+
+    // prints phases sorted from the most expensive one
+    void print(std::ostream &os) const;
+
+    void write_json(const std::string &fname) const;
+
+    // compares against json written by write_json() on a previous run. Phase is flagged when it got slower
+    // than baseline by more than threshold_pct percent and by more than min_delta_ms (to filter out noise
+    // of the tiny phases). Returns number of flagged phases, missing baseline file is not a regression
+    size_t check_regressions(
+        const std::string &baseline_fname,
+        double threshold_pct,
+        double min_delta_ms,
+        std::ostream &os
+    ) const;
+
+private:
+    [[nodiscard]]
+    static std::vector<Phase> read_json(const std::string &fname);
+
+    std::vector<Phase>                    phases;
+    size_t                                open_phase = SIZE_MAX;
+    std::chrono::steady_clock::time_point start_time;
+};
+
+#endif /* STARTUP_PROFILER_HPP */
@@ -0,0 +1,122 @@
+
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+Tracer::Zone::Zone(Tracer &tracer, const char *name)
+    : tracer(tracer)
+    , name(name)
+    , start_ns(tracer.enabled() ? now_ns() : 0)
+{}
+
+Tracer::Zone::~Zone()
+{
+    if (this->tracer.enabled()) {
+        this->tracer.add_cpu_event(this->name, this->start_ns, now_ns());
+    }
+}
+
+Tracer::~Tracer()
+{
+    try {
+        close();
+    } catch (const std::exception &e) {
+        std::cerr << "failed to write trace: " << e.what() << '\n';
+    }
+}
+
+void Tracer::open(const std::string &fname, size_t max_events)
+{
+    std::lock_guard lock(this->mutex);
+
+    this->fname = fname;
+    this->max_events = max_events;
+    this->events.clear();
+    this->events.reserve(std::min<size_t>(max_events, 1 << 16));
+    this->is_enabled = not fname.empty();
+}
+
+void Tracer::close(void)
+{
+    std::lock_guard lock(this->mutex);
+
+    if (not this->is_enabled) {
+        return;
+    }
+    this->is_enabled = false;
+
+    std::ofstream f(this->fname, std::ios::trunc);
+    if (!f.is_open()) {
+        throw std::runtime_error("failed to open file: " + this->fname);
+    }
+
+    int64_t origin = INT64_MAX;
+    for (const Event &event : this->events) {
+        origin = std::min(origin, event.start_ns);
+    }
+
+    f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    f << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    f << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (const Event &event : this->events) {
+        bool gpu = event.track == GPU_TRACK;
+
+        f << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\""
+          << ",\"pid\":" << (gpu ? 2 : 1)
+          << ",\"tid\":" << (gpu ? 0 : event.track)
+          << ",\"ts\":" << (event.start_ns - origin) / 1e3
+          << ",\"dur\":" << (event.end_ns - event.start_ns) / 1e3 << '}';
+    }
+    f << "\n]}\n";
+
+    this->events.clear();
+    this->events.shrink_to_fit();
+}
+
+bool Tracer::enabled(void) const
+{
+    return this->is_enabled;
+}
+
+Tracer::Zone Tracer::zone(const char *name)
+{
+    return Zone(*this, name);
+}
+
+void Tracer::add_cpu_event(const char *name, int64_t start_ns, int64_t end_ns)
+{
+    add_event(name, start_ns, end_ns, thread_track());
+}
+
+void Tracer::add_gpu_event(const char *name, int64_t start_ns, int64_t end_ns)
+{
+    add_event(name, start_ns, end_ns, GPU_TRACK);
+}
+
+int64_t Tracer::now_ns(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+void Tracer::add_event(const char *name, int64_t start_ns, int64_t end_ns, uint32_t track)
+{
+    std::lock_guard lock(this->mutex);
+
+    // stop recording instead of growing without bound on long sessions
+    if (this->is_enabled && this->events.size() < this->max_events) {
+        this->events.push_back({ name, start_ns, end_ns, track });
+    }
+}
+
+uint32_t Tracer::thread_track(void)
+{
+    static std::atomic<uint32_t> next_track = 0;
+    thread_local uint32_t        track      = next_track++;
+
+    return track;
+}
@@ -0,0 +1,71 @@
+
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Collects CPU zones and GPU passes on one timeline and writes them as Chrome Trace Event JSON,
+// which opens in chrome://tracing and ui.perfetto.dev. All timestamps are nanoseconds of
+// std::chrono::steady_clock (CLOCK_MONOTONIC), GPU times have to be converted before adding.
+class Tracer {
+public:
+    static constexpr uint32_t GPU_TRACK = UINT32_MAX;
+
+    class Zone {
+    public:
+        Zone(Tracer &tracer, const char *name);
+        ~Zone();
+
+        Zone(const Zone &) = delete;
+        Zone &operator =(const Zone &) = delete;
+
+    private:
+        Tracer      &tracer;
+        const char  *name;
+        int64_t     start_ns;
+    };
+
+    ~Tracer();
+
+    // starts recording, events are written to the file on close() or destruction
+    void open(const std::string &fname, size_t max_events);
+    void close(void);
+
+    [[nodiscard]]
+    bool enabled(void) const;
+
+    [[nodiscard]]
+    Zone zone(const char *name);
+
+    void add_cpu_event(const char *name, int64_t start_ns, int64_t end_ns);
+    void add_gpu_event(const char *name, int64_t start_ns, int64_t end_ns);
+
+    [[nodiscard]]
+    static int64_t now_ns(void);
+
+private:
+    struct Event {
+        const char *name;
+        int64_t     start_ns;
+        int64_t     end_ns;
+        uint32_t    track;
+    };
+
+    void add_event(const char *name, int64_t start_ns, int64_t end_ns, uint32_t track);
+
+    [[nodiscard]]
+    static uint32_t thread_track(void);
+
+    std::mutex         mutex;
+    std::vector<Event> events;
+    std::string        fname;
+    size_t             max_events = 0;
+    std::atomic<bool>  is_enabled = false;
+};
+
+#endif /* TRACER_HPP */
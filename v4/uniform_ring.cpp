@@ -0,0 +1,83 @@
+
+#include "uniform_ring.hpp"
+#include "engine.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std::string_literals;
+
+UniformRing::~UniformRing()
+{
+    if (this->mapped != nullptr) {
+        this->memory.unmapMemory();
+    }
+}
+
+void UniformRing::init(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        MemoryTracker &tracker,
+        vk::MemoryPropertyFlags properties,
+        vk::DeviceSize frame_size,
+        uint32_t frames
+    )
+{
+    vk::PhysicalDeviceProperties props = pd.getProperties();
+
+    this->alignment = std::max<vk::DeviceSize>(props.limits.minUniformBufferOffsetAlignment, 1);
+    this->frame_size = (frame_size + this->alignment - 1) / this->alignment * this->alignment;
+
+    vk::BufferCreateInfo buffer_info(
+        {},
+        this->frame_size * frames,
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::SharingMode::eExclusive
+    );
+    this->buffer = vk::raii::Buffer(dev, buffer_info);
+
+    vk::MemoryRequirements mem_req = this->buffer.getMemoryRequirements();
+    uint32_t               type_index = Engine::find_memory_type(pd, mem_req.memoryTypeBits, properties);
+
+    tracker.check_budget(type_index, mem_req.size);
+    this->memory = TrackedMemory(
+        vk::raii::DeviceMemory(dev, vk::MemoryAllocateInfo(mem_req.size, type_index)),
+        tracker,
+        MemoryCategory::Uniform,
+        type_index,
+        mem_req.size
+    );
+    this->buffer.bindMemory(*this->memory, 0);
+
+    // stays mapped until destruction, coherent memory needs no flushes
+    this->mapped = static_cast<uint8_t *>(this->memory.mapMemory(0, vk::WholeSize));
+
+    begin_frame(0);
+}
+
+void UniformRing::begin_frame(uint32_t frame)
+{
+    this->begin = this->frame_size * frame;
+    this->head = this->begin;
+}
+
+UniformRing::Allocation UniformRing::allocate(vk::DeviceSize size)
+{
+    vk::DeviceSize offset = this->head;
+
+    if (offset + size > this->begin + this->frame_size) {
+        throw std::runtime_error(
+            "uniform ring frame slot of "s + std::to_string(this->frame_size) + " bytes is full"
+        );
+    }
+
+    this->head = (offset + size + this->alignment - 1) / this->alignment * this->alignment;
+
+    return { this->mapped + offset, static_cast<uint32_t>(offset) };
+}
+
+const vk::raii::Buffer &UniformRing::get_buffer(void) const
+{
+    return this->buffer;
+}
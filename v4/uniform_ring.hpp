@@ -0,0 +1,64 @@
+
+#ifndef UNIFORM_RING_HPP
+#define UNIFORM_RING_HPP
+
+#include "memory_tracker.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+#include <cstring>
+
+// Linear allocator for per-frame uniform data. One persistently mapped host-coherent buffer is split
+// into a slot per frame in flight, allocations bump a pointer inside the slot of the current frame and
+// are bound through a single UNIFORM_BUFFER_DYNAMIC descriptor with the returned offset.
+class UniformRing {
+public:
+    struct Allocation {
+        void     *data;
+        uint32_t offset;
+    };
+
+    ~UniformRing();
+
+    // properties must include HostVisible and HostCoherent, the ring is written without flushes
+    void init(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        MemoryTracker &tracker,
+        vk::MemoryPropertyFlags properties,
+        vk::DeviceSize frame_size,
+        uint32_t frames
+    );
+
+    // rewinds the slot of frame, the GPU must be done reading what was allocated in it before
+    void begin_frame(uint32_t frame);
+
+    // offset is aligned for use as a dynamic offset, throws when the frame slot is full
+    [[nodiscard]]
+    Allocation allocate(vk::DeviceSize size);
+
+    template <typename T>
+    [[nodiscard]]
+    uint32_t push(const T &value)
+    {
+        Allocation allocation = allocate(sizeof(T));
+        memcpy(allocation.data, &value, sizeof(T));
+        return allocation.offset;
+    }
+
+    [[nodiscard]]
+    const vk::raii::Buffer &get_buffer(void) const;
+
+private:
+    vk::raii::Buffer       buffer     = nullptr;
+    TrackedMemory          memory     = nullptr;
+    uint8_t                *mapped    = nullptr;
+
+    vk::DeviceSize         alignment  = 1;
+    vk::DeviceSize         frame_size = 0;
+    vk::DeviceSize         begin      = 0;
+    vk::DeviceSize         head       = 0;
+};
+
+#endif /* UNIFORM_RING_HPP */
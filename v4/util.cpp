@@ -1,9 +1,13 @@
 
 #include "config.h"
 #include "engine.hpp"
+#include "obj_parser.hpp"
+#include "vertex_welder.hpp"
 
 #include "vulkan/vulkan.hpp"
 #include "vulkan/vulkan_raii.hpp"
+
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -203,9 +207,12 @@ void Engine::copy_buffer(
         vk::DeviceSize size
     )
 {
+    auto zone = this->tracer.zone("copy_buffer");
     vk::raii::CommandBuffer cb = begin_single_time_commands(this->command_pool);
 
+    uint32_t pass = this->gpu_profiler.begin_pass(cb, "upload");
     cb.copyBuffer(*src, *dst, vk::BufferCopy(0, 0, size));
+    this->gpu_profiler.end_pass(cb, pass);
 
     end_single_time_commands(std::move(cb));
 }
@@ -226,6 +233,8 @@ vk::raii::CommandBuffer Engine::begin_single_time_commands(
     vk::CommandBufferBeginInfo begin_info(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     cb.front().begin(begin_info);
 
+    this->gpu_profiler.begin_frame(cb.front());
+
     return std::move(cb.front());
 }
 
@@ -233,6 +242,8 @@ void Engine::end_single_time_commands(
         vk::raii::CommandBuffer &&cb
     )
 {
+    auto zone = this->tracer.zone("upload_submit_wait");
+
     cb.end();
 
     vk::SubmitInfo submit_info(
@@ -243,16 +254,20 @@ void Engine::end_single_time_commands(
 
     queue.submit(submit_info);
     queue.waitIdle();
+
+    // queue is idle - results are ready and can be attributed to the current startup phase
+    this->startup_profiler.add_gpu_time(this->gpu_profiler.collect());
 }
 
-std::pair<vk::raii::Image, vk::raii::DeviceMemory> Engine::create_image(
+std::pair<vk::raii::Image, TrackedMemory> Engine::create_image(
         uint32_t width,
         uint32_t height,
         vk::Format format,
         uint32_t mip_levels,
         vk::SampleCountFlagBits num_samples,
         vk::ImageUsageFlags usage,
-        vk::MemoryPropertyFlags properties
+        vk::MemoryPropertyFlags properties,
+        MemoryCategory category
     )
 {
     vk::ImageCreateInfo image_info(
@@ -282,11 +297,15 @@ std::pair<vk::raii::Image, vk::raii::DeviceMemory> Engine::create_image(
 
     vk::MemoryAllocateInfo alloc_info(mem_req.size, type_index);
 
+    this->memory_tracker.check_budget(type_index, mem_req.size);
     vk::raii::DeviceMemory mem(this->device, alloc_info);
 
     image.bindMemory(mem, 0);
 
-    return { std::move(image), std::move(mem) };
+    return {
+        std::move(image),
+        TrackedMemory(std::move(mem), this->memory_tracker, category, type_index, mem_req.size),
+    };
 }
 
 vk::raii::ImageView Engine::create_image_view(
@@ -314,10 +333,11 @@ vk::raii::ImageView Engine::create_image_view(
     return vk::raii::ImageView(this->device, image_view_info);
 }
 
-std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> Engine::create_buffer(
+std::pair<vk::raii::Buffer, TrackedMemory> Engine::create_buffer(
         vk::DeviceSize size,
         vk::BufferUsageFlags usage,
-        vk::MemoryPropertyFlags properties
+        vk::MemoryPropertyFlags properties,
+        MemoryCategory category
     )
 {
     vk::BufferCreateInfo buffer_info(
@@ -337,11 +357,35 @@ std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> Engine::create_buffer(
     );
 
     vk::MemoryAllocateInfo alloc_info(mem_req.size, type_index);
+    this->memory_tracker.check_budget(type_index, mem_req.size);
     vk::raii::DeviceMemory mem(this->device, alloc_info);
 
     buffer.bindMemory(*mem, 0);
 
-    return { std::move(buffer), std::move(mem) };
+    return {
+        std::move(buffer),
+        TrackedMemory(std::move(mem), this->memory_tracker, category, type_index, mem_req.size),
+    };
+}
+
+// Gribb-Hartmann: combinations of the rows of clip, the near plane is z >= 0 as Vulkan clips depth
+// to [0, w]. Normalized so the distance of a point can be compared with a sphere radius
+std::array<glm::vec4, 6> Engine::get_frustum_planes(const glm::mat4 &clip)
+{
+    glm::mat4 rows = glm::transpose(clip);
+
+    std::array<glm::vec4, 6> planes = {
+        rows[3] + rows[0],
+        rows[3] - rows[0],
+        rows[3] + rows[1],
+        rows[3] - rows[1],
+        rows[2],
+        rows[3] - rows[2],
+    };
+    for (glm::vec4 &plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
 }
 
 uint32_t Engine::find_memory_type(
@@ -517,6 +561,7 @@ int Engine::get_physical_device_score(const vk::raii::PhysicalDevice &pd)
 
     auto features = pd.template getFeatures2<vk::PhysicalDeviceFeatures2,
                                              vk::PhysicalDeviceVulkan11Features,
+                                             vk::PhysicalDeviceVulkan12Features,
                                              vk::PhysicalDeviceVulkan13Features,
                                              vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
 
@@ -526,7 +571,17 @@ int Engine::get_physical_device_score(const vk::raii::PhysicalDevice &pd)
 
     bool has_all_features =
         features.template get<vk::PhysicalDeviceFeatures2>().features.samplerAnisotropy &&
+        features.template get<vk::PhysicalDeviceFeatures2>().features.sampleRateShading &&
+        features.template get<vk::PhysicalDeviceFeatures2>().features.shaderSampledImageArrayDynamicIndexing &&
+        features.template get<vk::PhysicalDeviceFeatures2>().features.shaderStorageBufferArrayDynamicIndexing &&
+        // SV_InstanceID and the other draw parameters of the scene and meshlet paths
         features.template get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters &&
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorIndexing &&
+        features.template get<vk::PhysicalDeviceVulkan12Features>().runtimeDescriptorArray &&
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingPartiallyBound &&
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingSampledImageUpdateAfterBind &&
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingStorageBufferUpdateAfterBind &&
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingUpdateUnusedWhilePending &&
         features.template get<vk::PhysicalDeviceVulkan13Features>().synchronization2 &&
         features.template get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering &&
         features.template get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
@@ -574,6 +629,66 @@ std::vector<const char *> Engine::get_required_device_extensions(void)
     };
 }
 
+bool Engine::supports_calibrated_timestamps(const vk::raii::PhysicalDevice &pd)
+{
+    std::vector<vk::ExtensionProperties> supp_extensions = pd.enumerateDeviceExtensionProperties();
+
+    if (std::ranges::none_of(supp_extensions,
+                             [](const vk::ExtensionProperties &supp_ext) {
+                                 return strcmp(supp_ext.extensionName, vk::KHRCalibratedTimestampsExtensionName) == 0;
+                             })) {
+        return false;
+    }
+
+    // trace timeline is steady_clock, which is CLOCK_MONOTONIC
+    std::vector<vk::TimeDomainKHR> domains = pd.getCalibrateableTimeDomainsKHR();
+    return std::ranges::contains(domains, vk::TimeDomainKHR::eDevice) &&
+           std::ranges::contains(domains, vk::TimeDomainKHR::eClockMonotonic);
+}
+
+bool Engine::supports_memory_budget(const vk::raii::PhysicalDevice &pd)
+{
+    std::vector<vk::ExtensionProperties> supp_extensions = pd.enumerateDeviceExtensionProperties();
+
+    return std::ranges::any_of(supp_extensions,
+                               [](const vk::ExtensionProperties &supp_ext) {
+                                   return strcmp(supp_ext.extensionName, vk::EXTMemoryBudgetExtensionName) == 0;
+                               });
+}
+
+// both are in the mandatory format table for vertex buffers, checked anyway so a driver that leaves them
+// out falls back to Vertex
+bool Engine::supports_packed_vertices(const vk::raii::PhysicalDevice &pd)
+{
+    return std::ranges::all_of(PackedVertex::get_attribute_descriptions(),
+                               [&pd](const vk::VertexInputAttributeDescription &attribute) {
+                                   return static_cast<bool>(pd.getFormatProperties(attribute.format).bufferFeatures &
+                                                            vk::FormatFeatureFlagBits::eVertexBuffer);
+                               });
+}
+
+// compressed formats are optional, a baked texture the device can't sample falls back to the PNG
+bool Engine::supports_texture_format(const vk::raii::PhysicalDevice &pd, vk::Format format)
+{
+    vk::FormatFeatureFlags required =
+        vk::FormatFeatureFlagBits::eSampledImage |
+        vk::FormatFeatureFlagBits::eSampledImageFilterLinear |
+        vk::FormatFeatureFlagBits::eTransferDst;
+
+    return (pd.getFormatProperties(format).optimalTilingFeatures & required) == required;
+}
+
+// what generate_mipmaps needs, a linearly filtered blit from and to the format
+bool Engine::supports_blit_mipmaps(const vk::raii::PhysicalDevice &pd, vk::Format format)
+{
+    vk::FormatFeatureFlags required =
+        vk::FormatFeatureFlagBits::eBlitSrc |
+        vk::FormatFeatureFlagBits::eBlitDst |
+        vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+    return (pd.getFormatProperties(format).optimalTilingFeatures & required) == required;
+}
+
 std::vector<const char *> Engine::get_required_instance_extensions(void)
 {
     uint32_t     glfw_extension_count = 0;
@@ -587,6 +702,61 @@ std::vector<const char *> Engine::get_required_instance_extensions(void)
     return extensions;
 }
 
+bool Engine::is_pipeline_cache_compatible(
+        const std::vector<char> &data,
+        const vk::PhysicalDeviceProperties &props
+    )
+{
+    VkPipelineCacheHeaderVersionOne header;
+
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID &&
+           header.deviceID == props.deviceID &&
+           memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+void Engine::load_obj(
+        const std::string &fname,
+        JobSystem &jobs,
+        std::vector<Vertex> &vertices,
+        std::vector<uint32_t> &indices
+    )
+{
+    ObjMesh             mesh = parse_obj(fname, jobs);
+    std::vector<Vertex> corners(mesh.corners.size());
+
+    size_t blocks = jobs.thread_count();
+    jobs.parallel_for(blocks, [&](size_t block) {
+        size_t end = corners.size() * (block + 1) / blocks;
+        for (size_t i = corners.size() * block / blocks; i < end; i++) {
+            const ObjMesh::Corner &corner = mesh.corners[i];
+            Vertex                &vertex = corners[i];
+
+            vertex.pos = {
+                mesh.positions[3 * corner.position + 0],
+                mesh.positions[3 * corner.position + 1],
+                mesh.positions[3 * corner.position + 2],
+            };
+
+            vertex.tex_coord = { 0.0f, 0.0f };
+            if (corner.tex_coord >= 0) {
+                vertex.tex_coord = {
+                    mesh.tex_coords[2 * corner.tex_coord + 0],
+                    1.0f - mesh.tex_coords[2 * corner.tex_coord + 1],
+                };
+            }
+        }
+    });
+
+    VertexWelder::weld(corners, &jobs, vertices, indices);
+}
+
 std::vector<char> Engine::read_file(const std::string &fname)
 {
     std::ifstream     f(fname, std::ios::ate | std::ios::binary);
@@ -608,13 +778,18 @@ vk::Bool32 Engine::debug_callback(
         vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
         vk::DebugUtilsMessageTypeFlagsEXT type,
         const vk::DebugUtilsMessengerCallbackDataEXT *callback_data,
-        void *
+        void *user_data
     )
 {
     (void)type;
 
     if (severity >= vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo) {
-        std::cerr << "validation layer" << " msg: " << callback_data->pMessage << std::endl;
+        static_cast<DebugLogger *>(user_data)->log(
+            severity,
+            callback_data->messageIdNumber,
+            callback_data->pMessageIdName,
+            callback_data->pMessage
+        );
     }
     return vk::False;
 }
@@ -8,8 +8,12 @@
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <array>
 #include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 
 struct Vertex {
     alignas(16) glm::vec3 pos;
@@ -37,14 +41,93 @@ struct Vertex {
     }
 };
 
+// Vertex as uploaded with CONFIG_VERTEX_QUANTIZE, 12 bytes instead of 32. pos is 16 bit unorm within
+// the mesh bounds (w is padding) and mapped back by the vertex shader, tex_coord is half float
+struct PackedVertex {
+    uint16_t pos[4];
+    uint16_t tex_coord[2];
+
+    static vk::VertexInputBindingDescription get_binding_description(void)
+    {
+        return vk::VertexInputBindingDescription(
+            0,
+            sizeof(PackedVertex),
+            vk::VertexInputRate::eVertex
+        );
+    }
+
+    static std::array<vk::VertexInputAttributeDescription, 2> get_attribute_descriptions(void)
+    {
+        return {
+            vk::VertexInputAttributeDescription(0, 0, vk::Format::eR16G16B16A16Unorm, offsetof(PackedVertex, pos)),
+            vk::VertexInputAttributeDescription(1, 0, vk::Format::eR16G16Sfloat, offsetof(PackedVertex, tex_coord)),
+        };
+    }
+};
+
+// IEEE half with round to nearest even, out of range values become infinity
+inline uint16_t float_to_half(float f)
+{
+    uint32_t bits = std::bit_cast<uint32_t>(f);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs  = bits & 0x7fffffff;
+
+    if (abs >= 0x7f800000) {
+        return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+    }
+    // 65520 and up round past the largest half
+    if (abs >= 0x477ff000) {
+        return sign | 0x7c00;
+    }
+    // below 2^-14 the half is subnormal, a multiple of 2^-24
+    if (abs < 0x38800000) {
+        return sign | static_cast<uint16_t>(std::nearbyint(std::bit_cast<float>(abs) * 16777216.0f));
+    }
+
+    // rebias the exponent from 127 to 15, then round the 13 dropped mantissa bits
+    abs += 0xc8000fff + ((abs >> 13) & 1);
+    return sign | (abs >> 13);
+}
+
+// pos is mapped from [min, min + 1 / inv_extent] to [0, 65535]
+inline PackedVertex pack_vertex(const Vertex &vertex, const glm::vec3 &min, const glm::vec3 &inv_extent)
+{
+    auto unorm = [](float f) { return static_cast<uint16_t>(std::clamp(f, 0.0f, 1.0f) * 65535.0f + 0.5f); };
+
+    glm::vec3 pos = (vertex.pos - min) * inv_extent;
+    return {
+        { unorm(pos.x), unorm(pos.y), unorm(pos.z), 0 },
+        { float_to_half(vertex.tex_coord.x), float_to_half(vertex.tex_coord.y) },
+    };
+}
+
+// Murmur3 style mixing of the packed fields. Adding 0.0f turns -0.0 into 0.0, the two compare equal
+// so they must hash equal too
+inline uint64_t hash_vertex(const Vertex &vertex)
+{
+    auto bits = [](float f) -> uint64_t { return std::bit_cast<uint32_t>(f + 0.0f); };
+    auto mix = [](uint64_t h, uint64_t k) {
+        k *= 0x87c37b91114253d5ull;
+        k = std::rotl(k, 31) * 0x4cf5ad432745937full;
+        return std::rotl(h ^ k, 27) * 5 + 0x52dce729;
+    };
+
+    uint64_t h = 0;
+    h = mix(h, bits(vertex.pos.x) | bits(vertex.pos.y) << 32);
+    h = mix(h, bits(vertex.pos.z) | bits(vertex.tex_coord.x) << 32);
+    h = mix(h, bits(vertex.tex_coord.y));
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 33);
+}
+
 namespace std {
     template<> struct hash<Vertex> {
         size_t operator()(const Vertex &vertex) const {
-            return std::bit_cast<uint32_t>(vertex.pos.x) ^
-                   std::bit_cast<uint32_t>(vertex.pos.y) ^
-                   std::bit_cast<uint32_t>(vertex.pos.z) ^
-                   std::bit_cast<uint32_t>(vertex.tex_coord.x) ^
-                   std::bit_cast<uint32_t>(vertex.tex_coord.y);
+            return hash_vertex(vertex);
         }
     };
 }
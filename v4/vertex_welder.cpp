@@ -0,0 +1,134 @@
+
+#include "vertex_welder.hpp"
+
+#include <algorithm>
+#include <bit>
+
+// below this many corners a single table is faster than splitting the work
+static constexpr size_t MIN_PARALLEL_CORNERS = 1 << 16;
+
+VertexWelder::VertexWelder(size_t max_vertices)
+{
+    // at most 2/3 full
+    size_t capacity = std::bit_ceil(std::max<size_t>(max_vertices + max_vertices / 2, 16));
+
+    this->slots.assign(capacity, { 0, EMPTY });
+    this->mask = capacity - 1;
+    this->vertices.reserve(max_vertices);
+}
+
+uint32_t VertexWelder::insert(const Vertex &vertex, uint64_t hash)
+{
+    uint32_t tag = hash >> 32;
+
+    if ((this->vertices.size() + 1) * 3 > this->slots.size() * 2) {
+        grow();
+    }
+
+    for (size_t i = hash & this->mask;; i = (i + 1) & this->mask) {
+        Slot &slot = this->slots[i];
+
+        if (slot.index == EMPTY) {
+            slot = { tag, static_cast<uint32_t>(this->vertices.size()) };
+            this->vertices.push_back(vertex);
+            return slot.index;
+        }
+        if (slot.tag == tag && this->vertices[slot.index] == vertex) {
+            return slot.index;
+        }
+    }
+}
+
+uint32_t VertexWelder::insert(const Vertex &vertex)
+{
+    return insert(vertex, hash_vertex(vertex));
+}
+
+// only when max_vertices was exceeded, e.g. a shard got more than its share
+void VertexWelder::grow(void)
+{
+    this->slots.assign(this->slots.size() * 2, { 0, EMPTY });
+    this->mask = this->slots.size() - 1;
+
+    for (uint32_t index = 0; index < this->vertices.size(); index++) {
+        uint64_t hash = hash_vertex(this->vertices[index]);
+        size_t   i    = hash & this->mask;
+
+        while (this->slots[i].index != EMPTY) {
+            i = (i + 1) & this->mask;
+        }
+        this->slots[i] = { static_cast<uint32_t>(hash >> 32), index };
+    }
+}
+
+std::vector<Vertex> &VertexWelder::get_vertices(void)
+{
+    return this->vertices;
+}
+
+void VertexWelder::weld(
+        std::span<const Vertex> corners,
+        JobSystem *jobs,
+        std::vector<Vertex> &vertices,
+        std::vector<uint32_t> &indices
+    )
+{
+    size_t first_index = indices.size();
+    indices.resize(first_index + corners.size());
+
+    uint32_t *out = indices.data() + first_index;
+    uint32_t base = vertices.size();
+
+    if (jobs == nullptr || jobs->thread_count() == 1 || corners.size() < MIN_PARALLEL_CORNERS) {
+        VertexWelder welder(corners.size());
+        for (size_t i = 0; i < corners.size(); i++) {
+            out[i] = base + welder.insert(corners[i]);
+        }
+        vertices.insert(vertices.end(), welder.vertices.begin(), welder.vertices.end());
+        return;
+    }
+
+    // top bits of the hash pick the shard, the low bits the slot, so shards still spread over their tables
+    size_t shard_bits  = std::bit_width(std::bit_ceil(jobs->thread_count() * 2) - 1);
+    size_t shard_count = size_t(1) << shard_bits;
+    size_t block_count = shard_count;
+    auto   shard_of    = [shard_bits](uint64_t hash) { return hash >> (64 - shard_bits); };
+
+    std::vector<uint64_t> hashes(corners.size());
+    jobs->parallel_for(block_count, [&](size_t block) {
+        size_t end = corners.size() * (block + 1) / block_count;
+        for (size_t i = corners.size() * block / block_count; i < end; i++) {
+            hashes[i] = hash_vertex(corners[i]);
+        }
+    });
+
+    // every shard scans all hashes but only touches its own corners, the local index goes to out[]
+    std::vector<std::vector<Vertex>> shard_vertices(shard_count);
+    jobs->parallel_for(shard_count, [&](size_t shard) {
+        VertexWelder welder(corners.size() / shard_count * 2);
+        for (size_t i = 0; i < corners.size(); i++) {
+            if (shard_of(hashes[i]) == shard) {
+                out[i] = welder.insert(corners[i], hashes[i]);
+            }
+        }
+        shard_vertices[shard] = std::move(welder.vertices);
+    });
+
+    std::vector<uint32_t> shard_base(shard_count);
+    for (size_t shard = 0; shard < shard_count; shard++) {
+        shard_base[shard] = base;
+        base += shard_vertices[shard].size();
+    }
+
+    vertices.resize(base);
+    jobs->parallel_for(shard_count, [&](size_t shard) {
+        std::ranges::copy(shard_vertices[shard], vertices.begin() + shard_base[shard]);
+    });
+
+    jobs->parallel_for(block_count, [&](size_t block) {
+        size_t end = corners.size() * (block + 1) / block_count;
+        for (size_t i = corners.size() * block / block_count; i < end; i++) {
+            out[i] += shard_base[shard_of(hashes[i])];
+        }
+    });
+}
@@ -0,0 +1,56 @@
+
+#ifndef VERTEX_WELDER_HPP
+#define VERTEX_WELDER_HPP
+
+#include "job_system.hpp"
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Merges equal vertices into one. Vertices live in a flat array and the hash table is an array of
+// (tag, index) slots probed linearly. It is sized up front from the vertex count, so it rehashes only
+// when the estimate was too low, and a lookup touches one or two cache lines.
+class VertexWelder {
+public:
+    // max_vertices bounds the number of unique vertices, usually the number of corners
+    explicit VertexWelder(size_t max_vertices);
+
+    // index of vertex, which is appended if it is not known yet
+    [[nodiscard]]
+    uint32_t insert(const Vertex &vertex, uint64_t hash);
+
+    [[nodiscard]]
+    uint32_t insert(const Vertex &vertex);
+
+    [[nodiscard]]
+    std::vector<Vertex> &get_vertices(void);
+
+    // Welds a corner per index into vertices and indices. With more than one job system thread the
+    // corners are split into shards by hash and each shard is welded by its own job, vertices are then
+    // ordered by shard instead of by first use
+    static void weld(
+        std::span<const Vertex> corners,
+        JobSystem *jobs,
+        std::vector<Vertex> &vertices,
+        std::vector<uint32_t> &indices
+    );
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    void grow(void);
+
+    struct Slot {
+        // high half of the hash, compared before the vertex itself
+        uint32_t tag;
+        uint32_t index;
+    };
+
+    std::vector<Slot>   slots;
+    size_t              mask = 0;
+    std::vector<Vertex> vertices;
+};
+
+#endif /* VERTEX_WELDER_HPP */
@@ -21,6 +21,7 @@ using namespace std::string_literals;
 static constexpr uint32_t WIDTH = 800;
 static constexpr uint32_t HEIGHT = 600;
 static constexpr const char *SHADER_SPV_PATH = "./shader.spv";
+static constexpr const char *PIPELINE_CACHE_PATH = "./pipeline_cache.bin";
 static const std::vector<const char *> g_validation_layers = {
 #if CONFIG_VALIDATION_LAYERS
     "VK_LAYER_KHRONOS_validation",
@@ -37,24 +38,86 @@ void Engine::run(void)
     cleanup();
 }
 
+double Engine::bench_init(const BenchOptions &options)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    this->bench_options = options;
+
+    init_window();
+    init_vulkan();
+    draw_frame(this->current_frame);
+    this->current_frame = (this->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+BenchFrame Engine::bench_frame(uint32_t frame)
+{
+    uint32_t frame_idx = this->current_frame;
+    uint64_t submitted = this->frame_count;
+
+    this->bench_frame_idx = frame;
+
+    auto start = std::chrono::steady_clock::now();
+
+    glfwPollEvents();
+    draw_frame(frame_idx);
+    this->current_frame = (this->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+
+    auto end = std::chrono::steady_clock::now();
+
+    // draw_frame waited for the fence, a skipped frame left the previous timestamps in the slot
+    return {
+        std::chrono::duration<double, std::milli>(end - start).count(),
+        this->frame_count != submitted ? read_bench_queries(frame_idx) : -1.0,
+    };
+}
+
+void Engine::bench_cleanup(void)
+{
+    this->device.waitIdle();
+    cleanup();
+}
+
 void Engine::init_window(void)
 {
+    uint32_t width  = WIDTH;
+    uint32_t height = HEIGHT;
+
+    if (this->bench_options) {
+        width = this->bench_options->width;
+        height = this->bench_options->height;
+    }
+    if (this->bench_options && this->bench_options->headless) {
+#ifdef GLFW_PLATFORM_NULL
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+        throw std::runtime_error("headless benchmark needs GLFW 3.4 (null platform)");
+#endif
+    }
+
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    if (CONFIG_RESIZABLE) {
+    if (CONFIG_RESIZABLE && not this->bench_options) {
         glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     } else {
         glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     }
 
     this->window = glfwCreateWindow(
-        WIDTH,
-        HEIGHT,
+        width,
+        height,
         "vulkan",
         nullptr,
         nullptr
     );
+
+    glfwSetWindowUserPointer(this->window, this);
+    glfwSetFramebufferSizeCallback(this->window, &Engine::framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(this->window, &Engine::refresh_callback);
 }
 
 void Engine::init_vulkan(void)
@@ -66,11 +129,18 @@ void Engine::init_vulkan(void)
     create_logical_device();
     create_swapchain();
     create_image_views();
+    create_descriptor_set_layout();
+    create_pipeline_cache();
     create_graphics_pipeline();
     create_command_pool();
+    create_uniform_buffers();
     create_command_buffers();
+    create_descriptor_pool();
+    create_descriptor_sets();
     create_sync_objects();
     create_swapchain_sync_objects();
+    create_bench_queries();
+    create_prerecorded_command_buffers();
 }
 
 void Engine::create_instance(void)
@@ -253,6 +323,12 @@ void Engine::create_swapchain(void)
         std::cout << this->swapchain_extent.width << 'x' << this->swapchain_extent.height << '\n';
     }
 
+    // handing the retired swapchain over lets the presentation engine reuse its resources
+    vk::SwapchainKHR old_swapchain = nullptr;
+    if (not this->retired_swapchains.empty()) {
+        old_swapchain = *this->retired_swapchains.back().swapchain;
+    }
+
     vk::SwapchainCreateInfoKHR create_info(
         {},
         surface,
@@ -267,7 +343,8 @@ void Engine::create_swapchain(void)
         surface_capabilities.currentTransform,
         vk::CompositeAlphaFlagBitsKHR::eOpaque,
         choose_swapchain_present_mode(this->physical_device, this->surface),
-        true
+        true,
+        old_swapchain
     );
 
     this->swapchain = vk::raii::SwapchainKHR(device, create_info);
@@ -297,6 +374,55 @@ void Engine::create_image_views(void)
     }
 }
 
+void Engine::create_descriptor_set_layout(void)
+{
+    vk::DescriptorSetLayoutBinding ubo_binding(
+        0,
+        vk::DescriptorType::eUniformBuffer,
+        1,
+        vk::ShaderStageFlagBits::eFragment
+    );
+
+    vk::DescriptorSetLayoutCreateInfo layout_info(
+        {},
+        { ubo_binding }
+    );
+    this->descriptor_layout = vk::raii::DescriptorSetLayout(this->device, layout_info);
+}
+
+void Engine::create_pipeline_cache(void)
+{
+    std::vector<char> data;
+
+    try {
+        data = read_file(PIPELINE_CACHE_PATH);
+    } catch (const std::runtime_error &) {
+        // no cache on disk yet - start with empty one
+    }
+
+    // driver may reject or even crash on blobs from other devices/drivers - never pass them
+    if (not data.empty() &&
+        not is_pipeline_cache_compatible(data, this->physical_device.getProperties())) {
+        if (CONFIG_VERBOSE) {
+            std::cout << "pipeline cache " << PIPELINE_CACHE_PATH << " is stale, ignoring\n";
+        }
+        data.clear();
+    }
+
+    if (CONFIG_VERBOSE) {
+        std::cout << "pipeline cache: " << (data.empty() ? "cold" : "warm")
+                  << " (" << data.size() << " bytes)\n";
+    }
+
+    vk::PipelineCacheCreateInfo create_info(
+        {},
+        data.size(),
+        data.data()
+    );
+
+    this->pipeline_cache = vk::raii::PipelineCache(this->device, create_info);
+}
+
 void Engine::create_graphics_pipeline(void)
 {
     vk::raii::ShaderModule shader_module = create_shader_module(this->device, read_file(SHADER_SPV_PATH));
@@ -391,14 +517,15 @@ void Engine::create_graphics_pipeline(void)
     );
 
     // pipeline layout
-    vk::PushConstantRange time_push_constant_range(
-        vk::ShaderStageFlagBits::eFragment,
-        0,
-        sizeof(float)
+    vk::PipelineLayoutCreateInfo pipeline_layout_create_info(
+        {},
+        { *this->descriptor_layout },
+        {}
+    );
+    this->pipeline_layout = vk::raii::PipelineLayout(
+        this->device,
+        pipeline_layout_create_info
     );
-    vk::PipelineLayoutCreateInfo pipeline_layout_create_info;
-    pipeline_layout_create_info.setPushConstantRanges({ time_push_constant_range });
-    this->pipeline_layout = vk::raii::PipelineLayout(this->device, pipeline_layout_create_info);
 
     // pipeline rendering
     vk::PipelineRenderingCreateInfo pipeline_rendering(
@@ -427,7 +554,36 @@ void Engine::create_graphics_pipeline(void)
         &pipeline_rendering
     );
 
-    this->pipeline = vk::raii::Pipeline(this->device, nullptr, pipeline_create_info);
+    auto start = std::chrono::steady_clock::now();
+
+    this->pipeline = vk::raii::Pipeline(this->device, this->pipeline_cache, pipeline_create_info);
+
+    if (CONFIG_VERBOSE) {
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "graphics pipeline created in "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+    }
+}
+
+void Engine::create_uniform_buffers(void)
+{
+    this->uniform_buffers.clear();
+
+    for (int i = 0; i < CONFIG_MAX_FRAMES_IN_FLIGHT; i++) {
+        vk::DeviceSize size = sizeof(UniformBufferObject);
+
+        auto [buffer, buffer_mem] = create_buffer(
+            this->physical_device,
+            this->device,
+            size,
+            vk::BufferUsageFlagBits::eUniformBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+        );
+
+        this->uniform_buffers_map.emplace_back(std::move(buffer_mem.mapMemory(0, size)));
+        this->uniform_buffers.emplace_back(std::move(buffer));
+        this->uniform_buffers_mem.emplace_back(std::move(buffer_mem));
+    }
 }
 
 void Engine::create_command_pool(void)
@@ -451,18 +607,47 @@ void Engine::create_command_buffers(void)
     this->command_buffers = vk::raii::CommandBuffers(this->device, allocate_info);
 }
 
-void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
+void Engine::create_prerecorded_command_buffers(void)
 {
-    const float time = std::chrono::duration<float>(
-        std::chrono::steady_clock::now() - this->start_time
-    ).count();
+    if (not CONFIG_PRERECORDED_COMMANDS) {
+        return;
+    }
+
+    // frees previous buffers, they are never pending here since every frame waits for its fence
+    this->prerecorded_command_buffers.clear();
+
+    vk::CommandBufferAllocateInfo allocate_info(
+        this->command_pool,
+        vk::CommandBufferLevel::ePrimary,
+        this->swapchain_images.size() * CONFIG_MAX_FRAMES_IN_FLIGHT
+    );
+    this->prerecorded_command_buffers = vk::raii::CommandBuffers(this->device, allocate_info);
+
+    for (uint32_t image = 0; image < this->swapchain_images.size(); image++) {
+        for (uint32_t frame = 0; frame < CONFIG_MAX_FRAMES_IN_FLIGHT; frame++) {
+            record_command_buffer(
+                this->prerecorded_command_buffers.at(image * CONFIG_MAX_FRAMES_IN_FLIGHT + frame),
+                image,
+                frame
+            );
+        }
+    }
+}
 
+void Engine::record_command_buffer(vk::raii::CommandBuffer &cb, uint32_t image_index, uint32_t frame_index)
+{
     // begin command buffer
-    this->command_buffers.at(frame_index).begin({});
+    cb.begin({});
+
+    // reset inside the buffer so pre-recorded buffers can be resubmitted
+    if (*this->bench_queries) {
+        cb.resetQueryPool(this->bench_queries, frame_index * 2, 2);
+        cb.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, this->bench_queries, frame_index * 2);
+    }
 
     // transition the swapchain image to COLOR_ATTACHMENT_OPTIMAL
     transition_image_layout(
-        this->command_buffers.at(frame_index),
+        cb,
         this->swapchain_images.at(image_index),
         vk::ImageLayout::eUndefined,
         vk::ImageLayout::eColorAttachmentOptimal,
@@ -490,24 +675,25 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         {},
         { attachment_info }
     );
-    this->command_buffers.at(frame_index).beginRendering(rendering_info);
+    cb.beginRendering(rendering_info);
 
     // bind pipeline
-    this->command_buffers.at(frame_index).bindPipeline(
+    cb.bindPipeline(
         vk::PipelineBindPoint::eGraphics,
         this->pipeline
     );
 
-    // push the frame time so the shader can animate
-    this->command_buffers.at(frame_index).pushConstants<float>(
-        *this->pipeline_layout,
-        vk::ShaderStageFlagBits::eFragment,
+    // bind descriptor sets
+    cb.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics,
+        this->pipeline_layout,
         0,
-        time
+        *this->descriptor_sets.at(frame_index),
+        {}
     );
 
     // set dynamic states
-    this->command_buffers.at(frame_index).setViewport(
+    cb.setViewport(
         0,
         vk::Viewport(
             0,
@@ -518,13 +704,13 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
             1
         )
     );
-    this->command_buffers.at(frame_index).setScissor(
+    cb.setScissor(
         0,
         vk::Rect2D(vk::Offset2D(0, 0), this->swapchain_extent)
     );
 
     // draw
-    this->command_buffers.at(frame_index).draw(
+    cb.draw(
         3,
         1,
         0,
@@ -532,11 +718,11 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
     );
 
     // end rendering
-    this->command_buffers.at(frame_index).endRendering();
+    cb.endRendering();
 
     // transition the swapchain image to PRESENT_SRC
     transition_image_layout(
-        this->command_buffers.at(frame_index),
+        cb,
         this->swapchain_images.at(image_index),
         vk::ImageLayout::eColorAttachmentOptimal,
         vk::ImageLayout::ePresentSrcKHR,
@@ -546,8 +732,65 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         vk::PipelineStageFlagBits2::eBottomOfPipe
     );
 
+    if (*this->bench_queries) {
+        cb.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, this->bench_queries, frame_index * 2 + 1);
+    }
+
     // end command buffer
-    this->command_buffers.at(frame_index).end();
+    cb.end();
+}
+
+void Engine::create_descriptor_pool(void)
+{
+    vk::DescriptorPoolSize pool_size(
+        vk::DescriptorType::eUniformBuffer,
+        CONFIG_MAX_FRAMES_IN_FLIGHT
+    );
+
+    vk::DescriptorPoolCreateInfo pool_info(
+        vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+        CONFIG_MAX_FRAMES_IN_FLIGHT,
+        { pool_size }
+    );
+
+    this->descriptor_pool = vk::raii::DescriptorPool(this->device, pool_info);
+}
+
+void Engine::create_descriptor_sets(void)
+{
+    std::vector<vk::DescriptorSetLayout> layouts(
+        CONFIG_MAX_FRAMES_IN_FLIGHT,
+        *this->descriptor_layout
+    );
+
+    vk::DescriptorSetAllocateInfo set_info(
+        this->descriptor_pool,
+        layouts
+    );
+
+    this->descriptor_sets = this->device.allocateDescriptorSets(set_info);
+
+    std::vector<vk::DescriptorBufferInfo> buffer_infos(CONFIG_MAX_FRAMES_IN_FLIGHT);
+    std::vector<vk::WriteDescriptorSet> descriptor_writes(CONFIG_MAX_FRAMES_IN_FLIGHT);
+
+    for (int i = 0; i < CONFIG_MAX_FRAMES_IN_FLIGHT; i++) {
+        buffer_infos.at(i) = vk::DescriptorBufferInfo(
+            this->uniform_buffers.at(i),
+            0,
+            sizeof(UniformBufferObject)
+        );
+
+        descriptor_writes.at(i) = vk::WriteDescriptorSet(
+            this->descriptor_sets.at(i),
+            0,
+            0,
+            vk::DescriptorType::eUniformBuffer,
+            {},
+            { buffer_infos.at(i) }
+        );
+    }
+
+    this->device.updateDescriptorSets({descriptor_writes}, {});
 }
 
 void Engine::create_sync_objects(void)
@@ -577,50 +820,174 @@ void Engine::create_swapchain_sync_objects(void)
     }
 }
 
+void Engine::create_bench_queries(void)
+{
+    if (not this->bench_options) {
+        return;
+    }
+
+    uint32_t valid_bits = this->physical_device.getQueueFamilyProperties().at(this->queue_index).timestampValidBits;
+    this->timestamp_period = this->physical_device.getProperties().limits.timestampPeriod;
+
+    // no timestamps on this queue, GPU time is not reported
+    if (valid_bits == 0 || this->timestamp_period == 0) {
+        return;
+    }
+    this->timestamp_mask = valid_bits == 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+    vk::QueryPoolCreateInfo create_info(
+        {},
+        vk::QueryType::eTimestamp,
+        CONFIG_MAX_FRAMES_IN_FLIGHT * 2
+    );
+    this->bench_queries = vk::raii::QueryPool(this->device, create_info);
+}
+
 void Engine::recreate_swapchain(void)
 {
-    this->device.waitIdle();
+    int width  = 0;
+    int height = 0;
 
-    cleanup_swapchain();
+    // minimized window has no area to present to, keep the outdated swapchain until it is restored
+    glfwGetFramebufferSize(this->window, &width, &height);
+    if (width == 0 || height == 0) {
+        return;
+    }
+    this->swapchain_outdated = false;
+
+    // no device wait - draw_frame waits for its fence right after submit, so only presentation
+    // can still use the old images and semaphores
+    this->retired_swapchains.push_back({
+        std::move(this->swapchain),
+        std::move(this->swapchain_image_views),
+        std::move(this->render_finished),
+        this->frame_count + this->swapchain_images.size() + CONFIG_MAX_FRAMES_IN_FLIGHT
+    });
+    this->swapchain = nullptr;
+    this->swapchain_image_views.clear();
+    this->render_finished.clear();
 
     create_swapchain();
     create_image_views();
     create_swapchain_sync_objects();
+    create_bench_queries();
+    create_prerecorded_command_buffers();
+}
+
+void Engine::release_retired_swapchains(void)
+{
+    // without VK_EXT_swapchain_maintenance1 there is no fence for presentation, but every image
+    // of the old swapchain is released once that many frames were presented after it
+    while (not this->retired_swapchains.empty() &&
+           this->retired_swapchains.front().release_frame <= this->frame_count) {
+        this->retired_swapchains.pop_front();
+    }
 }
 
 void Engine::cleanup_swapchain(void)
 {
+    this->retired_swapchains.clear();
     this->swapchain_image_views.clear();
     this->swapchain = nullptr;
 }
 
-void Engine::main_loop(void)
+void Engine::framebuffer_size_callback(GLFWwindow *window, int, int)
 {
-    uint32_t current_frame = 0;
+    auto *engine = static_cast<Engine *>(glfwGetWindowUserPointer(window));
+    if (engine == nullptr) {
+        return;
+    }
 
+    // not every platform reports resize through vkQueuePresentKHR results
+    engine->swapchain_outdated = true;
+}
+
+void Engine::refresh_callback(GLFWwindow *window)
+{
+    auto *engine = static_cast<Engine *>(glfwGetWindowUserPointer(window));
+    if (engine == nullptr) {
+        return;
+    }
+
+    // some platforms block in glfwPollEvents for the whole resize drag - draw from inside it
+    engine->draw_frame(engine->current_frame);
+    engine->current_frame = (engine->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+}
+
+void Engine::main_loop(void)
+{
     while (not glfwWindowShouldClose(this->window)) {
-        glfwPollEvents();
-        draw_frame(current_frame);
-        current_frame = (current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+        // nothing to render while minimized - sleep until the window comes back
+        if (this->swapchain_outdated && glfwGetWindowAttrib(this->window, GLFW_ICONIFIED)) {
+            glfwWaitEvents();
+        } else {
+            glfwPollEvents();
+        }
+        draw_frame(this->current_frame);
+        this->current_frame = (this->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
     }
 
     this->device.waitIdle();
 }
 
+void Engine::update_uniform_buffer(int frame_idx)
+{
+    this->ubo.time = std::chrono::duration<float>(
+        std::chrono::steady_clock::now() - this->start_time
+    ).count();
+
+    // benchmark animation depends only on the frame number, every run renders the same images
+    if (this->bench_options) {
+        this->ubo.time = this->bench_frame_idx / 60.0f;
+    }
+
+    memcpy(this->uniform_buffers_map.at(frame_idx), &ubo, sizeof(UniformBufferObject));
+}
+
 void Engine::draw_frame(int frame_idx)
 {
-    auto [result, image_index] = this->swapchain.acquireNextImage(
-        UINT64_MAX,
-        present_complete.at(frame_idx),
-        nullptr
-    );
-    record_command_buffer(image_index, frame_idx);
+    vk::Result result;
+    uint32_t   image_index;
+
+    release_retired_swapchains();
+    if (this->swapchain_outdated) {
+        recreate_swapchain();
+        if (this->swapchain_outdated) {
+            return;
+        }
+    }
+
+    update_uniform_buffer(frame_idx);
+
+    try {
+        std::tie(result, image_index) = this->swapchain.acquireNextImage(
+            UINT64_MAX,
+            present_complete.at(frame_idx),
+            nullptr
+        );
+    } catch (const vk::OutOfDateKHRError &) {
+        // nothing waits on the semaphore, it stays unsignaled and the frame is skipped
+        this->swapchain_outdated = true;
+        return;
+    }
+    if (result == vk::Result::eSuboptimalKHR) {
+        // image is still presentable - render this frame, recreate before the next one
+        this->swapchain_outdated = true;
+    }
+
+    vk::raii::CommandBuffer *cb;
+    if (CONFIG_PRERECORDED_COMMANDS) {
+        cb = &this->prerecorded_command_buffers.at(image_index * CONFIG_MAX_FRAMES_IN_FLIGHT + frame_idx);
+    } else {
+        cb = &this->command_buffers.at(frame_idx);
+        record_command_buffer(*cb, image_index, frame_idx);
+    }
 
     vk::PipelineStageFlags stage_flags(vk::PipelineStageFlagBits::eColorAttachmentOutput);
     vk::SubmitInfo submit_info(
         { *present_complete.at(frame_idx) },
         { stage_flags },
-        { *this->command_buffers.at(frame_idx) },
+        { **cb },
         { *render_finished.at(image_index) }
     );
     this->queue.submit(submit_info, *frame_finished.at(frame_idx));
@@ -639,23 +1006,54 @@ void Engine::draw_frame(int frame_idx)
         { image_index }
     );
 
-    result = this->queue.presentKHR(present_info);
-    if (CONFIG_VERBOSE) {
-        switch (result) {
-        case vk::Result::eSuccess:
-            break;
-        case vk::Result::eSuboptimalKHR:
-            recreate_swapchain();
-            break;
-        default:
-            std::cout << "vk::Queue::PresentKHR returned unexpected result: " << result << '\n';
-            break;
+    try {
+        result = this->queue.presentKHR(present_info);
+    } catch (const vk::OutOfDateKHRError &) {
+        result = vk::Result::eErrorOutOfDateKHR;
+    }
+    if (result != vk::Result::eSuccess) {
+        if (CONFIG_VERBOSE) {
+            std::cout << "vk::Queue::PresentKHR: " << vk::to_string(result) << '\n';
         }
+        this->swapchain_outdated = true;
+    }
+
+    this->frame_count++;
+}
+
+double Engine::read_bench_queries(uint32_t frame_index)
+{
+    if (not *this->bench_queries) {
+        return -1.0;
+    }
+
+    auto [result, stamps] = this->bench_queries.getResults<uint64_t>(
+        frame_index * 2,
+        2,
+        2 * sizeof(uint64_t),
+        sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64
+    );
+    if (result != vk::Result::eSuccess) {
+        return -1.0;
+    }
+
+    return ((stamps.at(1) - stamps.at(0)) & this->timestamp_mask) * this->timestamp_period / 1e6;
+}
+
+void Engine::save_pipeline_cache(void)
+{
+    // losing the cache only costs startup time on next launch - do not fail shutdown because of it
+    try {
+        write_file_atomic(PIPELINE_CACHE_PATH, this->pipeline_cache.getData());
+    } catch (const std::exception &e) {
+        std::cerr << "failed to save pipeline cache: " << e.what() << '\n';
     }
 }
 
 void Engine::cleanup(void)
 {
+    save_pipeline_cache();
     cleanup_swapchain();
 
     glfwDestroyWindow(this->window);
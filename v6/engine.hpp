@@ -8,13 +8,42 @@
 #include <GLFW/glfw3.h>
 
 #include <chrono>
+#include <deque>
+#include <optional>
 #include <string>
 #include <vector>
 
+// swapchain replaced by recreate_swapchain(), presentation may still use its images and semaphores
+struct RetiredSwapchain {
+    vk::raii::SwapchainKHR           swapchain;
+    std::vector<vk::raii::ImageView> image_views;
+    std::vector<vk::raii::Semaphore> render_finished;
+    uint64_t                         release_frame;
+};
+
+// fixed-size run without user input, see bench.cpp
+struct BenchOptions {
+    uint32_t width;
+    uint32_t height;
+    // GLFW null platform, the surface comes from VK_EXT_headless_surface
+    bool     headless;
+};
+
+struct BenchFrame {
+    double cpu_ms;
+    // negative when the frame has no GPU timing
+    double gpu_ms;
+};
+
 class Engine {
 public:
     void run(void);
 
+    // benchmark driving - init returns time to the first frame, frames follow a scripted path
+    double bench_init(const BenchOptions &options);
+    BenchFrame bench_frame(uint32_t frame);
+    void bench_cleanup(void);
+
 private:
     // run functions
     void init_window(void);
@@ -32,26 +61,57 @@ private:
         void create_swapchain(void);
         void create_image_views(void);
 
+        void create_descriptor_set_layout(void);
+        void create_descriptor_pool(void);
+        void create_descriptor_sets(void);
+        void create_pipeline_cache(void);
         void create_graphics_pipeline(void);
 
+        void create_uniform_buffers(void);
+
         void create_command_pool(void);
         void create_command_buffers(void);
-        void record_command_buffer(uint32_t image_index, uint32_t frame_index);
+        void create_prerecorded_command_buffers(void);
+        void record_command_buffer(vk::raii::CommandBuffer &cb, uint32_t image_index, uint32_t frame_index);
 
         void create_sync_objects(void);
         void create_swapchain_sync_objects(void);
+        void create_bench_queries(void);
 
     // window resize functions
     void recreate_swapchain(void);
+    void release_retired_swapchains(void);
     void cleanup_swapchain(void);
+    static void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+    static void refresh_callback(GLFWwindow *window);
 
     // main loop functions
     void main_loop(void);
+        void update_uniform_buffer(int frame_idx);
         void draw_frame(int frame_idx);
+        [[nodiscard]]
+        double read_bench_queries(uint32_t frame_index);
 
+    void save_pipeline_cache(void);
     void cleanup(void);
 
     // util functions
+    [[nodiscard]]
+    static std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> create_buffer(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        vk::DeviceSize size,
+        vk::BufferUsageFlags usage,
+        vk::MemoryPropertyFlags properties
+    );
+
+    [[nodiscard]]
+    static uint32_t find_memory_type(
+        const vk::raii::PhysicalDevice &pd,
+        uint32_t typeFileter,
+        vk::MemoryPropertyFlags properties
+    );
+
     [[nodiscard]]
     static vk::raii::ShaderModule create_shader_module(
         const vk::raii::Device &dev,
@@ -111,10 +171,23 @@ private:
         void *
     );
 
+    [[nodiscard]]
+    static bool is_pipeline_cache_compatible(
+        const std::vector<char> &data,
+        const vk::PhysicalDeviceProperties &props
+    );
+
     [[nodiscard]]
     static std::vector<char> read_file(const std::string &fname);
 
+    static void write_file_atomic(const std::string &fname, const std::vector<uint8_t> &data);
+
 private:
+    struct UniformBufferObject {
+        float time;
+    };
+
+    struct UniformBufferObject       ubo;
     GLFWwindow                       *window         = nullptr;
     std::chrono::steady_clock::time_point start_time{};
 
@@ -135,16 +208,39 @@ private:
 
     std::vector<vk::Image>           swapchain_images;
     std::vector<vk::raii::ImageView> swapchain_image_views;
+    std::deque<RetiredSwapchain>     retired_swapchains;
+    bool                             swapchain_outdated = false;
+
+    vk::raii::DescriptorSetLayout    descriptor_layout = nullptr;
+    vk::raii::DescriptorPool         descriptor_pool   = nullptr;
+    std::vector<vk::raii::DescriptorSet> descriptor_sets;
 
-    vk::raii::PipelineLayout         pipeline_layout = nullptr;
-    vk::raii::Pipeline               pipeline        = nullptr;
+    vk::raii::PipelineCache          pipeline_cache    = nullptr;
+    vk::raii::PipelineLayout         pipeline_layout   = nullptr;
+    vk::raii::Pipeline               pipeline          = nullptr;
+
+    std::vector<vk::raii::Buffer>       uniform_buffers;
+    std::vector<vk::raii::DeviceMemory> uniform_buffers_mem;
+    std::vector<void *>                 uniform_buffers_map;
 
     vk::raii::CommandPool            command_pool    = nullptr;
     std::vector<vk::raii::CommandBuffer> command_buffers;
+    // indexed by image_index * CONFIG_MAX_FRAMES_IN_FLIGHT + frame_index
+    std::vector<vk::raii::CommandBuffer> prerecorded_command_buffers;
 
     std::vector<vk::raii::Semaphore> present_complete;
     std::vector<vk::raii::Semaphore> render_finished;
     std::vector<vk::raii::Fence>     frame_finished;
+
+    uint64_t                         frame_count     = 0;
+    uint32_t                         current_frame   = 0;
+
+    std::optional<BenchOptions>      bench_options;
+    uint32_t                         bench_frame_idx = 0;
+    // two timestamps per frame slot around the whole command buffer
+    vk::raii::QueryPool              bench_queries   = nullptr;
+    double                           timestamp_period = 0.0;
+    uint64_t                         timestamp_mask  = 0;
 };
 
 #endif /* ENGINE_HPP */
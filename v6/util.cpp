@@ -1,9 +1,73 @@
 
 #include "engine.hpp"
 
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+static inline uint64_t BIT(uint64_t x)
+{
+    return 1 << x;
+}
+
+std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> Engine::create_buffer(
+        const vk::raii::PhysicalDevice &pd,
+        const vk::raii::Device &dev,
+        vk::DeviceSize size,
+        vk::BufferUsageFlags usage,
+        vk::MemoryPropertyFlags properties
+    )
+{
+    vk::BufferCreateInfo buffer_info(
+        {},
+        size,
+        usage,
+        vk::SharingMode::eExclusive
+    );
+
+    vk::raii::Buffer buffer(dev, buffer_info);
+
+    vk::MemoryRequirements mem_req = buffer.getMemoryRequirements();
+    uint32_t type_index = find_memory_type(
+        pd,
+        mem_req.memoryTypeBits,
+        properties
+    );
+
+    vk::MemoryAllocateInfo alloc_info(mem_req.size, type_index);
+    vk::raii::DeviceMemory mem(dev, alloc_info);
+
+    buffer.bindMemory(*mem, 0);
+
+    return { std::move(buffer), std::move(mem) };
+}
+
+uint32_t Engine::find_memory_type(
+        const vk::raii::PhysicalDevice &pd,
+        uint32_t type_filter,
+        vk::MemoryPropertyFlags properties
+    )
+{
+    vk::PhysicalDeviceMemoryProperties mem_props = pd.getMemoryProperties();
+
+    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+        if ((type_filter & BIT(i)) == 0) {
+            continue;
+        }
+
+        if ((mem_props.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find sutable memory type");
+}
+
 void Engine::transition_image_layout(
         vk::raii::CommandBuffer &cb,
         const vk::Image &current_frame,
@@ -200,6 +264,25 @@ std::vector<const char *> Engine::get_required_instance_extensions(void)
     return extensions;
 }
 
+bool Engine::is_pipeline_cache_compatible(
+        const std::vector<char> &data,
+        const vk::PhysicalDeviceProperties &props
+    )
+{
+    VkPipelineCacheHeaderVersionOne header;
+
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID &&
+           header.deviceID == props.deviceID &&
+           memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
 std::vector<char> Engine::read_file(const std::string &fname)
 {
     std::ifstream     f(fname, std::ios::ate | std::ios::binary);
@@ -217,6 +300,40 @@ std::vector<char> Engine::read_file(const std::string &fname)
     return buff;
 }
 
+void Engine::write_file_atomic(const std::string &fname, const std::vector<uint8_t> &data)
+{
+    // write next to the target and rename over it, so a crash never leaves half-written file behind
+    std::string tmp_fname = fname + ".tmp";
+
+    int fd = open(tmp_fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file: " + tmp_fname);
+    }
+
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += n;
+    }
+
+    // without the fsync the rename may reach the disk before the data does
+    bool failed = written != data.size() || fsync(fd) != 0;
+    failed = close(fd) != 0 || failed;
+
+    if (failed) {
+        std::filesystem::remove(tmp_fname);
+        throw std::runtime_error("failed to write file: " + tmp_fname);
+    }
+
+    std::filesystem::rename(tmp_fname, fname);
+}
+
 vk::Bool32 Engine::debug_callback(
         vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
         vk::DebugUtilsMessageTypeFlagsEXT type,
@@ -8,6 +8,7 @@
 #include <glm/glm.hpp>
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <iostream>
@@ -24,6 +25,7 @@ using namespace std::string_literals;
 static constexpr uint32_t WIDTH = 800;
 static constexpr uint32_t HEIGHT = 600;
 static constexpr const char *SHADER_SPV_PATH = "./shader.spv";
+static constexpr const char *PIPELINE_CACHE_PATH = "./pipeline_cache.bin";
 
 static const std::vector<const char *> g_validation_layers = {
 #if CONFIG_VALIDATION_LAYERS
@@ -39,20 +41,82 @@ void Engine::run(void)
     cleanup();
 }
 
+double Engine::bench_init(const BenchOptions &options)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    this->bench_options = options;
+
+    this->ubo.center = { 1.0, 0.0 };
+    this->ubo.zoom = 1.0;
+    this->ubo.iter = 50;
+
+    init_window();
+    init_vulkan();
+    draw_frame(this->current_frame);
+    this->current_frame = (this->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+BenchFrame Engine::bench_frame(uint32_t frame)
+{
+    uint32_t frame_idx = this->current_frame;
+    uint64_t submitted = this->frame_count;
+
+    this->bench_frame_idx = frame;
+
+    auto start = std::chrono::steady_clock::now();
+
+    glfwPollEvents();
+    draw_frame(frame_idx);
+    this->current_frame = (this->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+
+    auto end = std::chrono::steady_clock::now();
+
+    // draw_frame waited for the fence, a skipped frame left the previous timestamps in the slot
+    return {
+        std::chrono::duration<double, std::milli>(end - start).count(),
+        this->frame_count != submitted ? read_bench_queries(frame_idx) : -1.0,
+    };
+}
+
+void Engine::bench_cleanup(void)
+{
+    this->device.waitIdle();
+    cleanup();
+}
+
 void Engine::init_window(void)
 {
+    uint32_t width  = WIDTH;
+    uint32_t height = HEIGHT;
+
+    if (this->bench_options) {
+        width = this->bench_options->width;
+        height = this->bench_options->height;
+    }
+    if (this->bench_options && this->bench_options->headless) {
+#ifdef GLFW_PLATFORM_NULL
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+        throw std::runtime_error("headless benchmark needs GLFW 3.4 (null platform)");
+#endif
+    }
+
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    if (CONFIG_RESIZABLE) {
+    if (CONFIG_RESIZABLE && not this->bench_options) {
         glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     } else {
         glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     }
 
     this->window = glfwCreateWindow(
-        WIDTH,
-        HEIGHT,
+        width,
+        height,
         "vulkan",
         nullptr,
         nullptr
@@ -60,6 +124,8 @@ void Engine::init_window(void)
 
     glfwSetWindowUserPointer(this->window, this);
     glfwSetScrollCallback(this->window, &Engine::scroll_callback);
+    glfwSetFramebufferSizeCallback(this->window, &Engine::framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(this->window, &Engine::refresh_callback);
 }
 
 void Engine::init_vulkan(void)
@@ -72,6 +138,7 @@ void Engine::init_vulkan(void)
     create_swapchain();
     create_image_views();
     create_descriptor_set_layout();
+    create_pipeline_cache();
     create_graphics_pipeline();
     create_command_pool();
     create_uniform_buffers();
@@ -80,6 +147,8 @@ void Engine::init_vulkan(void)
     create_descriptor_sets();
     create_sync_objects();
     create_swapchain_sync_objects();
+    create_bench_queries();
+    create_prerecorded_command_buffers();
 }
 
 void Engine::create_instance(void)
@@ -214,10 +283,18 @@ void Engine::create_logical_device(void)
 
     this->queue_index = get_queue_family_index(this->physical_device, this->surface);
 
+    this->present_wait = supports_present_wait(this->physical_device);
+    if (this->present_wait) {
+        extensions.push_back(vk::KHRPresentIdExtensionName);
+        extensions.push_back(vk::KHRPresentWaitExtensionName);
+    }
+
     vk::StructureChain<vk::PhysicalDeviceFeatures2,
                        vk::PhysicalDeviceVulkan11Features,
                        vk::PhysicalDeviceVulkan13Features,
-                       vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> feature_chain = {
+                       vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT,
+                       vk::PhysicalDevicePresentIdFeaturesKHR,
+                       vk::PhysicalDevicePresentWaitFeaturesKHR> feature_chain = {
         vk::PhysicalDeviceFeatures2().features.setShaderFloat64(true),
         vk::PhysicalDeviceVulkan11Features()
             .setShaderDrawParameters(true),
@@ -226,7 +303,15 @@ void Engine::create_logical_device(void)
             .setDynamicRendering(true),
         vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT()
             .setExtendedDynamicState(true),
+        vk::PhysicalDevicePresentIdFeaturesKHR()
+            .setPresentId(true),
+        vk::PhysicalDevicePresentWaitFeaturesKHR()
+            .setPresentWait(true),
     };
+    if (not this->present_wait) {
+        feature_chain.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+        feature_chain.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+    }
 
     vk::DeviceQueueCreateInfo queue_create_info(
         {},
@@ -249,20 +334,27 @@ void Engine::create_logical_device(void)
 void Engine::create_swapchain(void)
 {
     vk::SurfaceCapabilitiesKHR surface_capabilities;
+    vk::PresentModeKHR         present_mode;
     uint32_t                   image_count;
 
     surface_capabilities = this->physical_device.getSurfaceCapabilitiesKHR(this->surface);
     this->swapchain_surface_foramt = choose_swapchain_surface_format(this->physical_device, this->surface);
     this->swapchain_extent = choose_swapchain_extent(this->physical_device, this->surface, this->window);
 
-    image_count = surface_capabilities.minImageCount + 1;
-    if (surface_capabilities.maxImageCount) {
-        image_count = std::min(image_count, surface_capabilities.maxImageCount);
-    }
+    present_mode = choose_swapchain_present_mode(this->physical_device, this->surface, this->latency_profile);
+    image_count = choose_swapchain_image_count(surface_capabilities, present_mode, this->latency_profile);
 
     if (CONFIG_VERBOSE) {
         std::cout << "current window size:";
         std::cout << this->swapchain_extent.width << 'x' << this->swapchain_extent.height << '\n';
+        std::cout << "latency profile: " << get_latency_profile_name(this->latency_profile)
+                  << ", " << vk::to_string(present_mode) << ", " << image_count << " images\n";
+    }
+
+    // handing the retired swapchain over lets the presentation engine reuse its resources
+    vk::SwapchainKHR old_swapchain = nullptr;
+    if (not this->retired_swapchains.empty()) {
+        old_swapchain = *this->retired_swapchains.back().swapchain;
     }
 
     vk::SwapchainCreateInfoKHR create_info(
@@ -278,8 +370,9 @@ void Engine::create_swapchain(void)
         {},
         surface_capabilities.currentTransform,
         vk::CompositeAlphaFlagBitsKHR::eOpaque,
-        choose_swapchain_present_mode(this->physical_device, this->surface),
-        true
+        present_mode,
+        true,
+        old_swapchain
     );
 
     this->swapchain = vk::raii::SwapchainKHR(device, create_info);
@@ -325,6 +418,39 @@ void Engine::create_descriptor_set_layout(void)
     this->descriptor_layout = vk::raii::DescriptorSetLayout(this->device, layout_info);
 }
 
+void Engine::create_pipeline_cache(void)
+{
+    std::vector<char> data;
+
+    try {
+        data = read_file(PIPELINE_CACHE_PATH);
+    } catch (const std::runtime_error &) {
+        // no cache on disk yet - start with empty one
+    }
+
+    // driver may reject or even crash on blobs from other devices/drivers - never pass them
+    if (not data.empty() &&
+        not is_pipeline_cache_compatible(data, this->physical_device.getProperties())) {
+        if (CONFIG_VERBOSE) {
+            std::cout << "pipeline cache " << PIPELINE_CACHE_PATH << " is stale, ignoring\n";
+        }
+        data.clear();
+    }
+
+    if (CONFIG_VERBOSE) {
+        std::cout << "pipeline cache: " << (data.empty() ? "cold" : "warm")
+                  << " (" << data.size() << " bytes)\n";
+    }
+
+    vk::PipelineCacheCreateInfo create_info(
+        {},
+        data.size(),
+        data.data()
+    );
+
+    this->pipeline_cache = vk::raii::PipelineCache(this->device, create_info);
+}
+
 void Engine::create_graphics_pipeline(void)
 {
     vk::raii::ShaderModule shader_module = create_shader_module(this->device, read_file(SHADER_SPV_PATH));
@@ -336,11 +462,24 @@ void Engine::create_graphics_pipeline(void)
         shader_module,
         "vert_main"
     );
+    vk::Bool32 use_push_constants = not CONFIG_PRERECORDED_COMMANDS;
+    vk::SpecializationMapEntry specialization_entry(
+        0,
+        0,
+        sizeof(use_push_constants)
+    );
+    vk::SpecializationInfo specialization_info(
+        1,
+        &specialization_entry,
+        sizeof(use_push_constants),
+        &use_push_constants
+    );
     vk::PipelineShaderStageCreateInfo frag_create_info(
         {},
         vk::ShaderStageFlagBits::eFragment,
         shader_module,
-        "frag_main"
+        "frag_main",
+        &specialization_info
     );
     vk::PipelineShaderStageCreateInfo shader_stages[] = {
         vert_create_info,
@@ -419,10 +558,15 @@ void Engine::create_graphics_pipeline(void)
     );
 
     // pipeline layout
+    vk::PushConstantRange push_constant_range(
+        vk::ShaderStageFlagBits::eFragment,
+        0,
+        sizeof(UniformBufferObject)
+    );
     vk::PipelineLayoutCreateInfo pipeline_layout_create_info(
         {},
         { *this->descriptor_layout },
-        {}
+        { push_constant_range }
     );
     this->pipeline_layout = vk::raii::PipelineLayout(
         this->device,
@@ -456,7 +600,15 @@ void Engine::create_graphics_pipeline(void)
         &pipeline_rendering
     );
 
-    this->pipeline = vk::raii::Pipeline(this->device, nullptr, pipeline_create_info);
+    auto start = std::chrono::steady_clock::now();
+
+    this->pipeline = vk::raii::Pipeline(this->device, this->pipeline_cache, pipeline_create_info);
+
+    if (CONFIG_VERBOSE) {
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "graphics pipeline created in "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+    }
 }
 
 void Engine::create_uniform_buffers(void)
@@ -501,14 +653,47 @@ void Engine::create_command_buffers(void)
     this->command_buffers = vk::raii::CommandBuffers(this->device, allocate_info);
 }
 
-void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
+void Engine::create_prerecorded_command_buffers(void)
+{
+    if (not CONFIG_PRERECORDED_COMMANDS) {
+        return;
+    }
+
+    // frees previous buffers, they are never pending here since every frame waits for its fence
+    this->prerecorded_command_buffers.clear();
+
+    vk::CommandBufferAllocateInfo allocate_info(
+        this->command_pool,
+        vk::CommandBufferLevel::ePrimary,
+        this->swapchain_images.size() * CONFIG_MAX_FRAMES_IN_FLIGHT
+    );
+    this->prerecorded_command_buffers = vk::raii::CommandBuffers(this->device, allocate_info);
+
+    for (uint32_t image = 0; image < this->swapchain_images.size(); image++) {
+        for (uint32_t frame = 0; frame < CONFIG_MAX_FRAMES_IN_FLIGHT; frame++) {
+            record_command_buffer(
+                this->prerecorded_command_buffers.at(image * CONFIG_MAX_FRAMES_IN_FLIGHT + frame),
+                image,
+                frame
+            );
+        }
+    }
+}
+
+void Engine::record_command_buffer(vk::raii::CommandBuffer &cb, uint32_t image_index, uint32_t frame_index)
 {
     // begin command buffer
-    this->command_buffers.at(frame_index).begin({});
+    cb.begin({});
+
+    // reset inside the buffer so pre-recorded buffers can be resubmitted
+    if (*this->bench_queries) {
+        cb.resetQueryPool(this->bench_queries, frame_index * 2, 2);
+        cb.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, this->bench_queries, frame_index * 2);
+    }
 
     // transition the swapchain image to COLOR_ATTACHMENT_OPTIMAL
     transition_image_layout(
-        this->command_buffers.at(frame_index),
+        cb,
         this->swapchain_images.at(image_index),
         vk::ImageLayout::eUndefined,
         vk::ImageLayout::eColorAttachmentOptimal,
@@ -536,10 +721,10 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         {},
         { attachment_info }
     );
-    this->command_buffers.at(frame_index).beginRendering(rendering_info);
+    cb.beginRendering(rendering_info);
 
     // bind pipeline
-    this->command_buffers.at(frame_index).bindPipeline(
+    cb.bindPipeline(
         vk::PipelineBindPoint::eGraphics,
         this->pipeline
     );
@@ -551,7 +736,7 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
     // (skipped)
 
     // bind descriptor sets
-    this->command_buffers.at(frame_index).bindDescriptorSets(
+    cb.bindDescriptorSets(
         vk::PipelineBindPoint::eGraphics,
         this->pipeline_layout,
         0,
@@ -559,8 +744,18 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         {}
     );
 
+    // center/zoom change every frame while navigating, push them instead of rewriting a buffer
+    if (not CONFIG_PRERECORDED_COMMANDS) {
+        cb.pushConstants<UniformBufferObject>(
+            this->pipeline_layout,
+            vk::ShaderStageFlagBits::eFragment,
+            0,
+            this->ubo
+        );
+    }
+
     // set dynamic states
-    this->command_buffers.at(frame_index).setViewport(
+    cb.setViewport(
         0,
         vk::Viewport(
             0,
@@ -571,13 +766,13 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
             1
         )
     );
-    this->command_buffers.at(frame_index).setScissor(
+    cb.setScissor(
         0,
         vk::Rect2D(vk::Offset2D(0, 0), this->swapchain_extent)
     );
 
     // draw
-    this->command_buffers.at(frame_index).draw(
+    cb.draw(
         3,
         1,
         0,
@@ -585,11 +780,11 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
     );
 
     // end rendering
-    this->command_buffers.at(frame_index).endRendering();
+    cb.endRendering();
 
     // transition the swapchain image to PRESENT_SRC
     transition_image_layout(
-        this->command_buffers.at(frame_index),
+        cb,
         this->swapchain_images.at(image_index),
         vk::ImageLayout::eColorAttachmentOptimal,
         vk::ImageLayout::ePresentSrcKHR,
@@ -599,8 +794,12 @@ void Engine::record_command_buffer(uint32_t image_index, uint32_t frame_index)
         vk::PipelineStageFlagBits2::eBottomOfPipe
     );
 
+    if (*this->bench_queries) {
+        cb.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, this->bench_queries, frame_index * 2 + 1);
+    }
+
     // end command buffer
-    this->command_buffers.at(frame_index).end();
+    cb.end();
 }
 
 void Engine::create_descriptor_pool(void)
@@ -683,23 +882,103 @@ void Engine::create_swapchain_sync_objects(void)
     }
 }
 
+void Engine::create_bench_queries(void)
+{
+    if (not this->bench_options) {
+        return;
+    }
+
+    uint32_t valid_bits = this->physical_device.getQueueFamilyProperties().at(this->queue_index).timestampValidBits;
+    this->timestamp_period = this->physical_device.getProperties().limits.timestampPeriod;
+
+    // no timestamps on this queue, GPU time is not reported
+    if (valid_bits == 0 || this->timestamp_period == 0) {
+        return;
+    }
+    this->timestamp_mask = valid_bits == 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+    vk::QueryPoolCreateInfo create_info(
+        {},
+        vk::QueryType::eTimestamp,
+        CONFIG_MAX_FRAMES_IN_FLIGHT * 2
+    );
+    this->bench_queries = vk::raii::QueryPool(this->device, create_info);
+}
+
 void Engine::recreate_swapchain(void)
 {
-    this->device.waitIdle();
+    int width  = 0;
+    int height = 0;
 
-    cleanup_swapchain();
+    // minimized window has no area to present to, keep the outdated swapchain until it is restored
+    glfwGetFramebufferSize(this->window, &width, &height);
+    if (width == 0 || height == 0) {
+        return;
+    }
+    this->swapchain_outdated = false;
+
+    // present ids are waited on per swapchain, latency of frames still queued on the old one is lost
+    this->pending_presents.clear();
+
+    // no device wait - draw_frame waits for its fence right after submit, so only presentation
+    // can still use the old images and semaphores
+    this->retired_swapchains.push_back({
+        std::move(this->swapchain),
+        std::move(this->swapchain_image_views),
+        std::move(this->render_finished),
+        this->frame_count + this->swapchain_images.size() + CONFIG_MAX_FRAMES_IN_FLIGHT
+    });
+    this->swapchain = nullptr;
+    this->swapchain_image_views.clear();
+    this->render_finished.clear();
 
     create_swapchain();
     create_image_views();
     create_swapchain_sync_objects();
+    create_bench_queries();
+    create_prerecorded_command_buffers();
+}
+
+void Engine::release_retired_swapchains(void)
+{
+    // without VK_EXT_swapchain_maintenance1 there is no fence for presentation, but every image
+    // of the old swapchain is released once that many frames were presented after it
+    while (not this->retired_swapchains.empty() &&
+           this->retired_swapchains.front().release_frame <= this->frame_count) {
+        this->retired_swapchains.pop_front();
+    }
 }
 
 void Engine::cleanup_swapchain(void)
 {
+    this->retired_swapchains.clear();
     this->swapchain_image_views.clear();
     this->swapchain = nullptr;
 }
 
+void Engine::framebuffer_size_callback(GLFWwindow *window, int, int)
+{
+    auto *engine = static_cast<Engine *>(glfwGetWindowUserPointer(window));
+    if (engine == nullptr) {
+        return;
+    }
+
+    // not every platform reports resize through vkQueuePresentKHR results
+    engine->swapchain_outdated = true;
+}
+
+void Engine::refresh_callback(GLFWwindow *window)
+{
+    auto *engine = static_cast<Engine *>(glfwGetWindowUserPointer(window));
+    if (engine == nullptr) {
+        return;
+    }
+
+    // some platforms block in glfwPollEvents for the whole resize drag - draw from inside it
+    engine->draw_frame(engine->current_frame);
+    engine->current_frame = (engine->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+}
+
 bool Engine::process_input(void)
 {
     constexpr double zoom_step = 1.02;
@@ -749,6 +1028,16 @@ bool Engine::process_input(void)
         press = true;
     }
 
+    // cycle latency profiles, the new one takes effect with the recreated swapchain
+    bool latency_key = glfwGetKey(this->window, GLFW_KEY_L) == GLFW_PRESS;
+    if (latency_key && !this->latency_key_down) {
+        report_present_latency();
+        this->latency_profile = static_cast<LatencyProfile>((static_cast<int>(this->latency_profile) + 1) % 3);
+        this->swapchain_outdated = true;
+        press = true;
+    }
+    this->latency_key_down = latency_key;
+
     int mouse_state = glfwGetMouseButton(this->window, GLFW_MOUSE_BUTTON_LEFT);
     double cursor_x = 0.0;
     double cursor_y = 0.0;
@@ -763,11 +1052,9 @@ bool Engine::process_input(void)
         } else {
             const double dx = cursor_x - this->last_cursor_x;
             const double dy = cursor_y - this->last_cursor_y;
-            const double pan_step = 2.0 / static_cast<double>(this->swapchain_extent.height) / this->ubo.zoom;
 
             if (dx != 0.0 || dy != 0.0) {
-                this->ubo.center.x += dx * pan_step;
-                this->ubo.center.y += dy * pan_step;
+                pan_view(this->ubo, dx, dy, this->swapchain_extent);
                 this->last_cursor_x = cursor_x;
                 this->last_cursor_y = cursor_y;
                 press = true;
@@ -778,19 +1065,7 @@ bool Engine::process_input(void)
     }
 
     if (this->pending_scroll_y != 0.0) {
-        const double old_zoom = this->ubo.zoom;
-        const double new_zoom = std::clamp(
-            this->ubo.zoom * std::pow(zoom_step, this->pending_scroll_y),
-            1e-6,
-            1e6
-        );
-        const double aspect = static_cast<double>(this->swapchain_extent.width) / static_cast<double>(this->swapchain_extent.height);
-        const double scaled_x = (cursor_x / static_cast<double>(this->swapchain_extent.width) * 2.0 - 1.0) * aspect;
-        const double scaled_y = cursor_y / static_cast<double>(this->swapchain_extent.height) * 2.0 - 1.0;
-
-        this->ubo.center.x += scaled_x * (1.0 / new_zoom - 1.0 / old_zoom);
-        this->ubo.center.y += scaled_y * (1.0 / new_zoom - 1.0 / old_zoom);
-        this->ubo.zoom = new_zoom;
+        zoom_view(this->ubo, this->pending_scroll_y, cursor_x, cursor_y, this->swapchain_extent);
         this->pending_scroll_y = 0.0;
         press = true;
     }
@@ -798,6 +1073,40 @@ bool Engine::process_input(void)
     return press;
 }
 
+void Engine::pan_view(UniformBufferObject &view, double dx, double dy, vk::Extent2D extent)
+{
+    const double pan_step = 2.0 / static_cast<double>(extent.height) / view.zoom;
+
+    view.center.x += dx * pan_step;
+    view.center.y += dy * pan_step;
+}
+
+// zooms keeping the point under the cursor in place
+void Engine::zoom_view(
+        UniformBufferObject &view,
+        double scroll,
+        double cursor_x,
+        double cursor_y,
+        vk::Extent2D extent
+    )
+{
+    constexpr double zoom_step = 1.02;
+
+    const double old_zoom = view.zoom;
+    const double new_zoom = std::clamp(
+        view.zoom * std::pow(zoom_step, scroll),
+        1e-6,
+        1e6
+    );
+    const double aspect = static_cast<double>(extent.width) / static_cast<double>(extent.height);
+    const double scaled_x = (cursor_x / static_cast<double>(extent.width) * 2.0 - 1.0) * aspect;
+    const double scaled_y = cursor_y / static_cast<double>(extent.height) * 2.0 - 1.0;
+
+    view.center.x += scaled_x * (1.0 / new_zoom - 1.0 / old_zoom);
+    view.center.y += scaled_y * (1.0 / new_zoom - 1.0 / old_zoom);
+    view.zoom = new_zoom;
+}
+
 void Engine::scroll_callback(GLFWwindow *window, double /*xoffset*/, double yoffset)
 {
     auto *engine = static_cast<Engine *>(glfwGetWindowUserPointer(window));
@@ -808,10 +1117,58 @@ void Engine::scroll_callback(GLFWwindow *window, double /*xoffset*/, double yoff
     engine->pending_scroll_y += yoffset;
 }
 
-void Engine::main_loop(void)
+void Engine::poll_present_latency(void)
+{
+    // vkWaitForPresentKHR needs the swapchain externally synchronized with vkQueuePresentKHR,
+    // so it is polled with zero timeout from the main thread instead of blocking on a separate one
+    try {
+        while (not this->pending_presents.empty()) {
+            auto [id, input_time] = this->pending_presents.front();
+
+            if (this->swapchain.waitForPresent(id, 0) == vk::Result::eTimeout) {
+                break;
+            }
+            this->present_latencies.push_back(
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - input_time).count()
+            );
+            this->pending_presents.pop_front();
+        }
+    } catch (const vk::OutOfDateKHRError &) {
+        this->pending_presents.clear();
+        this->swapchain_outdated = true;
+    }
+
+    if (this->present_latencies.size() >= CONFIG_LATENCY_REPORT_SAMPLES) {
+        report_present_latency();
+    }
+}
+
+void Engine::report_present_latency(void)
 {
-    uint32_t current_frame = 0;
+    std::vector<double> sorted = this->present_latencies;
 
+    this->present_latencies.clear();
+    if (sorted.empty()) {
+        return;
+    }
+    std::ranges::sort(sorted);
+
+    double avg = 0;
+    for (double ms : sorted) {
+        avg += ms;
+    }
+    avg /= sorted.size();
+
+    std::cout << "input-to-present latency (" << get_latency_profile_name(this->latency_profile) << "): "
+              << "avg " << avg << " ms"
+              << ", p50 " << sorted.at(sorted.size() / 2) << " ms"
+              << ", p99 " << sorted.at(std::ceil(sorted.size() * 0.99) - 1) << " ms"
+              << ", max " << sorted.back() << " ms"
+              << " (" << sorted.size() << " frames)\n";
+}
+
+void Engine::main_loop(void)
+{
     this->ubo.resolution = glm::uvec2(WIDTH, HEIGHT);
     this->ubo.resolution_padding = glm::uvec2(0, 0);
     this->ubo.center = { 1.0, 0.0 };
@@ -819,18 +1176,31 @@ void Engine::main_loop(void)
     this->ubo.zoom_padding = 0.0;
     this->ubo.iter = 50;
 
+    if (not this->present_wait) {
+        std::cout << "VK_KHR_present_wait is not supported, input-to-present latency is not measured\n";
+    }
+
     draw_frame(0);
     while (not glfwWindowShouldClose(this->window)) {
         glfwPollEvents();
+        poll_present_latency();
 
-        if (!process_input()) {
+        bool input = process_input();
+        if (input && not this->input_time) {
+            // oldest input not shown yet - latency is counted from the moment the app saw it
+            this->input_time = std::chrono::steady_clock::now();
+        }
+
+        if (!input && !this->swapchain_outdated) {
             continue;
         }
-        draw_frame(current_frame);
-        current_frame = (current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
+        draw_frame(this->current_frame);
+        this->current_frame = (this->current_frame + 1) % CONFIG_MAX_FRAMES_IN_FLIGHT;
     }
 
     this->device.waitIdle();
+    poll_present_latency();
+    report_present_latency();
 }
 
 void Engine::update_uniform_buffer(int frame_idx)
@@ -839,25 +1209,63 @@ void Engine::update_uniform_buffer(int frame_idx)
     this->ubo.resolution_padding = glm::uvec2(0, 0);
     this->ubo.zoom_padding = 0.0;
 
-    memcpy(this->uniform_buffers_map.at(frame_idx), &ubo, sizeof(UniformBufferObject));
+    // benchmark zooms into the seahorse valley and starts over every 1000 frames,
+    // the view depends only on the frame number so every run renders the same images
+    if (this->bench_options) {
+        this->ubo.center = { 0.743643887037151, -0.131825904205330 };
+        this->ubo.zoom = std::pow(1.01, this->bench_frame_idx % 1000);
+    }
+
+    // recorded command buffers push the ubo themselves
+    if (CONFIG_PRERECORDED_COMMANDS) {
+        memcpy(this->uniform_buffers_map.at(frame_idx), &ubo, sizeof(UniformBufferObject));
+    }
 }
 
 void Engine::draw_frame(int frame_idx)
 {
+    vk::Result result;
+    uint32_t   image_index;
+
+    release_retired_swapchains();
+    if (this->swapchain_outdated) {
+        recreate_swapchain();
+        if (this->swapchain_outdated) {
+            return;
+        }
+    }
+
     update_uniform_buffer(frame_idx);
 
-    auto [result, image_index] = this->swapchain.acquireNextImage(
-        UINT64_MAX,
-        present_complete.at(frame_idx),
-        nullptr
-    );
-    record_command_buffer(image_index, frame_idx);
+    try {
+        std::tie(result, image_index) = this->swapchain.acquireNextImage(
+            UINT64_MAX,
+            present_complete.at(frame_idx),
+            nullptr
+        );
+    } catch (const vk::OutOfDateKHRError &) {
+        // nothing waits on the semaphore, it stays unsignaled and the frame is skipped
+        this->swapchain_outdated = true;
+        return;
+    }
+    if (result == vk::Result::eSuboptimalKHR) {
+        // image is still presentable - render this frame, recreate before the next one
+        this->swapchain_outdated = true;
+    }
+
+    vk::raii::CommandBuffer *cb;
+    if (CONFIG_PRERECORDED_COMMANDS) {
+        cb = &this->prerecorded_command_buffers.at(image_index * CONFIG_MAX_FRAMES_IN_FLIGHT + frame_idx);
+    } else {
+        cb = &this->command_buffers.at(frame_idx);
+        record_command_buffer(*cb, image_index, frame_idx);
+    }
 
     vk::PipelineStageFlags stage_flags(vk::PipelineStageFlagBits::eColorAttachmentOutput);
     vk::SubmitInfo submit_info(
         { *present_complete.at(frame_idx) },
         { stage_flags },
-        { *this->command_buffers.at(frame_idx) },
+        { **cb },
         { *render_finished.at(image_index) }
     );
     this->queue.submit(submit_info, *frame_finished.at(frame_idx));
@@ -876,23 +1284,66 @@ void Engine::draw_frame(int frame_idx)
         { image_index }
     );
 
-    result = this->queue.presentKHR(present_info);
-    if (CONFIG_VERBOSE) {
-        switch (result) {
-        case vk::Result::eSuccess:
-            break;
-        case vk::Result::eSuboptimalKHR:
-            recreate_swapchain();
-            break;
-        default:
-            std::cout << "vk::Queue::PresentKHR returned unexpected result: " << result << '\n';
-            break;
+    vk::PresentIdKHR present_id_info;
+    if (this->present_wait) {
+        this->present_id++;
+        present_id_info.setPresentIds(this->present_id);
+        present_info.setPNext(&present_id_info);
+
+        if (this->input_time) {
+            this->pending_presents.emplace_back(this->present_id, *this->input_time);
+            this->input_time.reset();
+        }
+    }
+
+    try {
+        result = this->queue.presentKHR(present_info);
+    } catch (const vk::OutOfDateKHRError &) {
+        result = vk::Result::eErrorOutOfDateKHR;
+    }
+    if (result != vk::Result::eSuccess) {
+        if (CONFIG_VERBOSE) {
+            std::cout << "vk::Queue::PresentKHR: " << vk::to_string(result) << '\n';
         }
+        this->swapchain_outdated = true;
+    }
+
+    this->frame_count++;
+}
+
+double Engine::read_bench_queries(uint32_t frame_index)
+{
+    if (not *this->bench_queries) {
+        return -1.0;
+    }
+
+    auto [result, stamps] = this->bench_queries.getResults<uint64_t>(
+        frame_index * 2,
+        2,
+        2 * sizeof(uint64_t),
+        sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64
+    );
+    if (result != vk::Result::eSuccess) {
+        return -1.0;
+    }
+
+    return ((stamps.at(1) - stamps.at(0)) & this->timestamp_mask) * this->timestamp_period / 1e6;
+}
+
+void Engine::save_pipeline_cache(void)
+{
+    // losing the cache only costs startup time on next launch - do not fail shutdown because of it
+    try {
+        write_file_atomic(PIPELINE_CACHE_PATH, this->pipeline_cache.getData());
+    } catch (const std::exception &e) {
+        std::cerr << "failed to save pipeline cache: " << e.what() << '\n';
     }
 }
 
 void Engine::cleanup(void)
 {
+    save_pipeline_cache();
     cleanup_swapchain();
 
     glfwDestroyWindow(this->window);
@@ -9,13 +9,54 @@
 
 #include <glm/glm.hpp>
 
+#include <chrono>
+#include <deque>
+#include <optional>
 #include <string>
 #include <vector>
 
+// trade-off between input latency, smoothness and power, selects present mode and swapchain image count.
+// CONFIG_LATENCY_PROFILE is the initial one by index, L key cycles them at runtime
+enum class LatencyProfile {
+    LowLatency,
+    Throughput,
+    PowerSave,
+};
+
+// swapchain replaced by recreate_swapchain(), presentation may still use its images and semaphores
+struct RetiredSwapchain {
+    vk::raii::SwapchainKHR           swapchain;
+    std::vector<vk::raii::ImageView> image_views;
+    std::vector<vk::raii::Semaphore> render_finished;
+    uint64_t                         release_frame;
+};
+
+// fixed-size run without user input, see bench.cpp
+struct BenchOptions {
+    uint32_t width;
+    uint32_t height;
+    // GLFW null platform, the surface comes from VK_EXT_headless_surface
+    bool     headless;
+};
+
+struct BenchFrame {
+    double cpu_ms;
+    // negative when the frame has no GPU timing
+    double gpu_ms;
+};
+
 class Engine {
+    // measures the host-side util functions, see microbench.cpp
+    friend struct MicroBench;
+
 public:
     void run(void);
 
+    // benchmark driving - init returns time to the first frame, frames follow a scripted path
+    double bench_init(const BenchOptions &options);
+    BenchFrame bench_frame(uint32_t frame);
+    void bench_cleanup(void);
+
 private:
     // run functions
     void init_window(void);
@@ -36,6 +77,7 @@ private:
         void create_descriptor_set_layout(void);
         void create_descriptor_pool(void);
         void create_descriptor_sets(void);
+        void create_pipeline_cache(void);
         void create_graphics_pipeline(void);
 
         void copy_buffer(vk::raii::Buffer &dst, vk::raii::Buffer &src, vk::DeviceSize size);
@@ -45,22 +87,32 @@ private:
 
         void create_command_pool(void);
         void create_command_buffers(void);
-        void record_command_buffer(uint32_t image_index, uint32_t frame_index);
+        void create_prerecorded_command_buffers(void);
+        void record_command_buffer(vk::raii::CommandBuffer &cb, uint32_t image_index, uint32_t frame_index);
 
         void create_sync_objects(void);
         void create_swapchain_sync_objects(void);
+        void create_bench_queries(void);
 
     // window resize functions
     void recreate_swapchain(void);
+    void release_retired_swapchains(void);
     void cleanup_swapchain(void);
+    static void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+    static void refresh_callback(GLFWwindow *window);
 
     // main loop functions
     void main_loop(void);
         void update_uniform_buffer(int frame_idx);
         void draw_frame(int frame_idx);
+        [[nodiscard]]
+        double read_bench_queries(uint32_t frame_index);
         bool process_input(void);
+        void poll_present_latency(void);
+        void report_present_latency(void);
         static void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
+    void save_pipeline_cache(void);
     void cleanup(void);
 
     // util functions
@@ -106,9 +158,20 @@ private:
     [[nodiscard]]
     static vk::PresentModeKHR choose_swapchain_present_mode(
         const vk::raii::PhysicalDevice &pd,
-        const vk::raii::SurfaceKHR &surface
+        const vk::raii::SurfaceKHR &surface,
+        LatencyProfile profile
+    );
+
+    [[nodiscard]]
+    static uint32_t choose_swapchain_image_count(
+        const vk::SurfaceCapabilitiesKHR &capabilities,
+        vk::PresentModeKHR present_mode,
+        LatencyProfile profile
     );
 
+    [[nodiscard]]
+    static const char *get_latency_profile_name(LatencyProfile profile);
+
     [[nodiscard]]
     static vk::Extent2D choose_swapchain_extent(
         const vk::raii::PhysicalDevice &pd,
@@ -128,6 +191,9 @@ private:
     [[nodiscard]]
     static std::vector<const char *> get_required_device_extensions();
 
+    [[nodiscard]]
+    static bool supports_present_wait(const vk::raii::PhysicalDevice &pd);
+
     [[nodiscard]]
     static std::vector<const char *> get_required_instance_extensions();
 
@@ -139,9 +205,17 @@ private:
         void *
     );
 
+    [[nodiscard]]
+    static bool is_pipeline_cache_compatible(
+        const std::vector<char> &data,
+        const vk::PhysicalDeviceProperties &props
+    );
+
     [[nodiscard]]
     static std::vector<char> read_file(const std::string &fname);
 
+    static void write_file_atomic(const std::string &fname, const std::vector<uint8_t> &data);
+
 private:
     struct Double2 {
         double x;
@@ -157,6 +231,17 @@ private:
         int        iter;
     };
 
+    // view math of process_input without the GLFW queries, see microbench.cpp
+    static void pan_view(UniformBufferObject &view, double dx, double dy, vk::Extent2D extent);
+
+    static void zoom_view(
+        UniformBufferObject &view,
+        double scroll,
+        double cursor_x,
+        double cursor_y,
+        vk::Extent2D extent
+    );
+
     struct UniformBufferObject       ubo;
     GLFWwindow                       *window         = nullptr;
     bool                             mouse_dragging  = false;
@@ -181,11 +266,14 @@ private:
 
     std::vector<vk::Image>           swapchain_images;
     std::vector<vk::raii::ImageView> swapchain_image_views;
+    std::deque<RetiredSwapchain>     retired_swapchains;
+    bool                             swapchain_outdated = false;
 
     vk::raii::DescriptorSetLayout    descriptor_layout = nullptr;
     vk::raii::DescriptorPool         descriptor_pool   = nullptr;
     std::vector<vk::raii::DescriptorSet> descriptor_sets;
 
+    vk::raii::PipelineCache          pipeline_cache    = nullptr;
     vk::raii::PipelineLayout         pipeline_layout   = nullptr;
     vk::raii::Pipeline               pipeline          = nullptr;
 
@@ -195,10 +283,33 @@ private:
 
     vk::raii::CommandPool            command_pool    = nullptr;
     std::vector<vk::raii::CommandBuffer> command_buffers;
+    // indexed by image_index * CONFIG_MAX_FRAMES_IN_FLIGHT + frame_index
+    std::vector<vk::raii::CommandBuffer> prerecorded_command_buffers;
 
     std::vector<vk::raii::Semaphore> present_complete;
     std::vector<vk::raii::Semaphore> render_finished;
     std::vector<vk::raii::Fence>     frame_finished;
+
+    uint64_t                         frame_count     = 0;
+    uint32_t                         current_frame   = 0;
+
+    std::optional<BenchOptions>      bench_options;
+    uint32_t                         bench_frame_idx = 0;
+    // two timestamps per frame slot around the whole command buffer
+    vk::raii::QueryPool              bench_queries   = nullptr;
+    double                           timestamp_period = 0.0;
+    uint64_t                         timestamp_mask  = 0;
+
+    LatencyProfile                   latency_profile  = static_cast<LatencyProfile>(CONFIG_LATENCY_PROFILE);
+    bool                             latency_key_down = false;
+
+    // input-to-present latency, measured with VK_KHR_present_id + VK_KHR_present_wait
+    using TimePoint = std::chrono::steady_clock::time_point;
+    bool                             present_wait     = false;
+    uint64_t                         present_id       = 0;
+    std::optional<TimePoint>         input_time;
+    std::deque<std::pair<uint64_t, TimePoint>> pending_presents;
+    std::vector<double>              present_latencies;
 };
 
 #endif /* ENGINE_HPP */
@@ -0,0 +1,124 @@
+
+#include "engine.hpp"
+#include "microbench.hpp"
+
+#include <optional>
+
+// instance and physical devices shared by the Vulkan benchmarks, none when there is no driver
+struct VulkanFixture {
+    vk::raii::Context                     context;
+    vk::raii::Instance                    instance = nullptr;
+    std::vector<vk::raii::PhysicalDevice> physical_devices;
+
+    static VulkanFixture *get(void)
+    {
+        static std::optional<VulkanFixture> fixture;
+        static bool                         tried = false;
+
+        if (not tried) {
+            tried = true;
+            try {
+                fixture.emplace();
+                vk::ApplicationInfo    app_info("microbench", 1, "No engine", 1, vk::ApiVersion13);
+                vk::InstanceCreateInfo create_info({}, &app_info);
+                fixture->instance = vk::raii::Instance(fixture->context, create_info);
+                fixture->physical_devices = fixture->instance.enumeratePhysicalDevices();
+            } catch (const std::exception &e) {
+                std::cout << "no Vulkan instance: " << e.what() << '\n';
+                fixture.reset();
+            }
+        }
+
+        if (not fixture || fixture->physical_devices.empty()) {
+            return nullptr;
+        }
+        return &*fixture;
+    }
+};
+
+struct MicroBench {
+    // a drag of arg() cursor events, the pan is applied once per event
+    static void pan_view(State &state)
+    {
+        Engine::UniformBufferObject view = {};
+        view.zoom = 1.0;
+
+        while (state.keep_running()) {
+            for (int64_t i = 0; i < state.arg(); i++) {
+                Engine::pan_view(view, static_cast<double>(i & 7) - 3.5, 1.0, { 1280, 720 });
+            }
+            do_not_optimize(view);
+        }
+        state.set_items_processed(state.arg());
+    }
+
+    // zooms in and back out so the view stays inside the clamped range
+    static void zoom_view(State &state)
+    {
+        Engine::UniformBufferObject view = {};
+        view.zoom = 1.0;
+
+        while (state.keep_running()) {
+            for (int64_t i = 0; i < state.arg(); i++) {
+                Engine::zoom_view(view, i & 1 ? -1.0 : 1.0, 320.0 + (i & 63), 200.0, { 1280, 720 });
+            }
+            do_not_optimize(view);
+        }
+        state.set_items_processed(state.arg());
+    }
+
+    static void read_file(State &state)
+    {
+        while (state.keep_running()) {
+            std::vector<char> data = Engine::read_file("shader.spv");
+            do_not_optimize(data.data());
+        }
+    }
+
+    static void find_memory_type(State &state)
+    {
+        VulkanFixture *vulkan = VulkanFixture::get();
+        if (vulkan == nullptr) {
+            state.skip("no Vulkan physical device");
+            return;
+        }
+
+        const vk::raii::PhysicalDevice &pd = vulkan->physical_devices.front();
+        while (state.keep_running()) {
+            uint32_t type = Engine::find_memory_type(
+                pd,
+                UINT32_MAX,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+            );
+            do_not_optimize(type);
+        }
+    }
+
+    static void physical_device_score(State &state)
+    {
+        VulkanFixture *vulkan = VulkanFixture::get();
+        if (vulkan == nullptr) {
+            state.skip("no Vulkan physical device");
+            return;
+        }
+
+        while (state.keep_running()) {
+            for (const vk::raii::PhysicalDevice &pd : vulkan->physical_devices) {
+                int score = Engine::get_physical_device_score(pd);
+                do_not_optimize(score);
+            }
+        }
+        state.set_items_processed(vulkan->physical_devices.size());
+    }
+};
+
+BENCHMARK(MicroBench::pan_view)->arg(1)->arg(1 << 10);
+BENCHMARK(MicroBench::zoom_view)->arg(1)->arg(1 << 10);
+BENCHMARK(MicroBench::read_file);
+BENCHMARK(MicroBench::find_memory_type);
+BENCHMARK(MicroBench::physical_device_score);
+
+int main(int argc, char **argv)
+{
+    return run_benchmarks(argc, argv);
+}
@@ -0,0 +1,254 @@
+
+#ifndef MICROBENCH_HPP
+#define MICROBENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal Google Benchmark look-alike for the host-side hot paths. A benchmark is a function taking
+// State, it loops while state.keep_running() and the runner grows the iteration count until one run
+// takes at least --min-time. Header only, microbench.cpp registers the benchmarks and calls run_benchmarks()
+class State {
+public:
+    State(int64_t arg, uint64_t iterations)
+        : arg_value(arg), max_iterations(iterations)
+    {
+    }
+
+    [[nodiscard]]
+    bool keep_running(void)
+    {
+        if (this->done == 0) {
+            this->start = std::chrono::steady_clock::now();
+        }
+        if (this->done == this->max_iterations) {
+            this->elapsed += std::chrono::steady_clock::now() - this->start;
+            return false;
+        }
+        this->done++;
+        return true;
+    }
+
+    // excludes setup done inside the loop from the measurement
+    void pause_timing(void)
+    {
+        this->elapsed += std::chrono::steady_clock::now() - this->start;
+    }
+
+    void resume_timing(void)
+    {
+        this->start = std::chrono::steady_clock::now();
+    }
+
+    void set_items_processed(int64_t items)
+    {
+        this->items = items;
+    }
+
+    void set_bytes_processed(int64_t bytes)
+    {
+        this->bytes = bytes;
+    }
+
+    void skip(const std::string &reason)
+    {
+        this->skip_reason = reason;
+    }
+
+    [[nodiscard]]
+    int64_t arg(void) const
+    {
+        return this->arg_value;
+    }
+
+    [[nodiscard]]
+    uint64_t iterations(void) const
+    {
+        return this->max_iterations;
+    }
+
+private:
+    friend struct BenchmarkRunner;
+
+    int64_t                               arg_value;
+    uint64_t                              max_iterations;
+    uint64_t                              done    = 0;
+    int64_t                               items   = 0;
+    int64_t                               bytes   = 0;
+    std::string                           skip_reason;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration   elapsed = {};
+};
+
+// keeps the compiler from dropping a computation whose result is otherwise unused
+template <typename T>
+inline void do_not_optimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Benchmark {
+    std::string                 name;
+    std::function<void(State &)> fn;
+    std::vector<int64_t>        args;
+
+    Benchmark *arg(int64_t value)
+    {
+        this->args.push_back(value);
+        return this;
+    }
+};
+
+inline std::vector<std::unique_ptr<Benchmark>> &get_benchmarks(void)
+{
+    static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+    return benchmarks;
+}
+
+inline Benchmark *register_benchmark(const char *name, void (*fn)(State &))
+{
+    get_benchmarks().push_back(std::make_unique<Benchmark>(Benchmark{ name, fn, {} }));
+    return get_benchmarks().back().get();
+}
+
+#define MICROBENCH_CONCAT(a, b) a##b
+#define MICROBENCH_NAME(line) MICROBENCH_CONCAT(g_benchmark_, line)
+#define BENCHMARK(fn) [[maybe_unused]] static Benchmark *MICROBENCH_NAME(__LINE__) = register_benchmark(#fn, fn)
+
+struct BenchmarkRunner {
+    struct Result {
+        std::string name;
+        uint64_t    iterations;
+        double      ns_per_op;
+        double      items_per_s;
+        double      bytes_per_s;
+    };
+
+    double              min_time = 0.5;
+    std::string         filter;
+    std::string         json_path;
+    std::vector<Result> results;
+
+    void parse_args(int argc, char **argv)
+    {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--min-time" && i + 1 < argc) {
+                this->min_time = std::stod(argv[++i]);
+            } else if (arg == "--filter" && i + 1 < argc) {
+                this->filter = argv[++i];
+            } else if (arg == "--json" && i + 1 < argc) {
+                this->json_path = argv[++i];
+            } else {
+                throw std::runtime_error("unknown argument: " + arg);
+            }
+        }
+    }
+
+    void run(const Benchmark &benchmark, int64_t arg)
+    {
+        std::string name = benchmark.name + (benchmark.args.empty() ? "" : "/" + std::to_string(arg));
+        if (not name.contains(this->filter)) {
+            return;
+        }
+
+        uint64_t iterations = 1;
+        for (;;) {
+            State state(arg, iterations);
+            benchmark.fn(state);
+
+            if (not state.skip_reason.empty()) {
+                std::cout << std::left << std::setw(40) << name << "skipped: " << state.skip_reason << '\n';
+                return;
+            }
+
+            double seconds = std::chrono::duration<double>(state.elapsed).count();
+            if (seconds >= this->min_time || iterations >= 1'000'000'000) {
+                Result result = {
+                    name,
+                    iterations,
+                    seconds * 1e9 / iterations,
+                    state.items * iterations / seconds,
+                    state.bytes * iterations / seconds,
+                };
+                print(result);
+                this->results.push_back(result);
+                return;
+            }
+
+            // aim a bit past min_time, but never grow more than 100x from a run that was too short to trust
+            double predicted = seconds > 0 ? this->min_time * 1.4 / seconds * iterations : iterations * 100.0;
+            iterations = std::clamp<uint64_t>(predicted, iterations + 1, iterations * 100);
+        }
+    }
+
+    static void print(const Result &result)
+    {
+        std::cout << std::left << std::setw(40) << result.name
+                  << std::right << std::setw(12) << result.iterations
+                  << std::setw(14) << std::fixed << std::setprecision(1) << result.ns_per_op << " ns";
+        if (result.items_per_s > 0) {
+            std::cout << std::setw(14) << std::setprecision(2) << result.items_per_s / 1e6 << " M items/s";
+        }
+        if (result.bytes_per_s > 0) {
+            std::cout << std::setw(14) << std::setprecision(1) << result.bytes_per_s / (1 << 20) << " MiB/s";
+        }
+        std::cout << '\n';
+    }
+
+    void write_json(void) const
+    {
+        std::ofstream f(this->json_path);
+        if (not f.is_open()) {
+            throw std::runtime_error("failed to open file: " + this->json_path);
+        }
+
+        f << "{\n";
+        for (size_t i = 0; i < this->results.size(); i++) {
+            f << "    \"" << this->results.at(i).name << "_ns\": " << this->results.at(i).ns_per_op
+              << (i + 1 < this->results.size() ? ",\n" : "\n");
+        }
+        f << "}\n";
+    }
+};
+
+inline int run_benchmarks(int argc, char **argv)
+{
+    try {
+        BenchmarkRunner runner;
+        runner.parse_args(argc, argv);
+
+        std::cout << std::left << std::setw(40) << "benchmark"
+                  << std::right << std::setw(12) << "iterations" << std::setw(17) << "time/op" << '\n';
+
+        for (const std::unique_ptr<Benchmark> &benchmark : get_benchmarks()) {
+            if (benchmark->args.empty()) {
+                runner.run(*benchmark, 0);
+            }
+            for (int64_t arg : benchmark->args) {
+                runner.run(*benchmark, arg);
+            }
+        }
+
+        if (not runner.json_path.empty()) {
+            runner.write_json();
+        }
+    } catch (const std::exception &e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif /* MICROBENCH_HPP */
@@ -1,9 +1,15 @@
 
 #include "engine.hpp"
 
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 static inline uint64_t BIT(uint64_t x)
 {
     return 1 << x;
@@ -142,23 +148,72 @@ vk::SurfaceFormatKHR Engine::choose_swapchain_surface_format(
 
 vk::PresentModeKHR Engine::choose_swapchain_present_mode(
         const vk::raii::PhysicalDevice &pd,
-        const vk::raii::SurfaceKHR &surface
+        const vk::raii::SurfaceKHR &surface,
+        LatencyProfile profile
     )
 {
     std::vector<vk::PresentModeKHR> avaliable_present_modes = pd.getSurfacePresentModesKHR(surface);
 
-    // try to use mailbox present mode if supported
-    if (std::ranges::contains(avaliable_present_modes, vk::PresentModeKHR::eMailbox)) {
-        return vk::PresentModeKHR::eMailbox;
-    }
-
-    // otherwise use FIFO present mode
     if (not std::ranges::contains(avaliable_present_modes, vk::PresentModeKHR::eFifo)) {
         throw std::runtime_error("FIFO present mode is not supported");
     }
+
+    // low latency - newest finished frame is shown on the next vblank, tearing immediate as fallback
+    if (profile == LatencyProfile::LowLatency) {
+        for (vk::PresentModeKHR mode : { vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate }) {
+            if (std::ranges::contains(avaliable_present_modes, mode)) {
+                return mode;
+            }
+        }
+    }
+
+    // throughput and power save - every frame is shown, vblank paces the rendering
     return vk::PresentModeKHR::eFifo;
 }
 
+uint32_t Engine::choose_swapchain_image_count(
+        const vk::SurfaceCapabilitiesKHR &capabilities,
+        vk::PresentModeKHR present_mode,
+        LatencyProfile profile
+    )
+{
+    uint32_t image_count = capabilities.minImageCount;
+
+    switch (profile) {
+    case LatencyProfile::LowLatency:
+        // mailbox needs a spare image to render into while one is queued and one is on screen
+        if (present_mode == vk::PresentModeKHR::eMailbox) {
+            image_count += 1;
+        }
+        break;
+    case LatencyProfile::Throughput:
+        // deeper queue absorbs frame time spikes at the cost of latency
+        image_count += 2;
+        break;
+    case LatencyProfile::PowerSave:
+        // shallow queue blocks the CPU early instead of rendering ahead
+        break;
+    }
+
+    if (capabilities.maxImageCount) {
+        image_count = std::min(image_count, capabilities.maxImageCount);
+    }
+    return image_count;
+}
+
+const char *Engine::get_latency_profile_name(LatencyProfile profile)
+{
+    switch (profile) {
+    case LatencyProfile::LowLatency:
+        return "low-latency";
+    case LatencyProfile::Throughput:
+        return "throughput";
+    case LatencyProfile::PowerSave:
+        return "power-save";
+    }
+    return "unknown";
+}
+
 vk::Extent2D Engine::choose_swapchain_extent(
         const vk::raii::PhysicalDevice &pd,
         const vk::raii::SurfaceKHR &surface,
@@ -257,6 +312,26 @@ std::vector<const char *> Engine::get_required_device_extensions(void)
     };
 }
 
+bool Engine::supports_present_wait(const vk::raii::PhysicalDevice &pd)
+{
+    std::vector<vk::ExtensionProperties> supp_extensions = pd.enumerateDeviceExtensionProperties();
+
+    for (const char *req_ext : { vk::KHRPresentIdExtensionName, vk::KHRPresentWaitExtensionName }) {
+        if (std::ranges::none_of(supp_extensions,
+                                 [req_ext](const vk::ExtensionProperties &supp_ext) {
+                                     return strcmp(supp_ext.extensionName, req_ext) == 0;
+                                 })) {
+            return false;
+        }
+    }
+
+    auto features = pd.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                    vk::PhysicalDevicePresentIdFeaturesKHR,
+                                    vk::PhysicalDevicePresentWaitFeaturesKHR>();
+    return features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+           features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+}
+
 std::vector<const char *> Engine::get_required_instance_extensions(void)
 {
     uint32_t     glfw_extension_count = 0;
@@ -270,6 +345,25 @@ std::vector<const char *> Engine::get_required_instance_extensions(void)
     return extensions;
 }
 
+bool Engine::is_pipeline_cache_compatible(
+        const std::vector<char> &data,
+        const vk::PhysicalDeviceProperties &props
+    )
+{
+    VkPipelineCacheHeaderVersionOne header;
+
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID &&
+           header.deviceID == props.deviceID &&
+           memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
 std::vector<char> Engine::read_file(const std::string &fname)
 {
     std::ifstream     f(fname, std::ios::ate | std::ios::binary);
@@ -287,6 +381,40 @@ std::vector<char> Engine::read_file(const std::string &fname)
     return buff;
 }
 
+void Engine::write_file_atomic(const std::string &fname, const std::vector<uint8_t> &data)
+{
+    // write next to the target and rename over it, so a crash never leaves half-written file behind
+    std::string tmp_fname = fname + ".tmp";
+
+    int fd = open(tmp_fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file: " + tmp_fname);
+    }
+
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += n;
+    }
+
+    // without the fsync the rename may reach the disk before the data does
+    bool failed = written != data.size() || fsync(fd) != 0;
+    failed = close(fd) != 0 || failed;
+
+    if (failed) {
+        std::filesystem::remove(tmp_fname);
+        throw std::runtime_error("failed to write file: " + tmp_fname);
+    }
+
+    std::filesystem::rename(tmp_fname, fname);
+}
+
 vk::Bool32 Engine::debug_callback(
         vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
         vk::DebugUtilsMessageTypeFlagsEXT type,